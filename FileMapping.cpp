@@ -0,0 +1,113 @@
+#include "FileMapping.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& Path)
+{
+	Close();
+	HANDLE File = CreateFileA(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0)
+	{
+		CloseHandle(File);
+		return false;
+	}
+	HANDLE Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (Mapping == nullptr)
+	{
+		CloseHandle(File);
+		return false;
+	}
+	void* View = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	if (View == nullptr)
+	{
+		CloseHandle(Mapping);
+		CloseHandle(File);
+		return false;
+	}
+	FileHandle = File;
+	MappingHandle = Mapping;
+	Data = static_cast<const uint8_t*>(View);
+	Size = size_t(FileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (Data)
+	{
+		UnmapViewOfFile(Data);
+		CloseHandle(MappingHandle);
+		CloseHandle(FileHandle);
+	}
+	Data = nullptr;
+	Size = 0;
+	FileHandle = nullptr;
+	MappingHandle = nullptr;
+}
+#else
+bool MappedFile::Open(const std::string& Path)
+{
+	Close();
+	int File = open(Path.c_str(), O_RDONLY);
+	if (File < 0)
+	{
+		return false;
+	}
+	struct stat FileStat;
+	if (fstat(File, &FileStat) != 0 || FileStat.st_size == 0)
+	{
+		close(File);
+		return false;
+	}
+	void* View = mmap(nullptr, size_t(FileStat.st_size), PROT_READ, MAP_PRIVATE, File, 0);
+	close(File);
+	if (View == MAP_FAILED)
+	{
+		return false;
+	}
+	Data = static_cast<const uint8_t*>(View);
+	Size = size_t(FileStat.st_size);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (Data)
+	{
+		munmap(const_cast<uint8_t*>(Data), Size);
+	}
+	Data = nullptr;
+	Size = 0;
+}
+#endif
+
+uint64_t HashBytes(const void* Data, size_t Size, uint64_t Seed)
+{
+	const uint8_t* Bytes = static_cast<const uint8_t*>(Data);
+	uint64_t Hash = Seed;
+	for (size_t i = 0; i < Size; i++)
+	{
+		Hash ^= Bytes[i];
+		Hash *= 1099511628211ull;
+	}
+	return Hash;
+}
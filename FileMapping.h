@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/*
+* 只读的内存映射文件，析构时解除映射
+*/
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	bool Open(const std::string& Path);
+	void Close();
+	const uint8_t* GetData() const { return Data; }
+	size_t GetSize() const { return Size; }
+	bool IsOpen() const { return Data != nullptr; }
+private:
+	const uint8_t* Data = nullptr;
+	size_t Size = 0;
+#ifdef _WIN32
+	void* FileHandle = nullptr;
+	void* MappingHandle = nullptr;
+#endif
+};
+
+/*
+* 64位FNV-1a哈希，用于文件内容校验
+*/
+uint64_t HashBytes(const void* Data, size_t Size, uint64_t Seed = 14695981039346656037ull);
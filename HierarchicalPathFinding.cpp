@@ -0,0 +1,749 @@
+#include "HierarchicalPathFinding.h"
+#include "SphereSegmentation.h"
+#include "SpanData.h"
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <functional>
+
+/*
+* 限制在一个簇内的Span图搜索，预计算入口距离与细化路径时使用
+* Target < 0 时是Dijkstra，搜索整个簇；否则是到Target的A*
+* Reverse为true时沿连接的反方向搜索，得到的是簇内各Span到起点的距离
+*/
+class ClusterSearch
+{
+public:
+	explicit ClusterSearch(const TilePortalGraph& g)
+		:Graph(g), Compact(g.GetCompact())
+	{
+		Nodes.resize(Graph.GetSpanNum());
+		for (auto&& n : Nodes)
+		{
+			n.Generation = 0;
+		}
+	}
+	/*
+	* 参数都是Span编号，返回是否到达Target（Target < 0 时总是返回true）
+	*/
+	bool Run(int Source, int Target, bool Reverse)
+	{
+		Generation++;
+		if (Generation == 0)
+		{
+			for (auto&& n : Nodes)
+			{
+				n.Generation = 0;
+			}
+			Generation = 1;
+		}
+		OpenHeap.clear();
+		SettledNum = 0;
+		int Begin = Graph.GetSpanBeginIndex();
+		int Cluster = Graph.GetSpanCluster(Source);
+		glm::vec3 TargetPos = Target >= 0 ? Graph.GetSpanTopPos(Target) : glm::vec3(0);
+		float Stride = Graph.GetStride();
+
+		auto Open = [&](int Local, int Parent, float g)
+		{
+			Node& n = Nodes[Local];
+			if (n.Generation == Generation && (n.Closed || n.g <= g))
+			{
+				return;
+			}
+			n.Generation = Generation;
+			n.g = g;
+			n.Parent = Parent;
+			n.Closed = false;
+			float f = Target >= 0 ? g + glm::distance(Graph.GetSpanTopPos(Local + Begin), TargetPos) : g;
+			OpenHeap.emplace_back(f, Local);
+			std::push_heap(OpenHeap.begin(), OpenHeap.end(), std::greater<std::pair<float, int>>());
+		};
+
+		Open(Source - Begin, -1, 0.0f);
+		while (!OpenHeap.empty())
+		{
+			std::pop_heap(OpenHeap.begin(), OpenHeap.end(), std::greater<std::pair<float, int>>());
+			int Current = OpenHeap.back().second;
+			OpenHeap.pop_back();
+			Node& CurrentNode = Nodes[Current];
+			if (CurrentNode.Closed)
+			{
+				continue;
+			}
+			CurrentNode.Closed = true;
+			SettledNum++;
+			if (Current + Begin == Target)
+			{
+				return true;
+			}
+
+			float g = CurrentNode.g + Stride;
+			int CurrentSpan = Current + Begin;
+			if (!Reverse)
+			{
+				for (int k = Compact.GetLinkBegin(CurrentSpan); k < Compact.GetLinkEnd(CurrentSpan); k++)
+				{
+					int j = Compact.GetLinkedSpan(k);
+					if (Graph.GetSpanCluster(j) == Cluster)
+					{
+						Open(j - Begin, Current, g);
+					}
+				}
+				continue;
+			}
+			//反向：连接到当前Span的Span
+			for (int k = Graph.GetReverseLinkBegin(CurrentSpan); k < Graph.GetReverseLinkEnd(CurrentSpan); k++)
+			{
+				int j = Graph.GetReverseLinkedSpan(k);
+				if (Graph.GetSpanCluster(j) == Cluster)
+				{
+					Open(j - Begin, Current, g);
+				}
+			}
+		}
+		return Target < 0;
+	}
+	/*
+	* 上一次Run中SpanIndex的距离，没有到达时返回负数
+	*/
+	float GetCost(int SpanIndex) const
+	{
+		const Node& n = Nodes[SpanIndex - Graph.GetSpanBeginIndex()];
+		return n.Generation == Generation && n.Closed ? n.g : -1.0f;
+	}
+	/*
+	* 把上一次Run从Source到SpanIndex的路径（不包括Source）追加到OutPath
+	*/
+	void AppendPath(int SpanIndex, std::vector<int>& OutPath) const
+	{
+		int Begin = Graph.GetSpanBeginIndex();
+		size_t First = OutPath.size();
+		for (int n = SpanIndex - Begin; Nodes[n].Parent != -1; n = Nodes[n].Parent)
+		{
+			OutPath.emplace_back(n + Begin);
+		}
+		std::reverse(OutPath.begin() + First, OutPath.end());
+	}
+	int GetSettledNum() const { return SettledNum; }
+private:
+	struct Node
+	{
+		float g;
+		int Parent;
+		uint32_t Generation;
+		bool Closed;
+	};
+	const TilePortalGraph& Graph;
+	const CompactSpanData& Compact;
+	std::vector<Node> Nodes;//按 Span编号 - SpanBeginIndex 索引
+	std::vector<std::pair<float, int>> OpenHeap;
+	uint32_t Generation = 0;
+	int SettledNum = 0;
+};
+
+TilePortalGraph::TilePortalGraph(const SphereMgr& s, int ClusterTiles, int ThreadNum)
+	:Sphere(s), Compact(SpanData::getInstance().Compact), ClusterTileNum(std::max(1, ClusterTiles))
+{
+	auto&& instance = SpanData::getInstance();
+	SpanBeginIndex = Compact.GetListSpanBegin(instance.Dictionary[Sphere.SphereId].first);
+	Stride = Sphere.Stride;
+	int SpanEndIndex = Compact.GetListSpanEnd(instance.Dictionary[Sphere.SphereId].second);
+
+	TileUp.resize(Sphere.total_tiles_num);
+	for (auto&& t : Sphere.FlatTiles)
+	{
+		TileUp[t.TileIndex] = glm::normalize(glm::cross(t.axis_u, t.axis_v));
+	}
+	BuildClusters();
+	SpanCluster.resize(SpanEndIndex - SpanBeginIndex);
+	for (int i = 0; i < SpanCluster.size(); i++)
+	{
+		SpanCluster[i] = TileCluster[Compact.GetList(Compact.GetSpan(i + SpanBeginIndex).ListIndex).TileIndex];
+	}
+	if (!Compact.HasLinks())
+	{
+		return;
+	}
+
+	BuildReverseLinks();
+	std::vector<std::vector<PortalEdge>> PortalEdges;
+	BuildPortals(PortalEdges);
+	BuildEdges(PortalEdges, ThreadNum);
+	Valid = true;
+}
+
+glm::vec3 TilePortalGraph::GetSpanTopPos(int SpanIndex) const
+{
+	const Span& sp = Compact.GetSpan(SpanIndex);
+	const CompactSpanList& List = Compact.GetList(sp.ListIndex);
+	return List.CenteralWorldPos + TileUp[List.TileIndex] * sp.top;
+}
+
+float TilePortalGraph::GetStride() const
+{
+	return Sphere.Stride;
+}
+
+size_t TilePortalGraph::GetMemorySize() const
+{
+	return TileUp.capacity() * sizeof(glm::vec3) + TileCluster.capacity() * sizeof(int) + SpanCluster.capacity() * sizeof(int) + SpanPortal.capacity() * sizeof(int)
+		+ ClusterPortalBegin.capacity() * sizeof(int) + PortalSpans.capacity() * sizeof(int) + PortalPos.capacity() * sizeof(glm::vec3)
+		+ ReverseBegin.capacity() * sizeof(int) + ReverseLinks.capacity() * sizeof(int) + EdgeBegin.capacity() * sizeof(int) + Edges.capacity() * sizeof(PortalEdge)
+		+ SpanClusterIndex.capacity() * sizeof(int) + ClusterTableBegin.capacity() * sizeof(int64_t) + (ToPortalSteps.capacity() + FromPortalSteps.capacity()) * sizeof(uint16_t);
+}
+
+void TilePortalGraph::BuildClusters()
+{
+	//每ClusterTileNum行分成一块，块内按最宽一行的Tile数把经度等分成若干段，每段是一个簇
+	//同一行的第j个Tile中心的经度为 2π * j / 行的Tile数，各行都从经度0开始，所以块内各行的分段是对齐的
+	TileCluster.resize(Sphere.total_tiles_num);
+	ClusterNum = 0;
+	int RowNum = int(Sphere.Tiles.size());
+	for (int BlockBegin = 0; BlockBegin < RowNum; BlockBegin += ClusterTileNum)
+	{
+		int BlockEnd = std::min(RowNum, BlockBegin + ClusterTileNum);
+		int MaxTileNum = 0;
+		for (int i = BlockBegin; i < BlockEnd; i++)
+		{
+			MaxTileNum = std::max(MaxTileNum, int(Sphere.Tiles[i].size()));
+		}
+		int SegmentNum = std::max(1, (MaxTileNum + ClusterTileNum - 1) / ClusterTileNum);
+		for (int i = BlockBegin; i < BlockEnd; i++)
+		{
+			int TileNum = int(Sphere.Tiles[i].size());
+			for (int j = 0; j < TileNum; j++)
+			{
+				int Segment = std::min(SegmentNum - 1, int(int64_t(j) * SegmentNum / TileNum));
+				TileCluster[Sphere.Tiles[i][j].TileIndex] = ClusterNum + Segment;
+			}
+		}
+		ClusterNum += SegmentNum;
+	}
+}
+
+void TilePortalGraph::BuildReverseLinks()
+{
+	int SpanNum = GetSpanNum();
+	ReverseBegin.assign(SpanNum + 1, 0);
+	for (int i = 0; i < SpanNum; i++)
+	{
+		for (int k = Compact.GetLinkBegin(i + SpanBeginIndex); k < Compact.GetLinkEnd(i + SpanBeginIndex); k++)
+		{
+			ReverseBegin[Compact.GetLinkedSpan(k) - SpanBeginIndex + 1]++;
+		}
+	}
+	for (int i = 0; i < SpanNum; i++)
+	{
+		ReverseBegin[i + 1] += ReverseBegin[i];
+	}
+	ReverseLinks.resize(ReverseBegin[SpanNum]);
+	std::vector<int> Fill(ReverseBegin.begin(), ReverseBegin.end() - 1);
+	for (int i = 0; i < SpanNum; i++)
+	{
+		for (int k = Compact.GetLinkBegin(i + SpanBeginIndex); k < Compact.GetLinkEnd(i + SpanBeginIndex); k++)
+		{
+			ReverseLinks[Fill[Compact.GetLinkedSpan(k) - SpanBeginIndex]++] = i + SpanBeginIndex;
+		}
+	}
+}
+
+void TilePortalGraph::BuildPortals(std::vector<std::vector<PortalEdge>>& PortalEdges)
+{
+	int SpanNum = GetSpanNum();
+	//边界项：一个Span与它能走到的另一个簇，每个Span最多4项
+	std::vector<int> ItemBegin(SpanNum + 1);
+	std::vector<int> ItemCluster;
+	for (int i = 0; i < SpanNum; i++)
+	{
+		ItemBegin[i] = int(ItemCluster.size());
+		for (int Link = Compact.GetLinkBegin(i + SpanBeginIndex); Link < Compact.GetLinkEnd(i + SpanBeginIndex); Link++)
+		{
+			int j = Compact.GetLinkedSpan(Link);
+			if (SpanCluster[j - SpanBeginIndex] == SpanCluster[i])
+			{
+				continue;
+			}
+			int Target = SpanCluster[j - SpanBeginIndex];
+			if (std::find(ItemCluster.begin() + ItemBegin[i], ItemCluster.end(), Target) == ItemCluster.end())
+			{
+				ItemCluster.emplace_back(Target);
+			}
+		}
+	}
+	ItemBegin[SpanNum] = int(ItemCluster.size());
+	int ItemNum = int(ItemCluster.size());
+	std::vector<int> ItemSpan(ItemNum);
+	for (int i = 0; i < SpanNum; i++)
+	{
+		for (int k = ItemBegin[i]; k < ItemBegin[i + 1]; k++)
+		{
+			ItemSpan[k] = i;
+		}
+	}
+
+	//簇内相连并且通向同一个簇的边界项合并成一段边界
+	std::vector<int> Parent(ItemNum);
+	for (int k = 0; k < ItemNum; k++)
+	{
+		Parent[k] = k;
+	}
+	auto Find = [&](int k)
+	{
+		while (Parent[k] != k)
+		{
+			Parent[k] = Parent[Parent[k]];
+			k = Parent[k];
+		}
+		return k;
+	};
+	for (int k = 0; k < ItemNum; k++)
+	{
+		int i = ItemSpan[k];
+		for (int Link = Compact.GetLinkBegin(i + SpanBeginIndex); Link < Compact.GetLinkEnd(i + SpanBeginIndex); Link++)
+		{
+			int j = Compact.GetLinkedSpan(Link);
+			if (SpanCluster[j - SpanBeginIndex] != SpanCluster[i])
+			{
+				continue;
+			}
+			j -= SpanBeginIndex;
+			for (int m = ItemBegin[j]; m < ItemBegin[j + 1]; m++)
+			{
+				if (ItemCluster[m] == ItemCluster[k])
+				{
+					Parent[Find(k)] = Find(m);
+				}
+			}
+		}
+	}
+
+	//每段边界取离中心最近的Span作为入口
+	std::vector<glm::vec3> Center(ItemNum, glm::vec3(0));
+	std::vector<int> Count(ItemNum, 0);
+	for (int k = 0; k < ItemNum; k++)
+	{
+		int Root = Find(k);
+		Center[Root] += GetSpanTopPos(ItemSpan[k] + SpanBeginIndex);
+		Count[Root]++;
+	}
+	std::vector<int> Best(ItemNum, -1);
+	std::vector<float> BestDistance(ItemNum);
+	for (int k = 0; k < ItemNum; k++)
+	{
+		int Root = Find(k);
+		float Distance = glm::distance(GetSpanTopPos(ItemSpan[k] + SpanBeginIndex), Center[Root] / float(Count[Root]));
+		if (Best[Root] < 0 || Distance < BestDistance[Root])
+		{
+			Best[Root] = k;
+			BestDistance[Root] = Distance;
+		}
+	}
+
+	//入口与它在另一个簇中连接到的Span都是入口
+	std::vector<std::pair<int, int>> Crossings;
+	for (int k = 0; k < ItemNum; k++)
+	{
+		if (Best[k] < 0)
+		{
+			continue;
+		}
+		int i = ItemSpan[Best[k]];
+		for (int Link = Compact.GetLinkBegin(i + SpanBeginIndex); Link < Compact.GetLinkEnd(i + SpanBeginIndex); Link++)
+		{
+			int j = Compact.GetLinkedSpan(Link);
+			if (SpanCluster[j - SpanBeginIndex] == ItemCluster[Best[k]])
+			{
+				Crossings.emplace_back(i, j - SpanBeginIndex);
+				break;
+			}
+		}
+	}
+
+	std::vector<int> Portals;
+	for (auto&& c : Crossings)
+	{
+		Portals.emplace_back(c.first);
+		Portals.emplace_back(c.second);
+	}
+	std::sort(Portals.begin(), Portals.end(), [this](int a, int b)
+	{
+		return SpanCluster[a] != SpanCluster[b] ? SpanCluster[a] < SpanCluster[b] : a < b;
+	});
+	Portals.erase(std::unique(Portals.begin(), Portals.end()), Portals.end());
+
+	SpanPortal.assign(SpanNum, -1);
+	PortalSpans.resize(Portals.size());
+	PortalPos.resize(Portals.size());
+	ClusterPortalBegin.assign(ClusterNum + 1, 0);
+	for (int p = 0; p < Portals.size(); p++)
+	{
+		SpanPortal[Portals[p]] = p;
+		PortalSpans[p] = Portals[p] + SpanBeginIndex;
+		PortalPos[p] = GetSpanTopPos(PortalSpans[p]);
+		ClusterPortalBegin[SpanCluster[Portals[p]] + 1]++;
+	}
+	for (int c = 0; c < ClusterNum; c++)
+	{
+		ClusterPortalBegin[c + 1] += ClusterPortalBegin[c];
+	}
+
+	PortalEdges.assign(Portals.size(), {});
+	for (auto&& c : Crossings)
+	{
+		PortalEdges[SpanPortal[c.first]].push_back({ SpanPortal[c.second], Sphere.Stride });
+	}
+}
+
+void TilePortalGraph::BuildEdges(std::vector<std::vector<PortalEdge>>& PortalEdges, int ThreadNum)
+{
+	//每个簇的Span列表与Span在簇中的序号，距离表中每个簇占 Span数 * 入口数 项
+	int SpanNum = GetSpanNum();
+	std::vector<int> ClusterSpanBegin(ClusterNum + 1, 0);
+	for (int i = 0; i < SpanNum; i++)
+	{
+		ClusterSpanBegin[SpanCluster[i] + 1]++;
+	}
+	for (int c = 0; c < ClusterNum; c++)
+	{
+		ClusterSpanBegin[c + 1] += ClusterSpanBegin[c];
+	}
+	std::vector<int> ClusterSpans(SpanNum);
+	std::vector<int> Fill(ClusterSpanBegin.begin(), ClusterSpanBegin.end() - 1);
+	SpanClusterIndex.resize(SpanNum);
+	for (int i = 0; i < SpanNum; i++)
+	{
+		int c = SpanCluster[i];
+		SpanClusterIndex[i] = Fill[c] - ClusterSpanBegin[c];
+		ClusterSpans[Fill[c]++] = i + SpanBeginIndex;
+	}
+	ClusterTableBegin.resize(ClusterNum);
+	size_t TableSize = 0;
+	for (int c = 0; c < ClusterNum; c++)
+	{
+		ClusterTableBegin[c] = int64_t(TableSize);
+		TableSize += size_t(ClusterSpanBegin[c + 1] - ClusterSpanBegin[c]) * (ClusterPortalBegin[c + 1] - ClusterPortalBegin[c]);
+	}
+	ToPortalSteps.assign(TableSize, NoPortalDistance);
+	FromPortalSteps.assign(TableSize, NoPortalDistance);
+
+	//每个入口在簇内做一次正向与一次反向Dijkstra，得到到同一个簇中其它入口的距离以及与簇内所有Span之间的距离，按簇并行
+	WorkStealingScheduler Scheduler(ThreadNum);
+	std::vector<std::unique_ptr<ClusterSearch>> Searches(Scheduler.GetThreadNum());
+	Scheduler.ParallelFor(ClusterNum, [&](int Cluster, int ThreadIndex)
+	{
+		int Begin = ClusterPortalBegin[Cluster];
+		int End = ClusterPortalBegin[Cluster + 1];
+		if (Begin == End)
+		{
+			return;
+		}
+		if (!Searches[ThreadIndex])
+		{
+			Searches[ThreadIndex] = std::make_unique<ClusterSearch>(*this);
+		}
+		ClusterSearch& Search = *Searches[ThreadIndex];
+		//距离都是Stride的整数倍，按格数保存，超过uint16的范围时这个簇不使用距离表
+		bool Overflow = false;
+		auto FillTable = [&](std::vector<uint16_t>& Table, int p)
+		{
+			for (int k = ClusterSpanBegin[Cluster]; k < ClusterSpanBegin[Cluster + 1]; k++)
+			{
+				float Cost = Search.GetCost(ClusterSpans[k]);
+				if (Cost < 0)
+				{
+					continue;
+				}
+				int Steps = int(Cost / Stride + 0.5f);
+				Overflow |= Steps >= NoPortalDistance;
+				Table[size_t(ClusterTableBegin[Cluster]) + size_t(k - ClusterSpanBegin[Cluster]) * (End - Begin) + (p - Begin)] = uint16_t(std::min<int>(Steps, NoPortalDistance));
+			}
+		};
+		for (int p = Begin; p < End; p++)
+		{
+			Search.Run(PortalSpans[p], -1, false);
+			for (int q = Begin; q < End; q++)
+			{
+				float Cost = Search.GetCost(PortalSpans[q]);
+				if (q != p && Cost >= 0)
+				{
+					PortalEdges[p].push_back({ q, Cost });
+				}
+			}
+			FillTable(FromPortalSteps, p);
+			Search.Run(PortalSpans[p], -1, true);
+			FillTable(ToPortalSteps, p);
+		}
+		if (Overflow)
+		{
+			ClusterTableBegin[Cluster] = -1;
+		}
+	});
+
+	EdgeBegin.resize(PortalEdges.size() + 1);
+	Edges.clear();
+	for (int p = 0; p < PortalEdges.size(); p++)
+	{
+		EdgeBegin[p] = int(Edges.size());
+		Edges.insert(Edges.end(), PortalEdges[p].begin(), PortalEdges[p].end());
+	}
+	EdgeBegin[PortalEdges.size()] = int(Edges.size());
+}
+
+HierarchicalPathFinder::HierarchicalPathFinder(const TilePortalGraph& g)
+	:Graph(g), Search(std::make_unique<ClusterSearch>(g))
+{
+	int PortalNum = Graph.GetPortalNum();
+	Nodes.resize(PortalNum + 2);
+	for (auto&& n : Nodes)
+	{
+		n.Generation = 0;
+	}
+	GoalCost.resize(PortalNum);
+	GoalGeneration.assign(PortalNum, 0);
+}
+
+HierarchicalPathFinder::~HierarchicalPathFinder() = default;
+
+bool HierarchicalPathFinder::SetHierarchy(const PortalHierarchy* Hierarchy)
+{
+	HierarchyQuery.reset();
+	if (Hierarchy && Hierarchy->Matches(Graph))
+	{
+		HierarchyQuery = std::make_unique<PortalHierarchy::Query>(*Hierarchy);
+	}
+	return HierarchyQuery != nullptr;
+}
+
+bool HierarchicalPathFinder::BeginQuery(int FromSpan, int ToSpan)
+{
+	PortalPath.clear();
+	PathCost = -1.0f;
+	LastAbstractExpandedNum = 0;
+	LastRefineExpandedNum = 0;
+	int Begin = Graph.GetSpanBeginIndex();
+	if (!Graph.IsValid() || FromSpan < Begin || FromSpan >= Begin + Graph.GetSpanNum() || ToSpan < Begin || ToSpan >= Begin + Graph.GetSpanNum())
+	{
+		return false;
+	}
+	auto&& Compact = Graph.GetCompact();
+	if (Compact.HasComponents() && Compact.GetSpanComponent(FromSpan) != Compact.GetSpanComponent(ToSpan))
+	{
+		return false;
+	}
+
+	Generation++;
+	if (Generation == 0)
+	{
+		for (auto&& n : Nodes)
+		{
+			n.Generation = 0;
+		}
+		std::fill(GoalGeneration.begin(), GoalGeneration.end(), 0);
+		Generation = 1;
+	}
+	return true;
+}
+
+bool HierarchicalPathFinder::FindPath(int FromSpan, int ToSpan, std::vector<int>& OutPath)
+{
+	OutPath.clear();
+	if (!BeginQuery(FromSpan, ToSpan))
+	{
+		return false;
+	}
+	if (FromSpan == ToSpan)
+	{
+		OutPath.emplace_back(FromSpan);
+		return true;
+	}
+	if (!SearchAbstract(FromSpan, ToSpan, true))
+	{
+		return false;
+	}
+	return Refine(FromSpan, ToSpan, OutPath);
+}
+
+float HierarchicalPathFinder::FindDistance(int FromSpan, int ToSpan)
+{
+	if (!BeginQuery(FromSpan, ToSpan))
+	{
+		return -1.0f;
+	}
+	if (FromSpan == ToSpan)
+	{
+		return 0.0f;
+	}
+	return SearchAbstract(FromSpan, ToSpan, false) ? PathCost : -1.0f;
+}
+
+void HierarchicalPathFinder::Open(int Node, int Parent, float g, const glm::vec3& TargetPos)
+{
+	AbstractNode& n = Nodes[Node];
+	if (n.Generation == Generation && (n.Closed || n.g <= g))
+	{
+		return;
+	}
+	int PortalNum = Graph.GetPortalNum();
+	n.Generation = Generation;
+	n.g = g;
+	n.Parent = Parent;
+	n.Closed = false;
+	n.f = g + (Node < PortalNum ? glm::distance(Graph.GetPortalPos(Node), TargetPos) : 0.0f);
+	OpenHeap.emplace_back(n.f, Node);
+	std::push_heap(OpenHeap.begin(), OpenHeap.end(), std::greater<std::pair<float, int>>());
+}
+
+bool HierarchicalPathFinder::SearchAbstract(int FromSpan, int ToSpan, bool NeedPath)
+{
+	int PortalNum = Graph.GetPortalNum();
+	int StartNode = PortalNum;
+	int GoalNode = PortalNum + 1;
+	int FromCluster = Graph.GetSpanCluster(FromSpan);
+	int ToCluster = Graph.GetSpanCluster(ToSpan);
+
+	//起点在簇内能走到的入口，预计算了距离表时直接查表，同一个簇内的直接距离仍然需要在簇内搜索
+	bool FromTable = Graph.HasPortalDistances(FromCluster);
+	DirectCost = -1.0f;
+	if (!FromTable || FromCluster == ToCluster)
+	{
+		Search->Run(FromSpan, -1, false);
+		LastRefineExpandedNum += Search->GetSettledNum();
+		DirectCost = FromCluster == ToCluster ? Search->GetCost(ToSpan) : -1.0f;
+	}
+	StartEdges.clear();
+	for (int p = Graph.GetClusterPortalBegin(FromCluster); p < Graph.GetClusterPortalBegin(FromCluster + 1); p++)
+	{
+		float Cost = FromTable ? Graph.GetDistanceToPortal(FromSpan, p) : Search->GetCost(Graph.GetPortalSpan(p));
+		if (Cost >= 0)
+		{
+			StartEdges.emplace_back(p, Cost);
+		}
+	}
+
+	//终点所在簇中能走到终点的入口
+	bool ToTable = Graph.HasPortalDistances(ToCluster);
+	if (!ToTable)
+	{
+		Search->Run(ToSpan, -1, true);
+		LastRefineExpandedNum += Search->GetSettledNum();
+	}
+	GoalEdges.clear();
+	for (int p = Graph.GetClusterPortalBegin(ToCluster); p < Graph.GetClusterPortalBegin(ToCluster + 1); p++)
+	{
+		float Cost = ToTable ? Graph.GetDistanceFromPortal(p, ToSpan) : Search->GetCost(Graph.GetPortalSpan(p));
+		if (Cost >= 0)
+		{
+			GoalCost[p] = Cost;
+			GoalGeneration[p] = Generation;
+			GoalEdges.emplace_back(p, Cost);
+		}
+	}
+	if ((GoalEdges.empty() || StartEdges.empty()) && DirectCost < 0)
+	{
+		return false;
+	}
+	if (HierarchyQuery)
+	{
+		return SearchHierarchy(NeedPath);
+	}
+
+	glm::vec3 TargetPos = Graph.GetSpanTopPos(ToSpan);
+	OpenHeap.clear();
+	Open(StartNode, -1, 0.0f, TargetPos);
+	while (!OpenHeap.empty())
+	{
+		std::pop_heap(OpenHeap.begin(), OpenHeap.end(), std::greater<std::pair<float, int>>());
+		int Current = OpenHeap.back().second;
+		OpenHeap.pop_back();
+		AbstractNode& CurrentNode = Nodes[Current];
+		if (CurrentNode.Closed)
+		{
+			continue;
+		}
+		CurrentNode.Closed = true;
+		LastAbstractExpandedNum++;
+
+		if (Current == GoalNode)
+		{
+			PathCost = CurrentNode.g;
+			for (int n = Nodes[GoalNode].Parent; n != StartNode; n = Nodes[n].Parent)
+			{
+				PortalPath.emplace_back(n);
+			}
+			std::reverse(PortalPath.begin(), PortalPath.end());
+			return true;
+		}
+		if (Current == StartNode)
+		{
+			for (auto&& e : StartEdges)
+			{
+				Open(e.first, Current, e.second, TargetPos);
+			}
+			if (DirectCost >= 0)
+			{
+				Open(GoalNode, Current, DirectCost, TargetPos);
+			}
+			continue;
+		}
+		for (const TilePortalGraph::PortalEdge* e = Graph.GetEdgeBegin(Current); e != Graph.GetEdgeEnd(Current); e++)
+		{
+			Open(e->Target, Current, CurrentNode.g + e->Cost, TargetPos);
+		}
+		if (GoalGeneration[Current] == Generation)
+		{
+			Open(GoalNode, Current, CurrentNode.g + GoalCost[Current], TargetPos);
+		}
+	}
+	return false;
+}
+
+bool HierarchicalPathFinder::SearchHierarchy(bool NeedPath)
+{
+	//起点与终点的簇内距离作为双向搜索的初始距离，同一个簇内的直接路径更短时不经过入口
+	//只需要距离时不展开捷径
+	float Cost = -1.0f;
+	if (!StartEdges.empty() && !GoalEdges.empty())
+	{
+		Cost = HierarchyQuery->Run(StartEdges, GoalEdges, NeedPath ? &PortalPath : nullptr);
+		LastAbstractExpandedNum += HierarchyQuery->GetLastSettledNum();
+	}
+	if (DirectCost >= 0 && (Cost < 0 || DirectCost <= Cost))
+	{
+		PortalPath.clear();
+		Cost = DirectCost;
+	}
+	PathCost = Cost;
+	return Cost >= 0;
+}
+
+bool HierarchicalPathFinder::Refine(int FromSpan, int ToSpan, std::vector<int>& OutPath)
+{
+	//入口序列两端加上起点与终点，相邻两个Span在不同簇时是一条跨簇的连接，否则在簇内搜索
+	OutPath.emplace_back(FromSpan);
+	int Previous = FromSpan;
+	for (size_t i = 0; i <= PortalPath.size(); i++)
+	{
+		int Next = i < PortalPath.size() ? Graph.GetPortalSpan(PortalPath[i]) : ToSpan;
+		if (Next == Previous)
+		{
+			continue;
+		}
+		if (Graph.GetSpanCluster(Next) != Graph.GetSpanCluster(Previous))
+		{
+			OutPath.emplace_back(Next);
+		}
+		else
+		{
+			bool Found = Search->Run(Previous, Next, false);
+			LastRefineExpandedNum += Search->GetSettledNum();
+			if (!Found)
+			{
+				OutPath.clear();
+				return false;
+			}
+			Search->AppendPath(Next, OutPath);
+		}
+		Previous = Next;
+	}
+	return true;
+}
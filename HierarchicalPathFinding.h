@@ -0,0 +1,190 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "glm/glm.hpp"
+#include "PortalHierarchy.h"
+
+class SphereMgr;
+class CompactSpanData;
+class ClusterSearch;
+
+/*
+* 分层寻路的抽象图，每个球构造一个，构造后只读，可以被多个HierarchicalPathFinder共享
+* 簇：ClusterTileNum * ClusterTileNum 个相邻的Tile（按行分块，每块内按经度分段），ClusterTileNum为1时每个Tile就是一个簇
+* 入口：簇边界上连接到另一个簇的Span，同一段边界上相连的一串Span只取最靠近中间的一个，以及它在另一个簇中连接到的Span
+* 边：入口之间跨簇的连接（代价为一格），同一个簇内入口之间的最短距离（只在簇内搜索）
+* 同时预计算每个簇内所有Span与本簇入口之间两个方向的距离（按格数保存为uint16），查询时不需要在起点与终点的簇内搜索
+* 构造前需要先调用SpanData::Compaction与SpanData::BuildLinks，数据改变后需要重新构造
+*/
+class TilePortalGraph
+{
+public:
+	struct PortalEdge
+	{
+		int Target;//入口编号
+		float Cost;
+	};
+	/*
+	* ThreadNum <= 0 时使用硬件线程数，预计算簇内距离时按簇并行
+	*/
+	TilePortalGraph(const SphereMgr& Sphere, int ClusterTileNum, int ThreadNum = 1);
+	/*
+	* SpanData中没有连接时抽象图为空，不能用于寻路
+	*/
+	bool IsValid() const { return Valid; }
+	int GetClusterTileNum() const { return ClusterTileNum; }
+	int GetClusterNum() const { return ClusterNum; }
+	int GetPortalNum() const { return int(PortalSpans.size()); }
+	int GetEdgeNum() const { return int(Edges.size()); }
+	int GetSpanBeginIndex() const { return SpanBeginIndex; }
+	int GetSpanNum() const { return int(SpanCluster.size()); }
+	/*
+	* 参数都是Span编号（SpanData::Compact中的编号）
+	*/
+	int GetSpanCluster(int SpanIndex) const { return SpanCluster[SpanIndex - SpanBeginIndex]; }
+	int GetSpanPortal(int SpanIndex) const { return SpanPortal[SpanIndex - SpanBeginIndex]; }
+	glm::vec3 GetSpanTopPos(int SpanIndex) const;
+	/*
+	* 连接到SpanIndex的Span为 GetReverseLinkedSpan(k)，k在[GetReverseLinkBegin, GetReverseLinkEnd)中
+	* 连接不一定是双向的，反向搜索需要使用反向连接
+	*/
+	int GetReverseLinkBegin(int SpanIndex) const { return ReverseBegin[SpanIndex - SpanBeginIndex]; }
+	int GetReverseLinkEnd(int SpanIndex) const { return ReverseBegin[SpanIndex - SpanBeginIndex + 1]; }
+	int GetReverseLinkedSpan(int LinkIndex) const { return ReverseLinks[LinkIndex]; }
+	/*
+	* 入口按所属的簇连续编号，簇Cluster的入口为 [GetClusterPortalBegin(Cluster), GetClusterPortalBegin(Cluster + 1))
+	*/
+	int GetClusterPortalBegin(int Cluster) const { return ClusterPortalBegin[Cluster]; }
+	int GetPortalSpan(int Portal) const { return PortalSpans[Portal]; }
+	int GetPortalCluster(int Portal) const { return GetSpanCluster(PortalSpans[Portal]); }
+	const glm::vec3& GetPortalPos(int Portal) const { return PortalPos[Portal]; }
+	const PortalEdge* GetEdgeBegin(int Portal) const { return Edges.data() + EdgeBegin[Portal]; }
+	const PortalEdge* GetEdgeEnd(int Portal) const { return Edges.data() + EdgeBegin[Portal + 1]; }
+	float GetStride() const;
+	/*
+	* Cluster中Span与入口之间的距离是否已经预计算，簇内距离超过表的范围时没有预计算，需要在簇内搜索
+	*/
+	bool HasPortalDistances(int Cluster) const { return ClusterTableBegin[Cluster] >= 0; }
+	/*
+	* 簇内从SpanIndex走到本簇入口Portal、从Portal走到SpanIndex的距离，到不了时返回负数，需要HasPortalDistances
+	*/
+	float GetDistanceToPortal(int SpanIndex, int Portal) const { return StepsToCost(ToPortalSteps[GetTableIndex(SpanIndex, Portal)]); }
+	float GetDistanceFromPortal(int Portal, int SpanIndex) const { return StepsToCost(FromPortalSteps[GetTableIndex(SpanIndex, Portal)]); }
+	const CompactSpanData& GetCompact() const { return Compact; }
+	/*
+	* 抽象图占用的内存（字节）
+	*/
+	size_t GetMemorySize() const;
+private:
+	void BuildClusters();
+	void BuildReverseLinks();
+	void BuildPortals(std::vector<std::vector<PortalEdge>>& PortalEdges);
+	void BuildEdges(std::vector<std::vector<PortalEdge>>& PortalEdges, int ThreadNum);
+	size_t GetTableIndex(int SpanIndex, int Portal) const
+	{
+		int Cluster = SpanCluster[SpanIndex - SpanBeginIndex];
+		int Begin = ClusterPortalBegin[Cluster];
+		return size_t(ClusterTableBegin[Cluster]) + size_t(SpanClusterIndex[SpanIndex - SpanBeginIndex]) * (ClusterPortalBegin[Cluster + 1] - Begin) + (Portal - Begin);
+	}
+	float StepsToCost(uint16_t Steps) const { return Steps == NoPortalDistance ? -1.0f : Steps * Stride; }
+private:
+	static constexpr uint16_t NoPortalDistance = 0xffff;
+	const SphereMgr& Sphere;
+	const CompactSpanData& Compact;
+	int ClusterTileNum = 1;
+	int ClusterNum = 0;
+	int SpanBeginIndex = 0;
+	float Stride = 0.0f;
+	bool Valid = false;
+	std::vector<glm::vec3> TileUp;//每个Tile的向上方向，按TileIndex索引
+	std::vector<int> TileCluster;//按TileIndex索引
+	std::vector<int> SpanCluster;//按 Span编号 - SpanBeginIndex 索引
+	std::vector<int> SpanPortal;//按 Span编号 - SpanBeginIndex 索引，不是入口时为-1
+	std::vector<int> ReverseBegin;//按 Span编号 - SpanBeginIndex 索引
+	std::vector<int> ReverseLinks;//Span编号
+	std::vector<int> ClusterPortalBegin;
+	std::vector<int> PortalSpans;
+	std::vector<glm::vec3> PortalPos;
+	std::vector<int> EdgeBegin;
+	std::vector<PortalEdge> Edges;
+	std::vector<int> SpanClusterIndex;//Span在所属簇中的序号，按 Span编号 - SpanBeginIndex 索引
+	std::vector<int64_t> ClusterTableBegin;//簇在距离表中的起始位置，没有预计算时为-1
+	std::vector<uint16_t> ToPortalSteps;//簇内第i个Span到第j个入口的格数在 ClusterTableBegin + i * 簇的入口数 + j
+	std::vector<uint16_t> FromPortalSteps;//同上，第j个入口到第i个Span
+};
+
+/*
+* 分层A*：先在TilePortalGraph上搜索入口序列，再只在路径经过的簇内细化成Span路径
+* 起点与终点先在各自的簇内搜索到本簇的入口，作为临时节点加入抽象图
+* 得到的路径不一定最短，但不受SpanPathFinder::MaxSearchNodes的限制，适合跨越整个球的长路径
+* 起点与终点不在同一个连通分量（CompactSpanData::BuildComponents）时直接返回
+* 设置了与Graph匹配的PortalHierarchy时，抽象图上的搜索改为收缩层次上的双向搜索，结果是抽象图上的最短路径
+* 每个线程使用自己的HierarchicalPathFinder，Graph的生命周期需要比本对象长
+*/
+class HierarchicalPathFinder
+{
+public:
+	explicit HierarchicalPathFinder(const TilePortalGraph& Graph);
+	~HierarchicalPathFinder();
+	/*
+	* 与SpanPathFinder::FindPath相同，结果写入OutPath（包括起点和终点），找不到路径时返回false
+	*/
+	bool FindPath(int FromSpan, int ToSpan, std::vector<int>& OutPath);
+	/*
+	* 只搜索抽象图，返回经过入口的路径长度（不细化成Span路径），找不到路径时返回负数
+	* 使用PortalHierarchy时不展开捷径，GetLastPortalPath为空
+	*/
+	float FindDistance(int FromSpan, int ToSpan);
+	/*
+	* Hierarchy不是由Graph生成的（PortalHierarchy::Matches）时忽略，继续使用抽象图上的A*，返回是否使用
+	* 为空时恢复使用A*，Hierarchy的生命周期需要比本对象长
+	*/
+	bool SetHierarchy(const PortalHierarchy* Hierarchy);
+	bool HasHierarchy() const { return HierarchyQuery != nullptr; }
+	/*
+	* 上一次FindPath在抽象图上展开的入口数
+	*/
+	int GetLastAbstractExpandedNum() const { return LastAbstractExpandedNum; }
+	/*
+	* 上一次FindPath在簇内展开的Span数（包括连接起点终点与细化路径）
+	*/
+	int GetLastRefineExpandedNum() const { return LastRefineExpandedNum; }
+	/*
+	* 上一次FindPath经过的入口，按路径顺序
+	*/
+	const std::vector<int>& GetLastPortalPath() const { return PortalPath; }
+private:
+	struct AbstractNode
+	{
+		float g;
+		float f;
+		int Parent;
+		uint32_t Generation;
+		bool Closed;
+	};
+	bool BeginQuery(int FromSpan, int ToSpan);
+	/*
+	* NeedPath为false时只计算PathCost，使用PortalHierarchy时不展开捷径，PortalPath为空
+	*/
+	bool SearchAbstract(int FromSpan, int ToSpan, bool NeedPath);
+	bool SearchHierarchy(bool NeedPath);
+	bool Refine(int FromSpan, int ToSpan, std::vector<int>& OutPath);
+	void Open(int Node, int Parent, float g, const glm::vec3& TargetPos);
+private:
+	const TilePortalGraph& Graph;
+	std::unique_ptr<ClusterSearch> Search;
+	std::unique_ptr<PortalHierarchy::Query> HierarchyQuery;
+	std::vector<AbstractNode> Nodes;//入口，最后两个是起点与终点
+	std::vector<std::pair<float, int>> OpenHeap;
+	std::vector<std::pair<int, float>> StartEdges;//起点到本簇入口的距离
+	std::vector<float> GoalCost;//入口到终点的距离，按入口编号索引，GoalGeneration不等于Generation时表示到不了
+	std::vector<uint32_t> GoalGeneration;
+	std::vector<std::pair<int, float>> GoalEdges;//本簇入口到终点的距离
+	float DirectCost = -1.0f;//起点与终点在同一个簇内时簇内的距离，到不了为负数
+	float PathCost = -1.0f;//上一次SearchAbstract得到的路径长度
+	std::vector<int> PortalPath;
+	uint32_t Generation = 0;
+	int LastAbstractExpandedNum = 0;
+	int LastRefineExpandedNum = 0;
+};
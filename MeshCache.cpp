@@ -0,0 +1,182 @@
+#include "MeshCache.h"
+#include "SceneMgr.h"
+#include "FileMapping.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<glm::vec3>::value && sizeof(glm::vec3) == 12, "vertices are stored as packed xyz");
+
+namespace
+{
+	const char MeshCacheMagic[8] = { 'V','O','X','M','E','S','H','\0' };
+
+	struct MeshCacheHeader
+	{
+		char Magic[8];
+		uint32_t Version;
+		uint32_t HeaderSize;
+		uint64_t SourceHash;
+		uint64_t PayloadChecksum;
+		uint32_t VertexNum;
+		uint32_t IndexNum;
+		float ModelSpaceMin[3];
+		float ModelSpaceMax[3];
+	};
+
+	bool ReadWholeFile(const std::string& Path, std::string& Content)
+	{
+		std::ifstream File(Path, std::ios::binary);
+		if (!File)
+		{
+			return false;
+		}
+		std::ostringstream Stream;
+		Stream << File.rdbuf();
+		Content = Stream.str();
+		return true;
+	}
+
+	/*
+	* 源文件比缓存新时，比较源文件内容的哈希，读取的源文件内容留在Source中
+	* 内容没有变化时Touch为true，需要在缓存文件的映射关闭之后把缓存的时间更新为SourceTime
+	*/
+	bool IsCacheUpToDate(const std::string& SourcePath, const std::string& CachePath, uint64_t SourceHash, std::string& Source,
+		bool& Touch, std::filesystem::file_time_type& SourceTime)
+	{
+		Touch = false;
+		std::error_code Error;
+		SourceTime = std::filesystem::last_write_time(SourcePath, Error);
+		if (Error)
+		{
+			//没有源文件时只能使用缓存
+			return true;
+		}
+		auto CacheTime = std::filesystem::last_write_time(CachePath, Error);
+		if (Error)
+		{
+			return false;
+		}
+		if (SourceTime <= CacheTime)
+		{
+			return true;
+		}
+		if (!ReadWholeFile(SourcePath, Source))
+		{
+			Source.clear();
+			return false;
+		}
+		if (HashBytes(Source.data(), Source.size()) != SourceHash)
+		{
+			return false;
+		}
+		Touch = true;
+		return true;
+	}
+}
+
+namespace meshCache
+{
+	std::string GetCachePath(const std::string& SourcePath, const std::string& CacheDirectory)
+	{
+		if (CacheDirectory.empty())
+		{
+			return SourcePath + ".meshbin";
+		}
+		char Name[32];
+		snprintf(Name, sizeof(Name), "%016llx.meshbin", (unsigned long long)HashBytes(SourcePath.data(), SourcePath.size()));
+		return (std::filesystem::path(CacheDirectory) / Name).string();
+	}
+
+	bool LoadMeshCache(const std::string& SourcePath, const std::string& CachePath, MeshData& Mesh, std::string& Source)
+	{
+		Source.clear();
+		MappedFile File;
+		if (!File.Open(CachePath) || File.GetSize() < sizeof(MeshCacheHeader))
+		{
+			return false;
+		}
+		MeshCacheHeader Header;
+		memcpy(&Header, File.GetData(), sizeof(Header));
+		if (memcmp(Header.Magic, MeshCacheMagic, sizeof(MeshCacheMagic)) != 0 || Header.Version != MeshCacheVersion || Header.HeaderSize != sizeof(MeshCacheHeader))
+		{
+			return false;
+		}
+		size_t VertexBytes = size_t(Header.VertexNum) * sizeof(glm::vec3);
+		size_t IndexBytes = size_t(Header.IndexNum) * sizeof(int);
+		if (File.GetSize() != sizeof(MeshCacheHeader) + VertexBytes + IndexBytes)
+		{
+			return false;
+		}
+		const uint8_t* Payload = File.GetData() + sizeof(MeshCacheHeader);
+		bool Touch = false;
+		std::filesystem::file_time_type SourceTime;
+		if (HashBytes(Payload, VertexBytes + IndexBytes) != Header.PayloadChecksum || !IsCacheUpToDate(SourcePath, CachePath, Header.SourceHash, Source, Touch, SourceTime))
+		{
+			return false;
+		}
+
+		Mesh.worldVertices.resize(Header.VertexNum);
+		memcpy(Mesh.worldVertices.data(), Payload, VertexBytes);
+		Mesh.indices.resize(Header.IndexNum);
+		memcpy(Mesh.indices.data(), Payload + VertexBytes, IndexBytes);
+		Mesh.ModelSpaceMin = glm::vec3(Header.ModelSpaceMin[0], Header.ModelSpaceMin[1], Header.ModelSpaceMin[2]);
+		Mesh.ModelSpaceMax = glm::vec3(Header.ModelSpaceMax[0], Header.ModelSpaceMax[1], Header.ModelSpaceMax[2]);
+		Source.clear();
+		if (Touch)
+		{
+			//内容没有变化，更新缓存的时间，下次不用再计算哈希；缓存还映射着时Windows上不能修改，所以先关闭
+			//修改时间失败时重新写一次缓存，新文件的时间晚于源文件，效果相同
+			File.Close();
+			std::error_code Error;
+			std::filesystem::last_write_time(CachePath, SourceTime, Error);
+			if (Error)
+			{
+				SaveMeshCache(CachePath, Mesh, Header.SourceHash);
+			}
+		}
+		return true;
+	}
+
+	bool SaveMeshCache(const std::string& CachePath, const MeshData& Mesh, uint64_t SourceHash)
+	{
+		size_t VertexBytes = Mesh.worldVertices.size() * sizeof(glm::vec3);
+		size_t IndexBytes = Mesh.indices.size() * sizeof(int);
+		MeshCacheHeader Header = {};
+		memcpy(Header.Magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+		Header.Version = MeshCacheVersion;
+		Header.HeaderSize = sizeof(MeshCacheHeader);
+		Header.SourceHash = SourceHash;
+		Header.PayloadChecksum = HashBytes(Mesh.indices.data(), IndexBytes, HashBytes(Mesh.worldVertices.data(), VertexBytes));
+		Header.VertexNum = uint32_t(Mesh.worldVertices.size());
+		Header.IndexNum = uint32_t(Mesh.indices.size());
+		for (int i = 0; i < 3; i++)
+		{
+			Header.ModelSpaceMin[i] = Mesh.ModelSpaceMin[i];
+			Header.ModelSpaceMax[i] = Mesh.ModelSpaceMax[i];
+		}
+
+		//先写临时文件再改名，其它进程不会读到写了一半的缓存
+		std::string TempPath = CachePath + ".tmp";
+		{
+			std::ofstream File(TempPath, std::ios::binary | std::ios::trunc);
+			if (!File)
+			{
+				return false;
+			}
+			File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+			File.write(reinterpret_cast<const char*>(Mesh.worldVertices.data()), VertexBytes);
+			File.write(reinterpret_cast<const char*>(Mesh.indices.data()), IndexBytes);
+			if (!File)
+			{
+				return false;
+			}
+		}
+		std::error_code Error;
+		std::filesystem::rename(TempPath, CachePath, Error);
+		return !Error;
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+struct MeshData;
+
+/*
+* 模型的二进制缓存
+* 缓存文件保存紧密排列的顶点、索引和模型空间的AABB，加载时映射整个文件
+* 缓存中记录了源json文件内容的哈希：源文件比缓存新时先比较哈希，内容没有变化则继续使用缓存
+*/
+namespace meshCache
+{
+	const uint32_t MeshCacheVersion = 1;
+
+	/*
+	* 源文件对应的缓存文件路径
+	* CacheDirectory为空时缓存放在源文件旁边，否则放在CacheDirectory中，文件名为源文件路径的哈希
+	*/
+	std::string GetCachePath(const std::string& SourcePath, const std::string& CacheDirectory);
+	/*
+	* 读取缓存，缓存不存在、已经过期或者校验失败时返回false
+	* 为了比较哈希读取过源文件（源文件比缓存新）而缓存已经过期时，源文件的内容留在Source中，调用者不需要再读一次，否则Source为空
+	*/
+	bool LoadMeshCache(const std::string& SourcePath, const std::string& CachePath, MeshData& Mesh, std::string& Source);
+	/*
+	* 写入缓存，SourceHash为源文件内容的哈希
+	*/
+	bool SaveMeshCache(const std::string& CachePath, const MeshData& Mesh, uint64_t SourceHash);
+}
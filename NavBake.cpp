@@ -0,0 +1,403 @@
+#include "NavBake.h"
+#include "SphereSegmentation.h"
+#include "SpanData.h"
+#include "SceneMgr.h"
+#include "FileMapping.h"
+#include <fstream>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<Span>::value && sizeof(Span) == 12, "Span is stored as-is in the bake file");
+static_assert(std::is_trivially_copyable<CompactSpanList>::value && sizeof(CompactSpanList) == 32, "CompactSpanList is stored as-is in the bake file");
+
+namespace
+{
+	const char NavBakeMagic[8] = { 'V','O','X','N','A','V','B','\0' };
+	const size_t SectionAlignment = 16;
+
+	struct FileHeader
+	{
+		char Magic[8];
+		uint32_t Version;
+		uint32_t HeaderSize;
+		uint64_t SceneHash;
+		uint64_t PayloadSize;
+		uint64_t PayloadChecksum;
+		uint32_t SphereNum;
+		uint32_t DictionaryNum;
+		uint32_t ListNum;
+		uint32_t SpanNum;
+		uint32_t ExtraNeighborNum;
+		uint32_t LinkNum;
+		float LinkClimbHeight;
+		uint32_t ComponentNum;
+	};
+
+	/*
+	* 模型顶点与索引的哈希，模型文件的内容改变时场景哈希随之改变
+	*/
+	uint64_t HashMesh(const MeshData& Mesh)
+	{
+		uint64_t Hash = HashBytes(Mesh.worldVertices.data(), Mesh.worldVertices.size() * sizeof(glm::vec3));
+		return HashBytes(Mesh.indices.data(), Mesh.indices.size() * sizeof(int), Hash);
+	}
+
+	struct SphereRecord
+	{
+		float Center[3];
+		float Radius;
+		int32_t TileSize;
+		float Stride;
+		float CellHeight;
+		float MinHeight;
+		float MaxHeight;
+		float ClimbHeight;
+		int32_t SphereId;
+		int32_t RowNum;
+		int32_t TileNum;
+	};
+
+	struct TileRecord
+	{
+		float CenterPos[3];
+		float AxisU[3];
+		float AxisV[3];
+		int32_t TileIndex;
+		int32_t RowIndex;
+		int32_t ColIndex;
+	};
+
+	size_t AlignUp(size_t Offset)
+	{
+		return (Offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+	}
+
+	bool SameParams(const SphereRecord& Record, const NavBakeParams& Params)
+	{
+		return Record.Center[0] == Params.Center.x && Record.Center[1] == Params.Center.y && Record.Center[2] == Params.Center.z
+			&& Record.Radius == Params.Radius && Record.TileSize == Params.TileSize && Record.Stride == Params.Stride
+			&& Record.CellHeight == Params.CellHeight && Record.MinHeight == Params.MinHeight && Record.MaxHeight == Params.MaxHeight
+			&& Record.ClimbHeight == Params.ClimbHeight;
+	}
+
+	/*
+	* 顺序写入各段，同时计算文件头之后所有数据的校验和
+	*/
+	class BakeWriter
+	{
+	public:
+		explicit BakeWriter(const std::string& Path)
+			:File(Path, std::ios::binary | std::ios::trunc)
+		{
+		}
+		bool IsOpen() const { return File.is_open(); }
+		void Write(const void* Data, size_t Size)
+		{
+			if (Size == 0)
+			{
+				return;
+			}
+			File.write(static_cast<const char*>(Data), Size);
+			if (Offset >= PayloadBegin)
+			{
+				Checksum = HashBytes(Data, Size, Checksum);
+			}
+			Offset += Size;
+		}
+		void Align()
+		{
+			static const uint8_t Zero[SectionAlignment] = {};
+			Write(Zero, AlignUp(Offset) - Offset);
+		}
+		void BeginPayload()
+		{
+			Align();
+			PayloadBegin = Offset;
+		}
+		bool Finish(FileHeader& Header)
+		{
+			Align();
+			Header.PayloadSize = Offset - PayloadBegin;
+			Header.PayloadChecksum = Checksum;
+			File.seekp(0);
+			File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+			File.close();
+			return !File.fail();
+		}
+	private:
+		std::ofstream File;
+		uint64_t Offset = 0;
+		uint64_t PayloadBegin = ~0ull;
+		uint64_t Checksum = HashBytes(nullptr, 0);
+	};
+
+	/*
+	* 在映射的内存上按段读取，越界时返回nullptr
+	*/
+	class BakeReader
+	{
+	public:
+		BakeReader(const uint8_t* Data, size_t Size, size_t Offset)
+			:Data(Data), Size(Size), Offset(Offset)
+		{
+		}
+		template<typename T>
+		const T* Read(size_t Count)
+		{
+			size_t Begin = AlignUp(Offset);
+			if (Begin > Size || Count > (Size - Begin) / sizeof(T))
+			{
+				return nullptr;
+			}
+			Offset = Begin + Count * sizeof(T);
+			return reinterpret_cast<const T*>(Data + Begin);
+		}
+	private:
+		const uint8_t* Data;
+		size_t Size;
+		size_t Offset;
+	};
+}
+
+namespace navBake
+{
+	bool SaveNavBake(const std::string& Path, const std::vector<SphereMgr>& Spheres, const std::vector<NavBakeParams>& Params, uint64_t SceneHash)
+	{
+		auto&& instance = SpanData::getInstance();
+		auto&& Compact = instance.Compact;
+		if (Spheres.size() != Params.size() || Compact.GetListNum() != instance.Data.size() || !Compact.HasLinks() || !Compact.HasComponents())
+		{
+			return false;
+		}
+		for (auto&& p : Params)
+		{
+			if (p.ClimbHeight != Compact.GetLinkClimbHeight())
+			{
+				return false;
+			}
+		}
+
+		BakeWriter Writer(Path);
+		if (!Writer.IsOpen())
+		{
+			return false;
+		}
+		FileHeader Header = {};
+		memcpy(Header.Magic, NavBakeMagic, sizeof(NavBakeMagic));
+		Header.Version = NavBakeVersion;
+		Header.HeaderSize = sizeof(FileHeader);
+		Header.SceneHash = SceneHash;
+		Header.SphereNum = uint32_t(Spheres.size());
+		Header.DictionaryNum = uint32_t(instance.Dictionary.size());
+		Header.ListNum = uint32_t(Compact.GetListNum());
+		Header.SpanNum = uint32_t(Compact.GetSpanNum());
+		Header.ExtraNeighborNum = uint32_t(Compact.GetExtraNeighborNum());
+		Header.LinkNum = uint32_t(Compact.GetLinkNum());
+		Header.LinkClimbHeight = Compact.GetLinkClimbHeight();
+		Header.ComponentNum = uint32_t(Compact.GetComponentNum());
+		Writer.Write(&Header, sizeof(Header));
+		Writer.BeginPayload();
+
+		for (int i = 0; i < Spheres.size(); i++)
+		{
+			const SphereMgr& Sphere = Spheres[i];
+			SphereRecord Record = {};
+			Record.Center[0] = Params[i].Center.x;
+			Record.Center[1] = Params[i].Center.y;
+			Record.Center[2] = Params[i].Center.z;
+			Record.Radius = Params[i].Radius;
+			Record.TileSize = Params[i].TileSize;
+			Record.Stride = Params[i].Stride;
+			Record.CellHeight = Params[i].CellHeight;
+			Record.MinHeight = Params[i].MinHeight;
+			Record.MaxHeight = Params[i].MaxHeight;
+			Record.ClimbHeight = Params[i].ClimbHeight;
+			Record.SphereId = Sphere.SphereId;
+			Record.RowNum = int32_t(Sphere.Tiles.size());
+			Record.TileNum = int32_t(Sphere.FlatTiles.size());
+			Writer.Write(&Record, sizeof(Record));
+		}
+		for (auto&& Sphere : Spheres)
+		{
+			Writer.Align();
+			Writer.Write(Sphere.RowBeginIndex.data(), Sphere.RowBeginIndex.size() * sizeof(int));
+			Writer.Align();
+			for (auto&& t : Sphere.FlatTiles)
+			{
+				TileRecord Record = { { t.CenterPos.x, t.CenterPos.y, t.CenterPos.z }, { t.axis_u.x, t.axis_u.y, t.axis_u.z }, { t.axis_v.x, t.axis_v.y, t.axis_v.z }, t.TileIndex, t.RowIndex, t.ColIndex };
+				Writer.Write(&Record, sizeof(Record));
+			}
+		}
+		Writer.Align();
+		for (auto&& Range : instance.Dictionary)
+		{
+			int32_t Pair[2] = { Range.first, Range.second };
+			Writer.Write(Pair, sizeof(Pair));
+		}
+		Writer.Align();
+		Writer.Write(Compact.GetSpanOffsets(), (Compact.GetListNum() + 1) * sizeof(int));
+		Writer.Align();
+		Writer.Write(Compact.GetLists(), Compact.GetListNum() * sizeof(CompactSpanList));
+		Writer.Align();
+		Writer.Write(Compact.GetExtraNeighborOffsets(), (Compact.GetListNum() + 1) * sizeof(int));
+		Writer.Align();
+		Writer.Write(Compact.GetExtraNeighbors(), Compact.GetExtraNeighborNum() * sizeof(int));
+		Writer.Align();
+		Writer.Write(Compact.GetSpans(), Compact.GetSpanNum() * sizeof(Span));
+		Writer.Align();
+		Writer.Write(Compact.GetLinkOffsets(), (Compact.GetSpanNum() + 1) * sizeof(int));
+		Writer.Align();
+		Writer.Write(Compact.GetLinkSpans(), Compact.GetLinkNum() * sizeof(int));
+		Writer.Align();
+		Writer.Write(Compact.GetSpanComponents(), Compact.GetSpanNum() * sizeof(int));
+		Writer.Align();
+		Writer.Write(Compact.GetComponentSizes(), Compact.GetComponentNum() * sizeof(int));
+		return Writer.Finish(Header);
+	}
+
+	bool LoadNavBake(const std::string& Path, std::vector<SphereMgr>& Spheres, const std::vector<NavBakeParams>& Params, uint64_t SceneHash)
+	{
+		auto Mapping = std::make_shared<MappedFile>();
+		if (!Mapping->Open(Path) || Mapping->GetSize() < sizeof(FileHeader))
+		{
+			return false;
+		}
+		const uint8_t* Data = Mapping->GetData();
+		FileHeader Header;
+		memcpy(&Header, Data, sizeof(Header));
+		if (memcmp(Header.Magic, NavBakeMagic, sizeof(NavBakeMagic)) != 0 || Header.Version != NavBakeVersion
+			|| Header.HeaderSize != sizeof(FileHeader) || Header.SceneHash != SceneHash || Header.SphereNum != Params.size())
+		{
+			return false;
+		}
+		size_t PayloadBegin = AlignUp(sizeof(FileHeader));
+		if (PayloadBegin > Mapping->GetSize() || Header.PayloadSize != Mapping->GetSize() - PayloadBegin)
+		{
+			return false;
+		}
+
+		BakeReader Reader(Data, Mapping->GetSize(), PayloadBegin);
+		const SphereRecord* Records = Reader.Read<SphereRecord>(Header.SphereNum);
+		if (!Records)
+		{
+			return false;
+		}
+		for (int i = 0; i < Header.SphereNum; i++)
+		{
+			if (!SameParams(Records[i], Params[i]))
+			{
+				return false;
+			}
+		}
+		if (HashBytes(Data + PayloadBegin, Header.PayloadSize) != Header.PayloadChecksum)
+		{
+			return false;
+		}
+
+		std::vector<SphereMgr> LoadedSpheres(Header.SphereNum);
+		for (int i = 0; i < Header.SphereNum; i++)
+		{
+			const SphereRecord& Record = Records[i];
+			const int* RowBegin = Reader.Read<int>(Record.RowNum + 1);
+			const TileRecord* TileRecords = Reader.Read<TileRecord>(Record.TileNum);
+			if (!RowBegin || !TileRecords)
+			{
+				return false;
+			}
+			std::vector<Tile> Flat(Record.TileNum);
+			for (int t = 0; t < Record.TileNum; t++)
+			{
+				const TileRecord& tr = TileRecords[t];
+				Flat[t].CenterPos = glm::vec3(tr.CenterPos[0], tr.CenterPos[1], tr.CenterPos[2]);
+				Flat[t].axis_u = glm::vec3(tr.AxisU[0], tr.AxisU[1], tr.AxisU[2]);
+				Flat[t].axis_v = glm::vec3(tr.AxisV[0], tr.AxisV[1], tr.AxisV[2]);
+				Flat[t].TileIndex = tr.TileIndex;
+				Flat[t].RowIndex = tr.RowIndex;
+				Flat[t].ColIndex = tr.ColIndex;
+			}
+			glm::vec3 Center(Record.Center[0], Record.Center[1], Record.Center[2]);
+			LoadedSpheres[i].Restore(Center, Record.Radius, Record.TileSize, Record.Stride, Record.SphereId,
+				std::move(Flat), std::vector<int>(RowBegin, RowBegin + Record.RowNum + 1));
+		}
+
+		const int32_t* Dictionary = Reader.Read<int32_t>(size_t(Header.DictionaryNum) * 2);
+		const int* SpanOffsets = Reader.Read<int>(size_t(Header.ListNum) + 1);
+		const CompactSpanList* Lists = Reader.Read<CompactSpanList>(Header.ListNum);
+		const int* ExtraNeighborOffsets = Reader.Read<int>(size_t(Header.ListNum) + 1);
+		const int* ExtraNeighbors = Reader.Read<int>(Header.ExtraNeighborNum);
+		const Span* Spans = Reader.Read<Span>(Header.SpanNum);
+		const int* LinkOffsets = Reader.Read<int>(size_t(Header.SpanNum) + 1);
+		const int* LinkSpans = Reader.Read<int>(Header.LinkNum);
+		const int* SpanComponents = Reader.Read<int>(Header.SpanNum);
+		const int* ComponentSizes = Reader.Read<int>(Header.ComponentNum);
+		if (!Dictionary || !SpanOffsets || !Lists || !ExtraNeighborOffsets || !ExtraNeighbors || !Spans || !LinkOffsets || !LinkSpans || !SpanComponents || !ComponentSizes
+			|| SpanOffsets[Header.ListNum] != int(Header.SpanNum) || ExtraNeighborOffsets[Header.ListNum] != int(Header.ExtraNeighborNum) || LinkOffsets[Header.SpanNum] != int(Header.LinkNum))
+		{
+			return false;
+		}
+
+		auto&& instance = SpanData::getInstance();
+		instance.Dictionary.clear();
+		for (int i = 0; i < Header.DictionaryNum; i++)
+		{
+			instance.Dictionary.emplace_back(Dictionary[i * 2], Dictionary[i * 2 + 1]);
+		}
+		std::vector<SpanList>().swap(instance.Data);
+		instance.ReadOnly = true;
+		const uint8_t* Base = Data;
+		instance.Compact.Attach(Spans, int(Header.SpanNum), SpanOffsets, Lists, int(Header.ListNum), ExtraNeighborOffsets, ExtraNeighbors, std::shared_ptr<const void>(Mapping, Base));
+		instance.Compact.AttachLinks(LinkOffsets, LinkSpans, Header.LinkClimbHeight);
+		instance.Compact.AttachComponents(SpanComponents, ComponentSizes, int(Header.ComponentNum));
+		Spheres = std::move(LoadedSpheres);
+		return true;
+	}
+
+	bool ReadNavBakeChecksum(const std::string& Path, uint64_t& Checksum)
+	{
+		MappedFile Mapping;
+		if (!Mapping.Open(Path) || Mapping.GetSize() < sizeof(FileHeader))
+		{
+			return false;
+		}
+		FileHeader Header;
+		memcpy(&Header, Mapping.GetData(), sizeof(Header));
+		if (memcmp(Header.Magic, NavBakeMagic, sizeof(NavBakeMagic)) != 0 || Header.Version != NavBakeVersion || Header.HeaderSize != sizeof(FileHeader))
+		{
+			return false;
+		}
+		Checksum = Header.PayloadChecksum;
+		return true;
+	}
+
+	uint64_t HashScene(const SceneMgr& Scene)
+	{
+		//每个模型的内容只计算一次，同一个模型的所有MeshObject使用相同的哈希
+		std::vector<uint64_t> MeshHashes(Scene.Meshes.size());
+		for (int i = 0; i < Scene.Meshes.size(); i++)
+		{
+			MeshHashes[i] = HashMesh(*Scene.Meshes[i]);
+		}
+		uint64_t Hash = HashBytes(nullptr, 0);
+		for (auto&& Object : Scene.MeshObjects)
+		{
+			float Transform[10] = { Object.WorldPos.x, Object.WorldPos.y, Object.WorldPos.z,
+				Object.rotation.x, Object.rotation.y, Object.rotation.z, Object.rotation.w,
+				Object.scale.x, Object.scale.y, Object.scale.z };
+			uint64_t MeshHash = 0;
+			if (Object.MeshId >= 0 && Object.MeshId < MeshHashes.size())
+			{
+				MeshHash = MeshHashes[Object.MeshId];
+			}
+			else
+			{
+				auto It = Scene.MeshMap.find(Object.MeshPathName);
+				MeshHash = It != Scene.MeshMap.end() && It->second ? HashMesh(*It->second) : 0;
+			}
+			Hash = HashBytes(Object.MeshPathName.data(), Object.MeshPathName.size(), Hash);
+			Hash = HashBytes(Transform, sizeof(Transform), Hash);
+			Hash = HashBytes(&MeshHash, sizeof(MeshHash), Hash);
+		}
+		return Hash;
+	}
+}
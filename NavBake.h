@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "glm/glm.hpp"
+
+class SphereMgr;
+class SceneMgr;
+
+/*
+* 烘焙一个球时使用的参数，加载时与文件中保存的参数比较，不同则认为烘焙文件已经失效
+*/
+struct NavBakeParams
+{
+	glm::vec3 Center = { 0,0,0 };
+	float Radius = 0.0f;
+	int TileSize = 0;
+	float Stride = 0.0f;
+	float CellHeight = 0.0f;
+	float MinHeight = 0.0f;
+	float MaxHeight = 0.0f;
+	float ClimbHeight = 0.0f;//Span连接的最大高度差，见SpanData::BuildLinks，所有球必须相同
+};
+
+namespace navBake
+{
+	/*
+	* 烘焙文件格式（小端），每一段都从16字节对齐的位置开始：
+	* 文件头：魔数，版本，场景哈希，数据段的大小与校验和，各数组的长度
+	* 每个球的参数，然后每个球的RowBeginIndex与所有Tile
+	* SpanData::Dictionary，CompactSpanData的SpanOffsets，Lists，额外邻居（ExtraNeighborOffsets与ExtraNeighbors），Spans，Span的连接（LinkOffsets与LinkSpans），每个Span的连通分量编号，每个连通分量的Span数
+	* 加载时映射整个文件，CompactSpanData直接指向映射的内存，不做拷贝
+	*/
+	const uint32_t NavBakeVersion = 6;
+
+	/*
+	* 保存SpanData（必须已经调用过Compaction与BuildLinks，连接的ClimbHeight与Params相同）与所有球，Params与Spheres一一对应
+	*/
+	bool SaveNavBake(const std::string& Path, const std::vector<SphereMgr>& Spheres, const std::vector<NavBakeParams>& Params, uint64_t SceneHash);
+	/*
+	* 加载烘焙文件，替换Spheres与SpanData中的数据
+	* 文件不存在，版本、参数、场景哈希不一致或者校验失败时返回false，此时Spheres与SpanData不会被修改
+	* 加载成功后SpanData::Data为空并且SpanData::ReadOnly为true，只能通过SpanData::Compact读取，要重新烘焙需要先调用SpanData::Clear
+	*/
+	bool LoadNavBake(const std::string& Path, std::vector<SphereMgr>& Spheres, const std::vector<NavBakeParams>& Params, uint64_t SceneHash);
+	/*
+	* 只读取烘焙文件头中数据段的校验和，不校验数据，用作由烘焙结果派生的文件（如PortalHierarchy）的键
+	*/
+	bool ReadNavBakeChecksum(const std::string& Path, uint64_t& Checksum);
+	/*
+	* 场景中所有MeshObject的路径、变换与模型内容（顶点与索引）的哈希，用于判断场景是否改变，需要在模型加载之后调用
+	*/
+	uint64_t HashScene(const SceneMgr& Scene);
+}
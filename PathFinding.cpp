@@ -0,0 +1,241 @@
+#include "PathFinding.h"
+#include "SphereSegmentation.h"
+#include "SpanData.h"
+#include "SpanLandmarks.h"
+#include <algorithm>
+
+SpanPathFinder::SpanPathFinder(const SphereMgr& s)
+	:ClimbHeight(2 * s.Stride), Sphere(s), Compact(SpanData::getInstance().Compact)
+{
+	auto&& instance = SpanData::getInstance();
+	SpanBeginIndex = Compact.GetListSpanBegin(instance.Dictionary[Sphere.SphereId].first);
+	int SpanEndIndex = Compact.GetListSpanEnd(instance.Dictionary[Sphere.SphereId].second);
+
+	TileUp.resize(Sphere.total_tiles_num);
+	for (auto&& Row : Sphere.Tiles)
+	{
+		for (auto&& t : Row)
+		{
+			TileUp[t.TileIndex] = glm::normalize(glm::cross(t.axis_u, t.axis_v));
+		}
+	}
+
+	Nodes.resize(SpanEndIndex - SpanBeginIndex);
+	for (auto&& n : Nodes)
+	{
+		n.Generation = 0;
+	}
+	OpenHeap.reserve(Nodes.size());
+}
+
+const Span& SpanPathFinder::GetSpan(int SpanIndex) const
+{
+	return Compact.GetSpan(SpanIndex);
+}
+
+glm::vec3 SpanPathFinder::GetSpanTopPos(int SpanIndex) const
+{
+	const Span& sp = Compact.GetSpan(SpanIndex);
+	const CompactSpanList& List = Compact.GetList(sp.ListIndex);
+	return List.CenteralWorldPos + TileUp[List.TileIndex] * sp.top;
+}
+
+bool SpanPathFinder::UsesLinks() const
+{
+	return UseLinks && Compact.HasLinks() && Compact.GetLinkClimbHeight() == ClimbHeight;
+}
+
+float SpanPathFinder::Heuristic(int SpanIndex, const glm::vec3& TargetPos) const
+{
+	float h = glm::distance(GetSpanTopPos(SpanIndex), TargetPos);
+	if (UseLandmarks)
+	{
+		int Steps = Landmarks->GetLowerBound(Landmarks->GetForward(SpanIndex), Landmarks->GetBackward(SpanIndex), TargetForward, TargetBackward);
+		h = std::max(h, Steps * Sphere.Stride);
+	}
+	return h;
+}
+
+bool SpanPathFinder::FindPath(int FromSpan, int ToSpan, std::vector<int>& OutPath)
+{
+	OutPath.clear();
+	LastExpandedNum = 0;
+	int SpanNum = GetSpanNum();
+	int Start = FromSpan - SpanBeginIndex;
+	int Goal = ToSpan - SpanBeginIndex;
+	if (Start < 0 || Start >= SpanNum || Goal < 0 || Goal >= SpanNum)
+	{
+		return false;
+	}
+	bool Links = UsesLinks();
+	//连通分量是按连接计算的，只有使用连接搜索时才能直接判断
+	if (Links && Compact.HasComponents() && Compact.GetSpanComponent(FromSpan) != Compact.GetSpanComponent(ToSpan))
+	{
+		return false;
+	}
+
+	Generation++;
+	if (Generation == 0)
+	{
+		//计数器回绕，清掉所有旧的标记
+		for (auto&& n : Nodes)
+		{
+			n.Generation = 0;
+		}
+		Generation = 1;
+	}
+	OpenHeap.clear();
+
+	glm::vec3 TargetPos = GetSpanTopPos(ToSpan);
+	//路标表也是按连接计算的
+	UseLandmarks = Links && Landmarks && Landmarks->GetLandmarkNum() > 0 && Landmarks->GetClimbHeight() == ClimbHeight
+		&& Landmarks->GetSpanBeginIndex() == SpanBeginIndex && Landmarks->GetSpanNum() == SpanNum;
+	if (UseLandmarks)
+	{
+		TargetForward = Landmarks->GetForward(ToSpan);
+		TargetBackward = Landmarks->GetBackward(ToSpan);
+	}
+
+	SearchNode& StartNode = Nodes[Start];
+	StartNode.g = 0;
+	StartNode.f = Heuristic(FromSpan, TargetPos);
+	StartNode.Parent = -1;
+	StartNode.Generation = Generation;
+	HeapPush(Start);
+
+	while (!OpenHeap.empty())
+	{
+		int Current = HeapPop();
+		SearchNode& CurrentNode = Nodes[Current];
+		CurrentNode.HeapIndex = ClosedMark;
+		LastExpandedNum++;
+		if (LastExpandedNum > MaxSearchNodes)
+		{
+			break;
+		}
+
+		if (Current == Goal)
+		{
+			for (int n = Current; n != -1; n = Nodes[n].Parent)
+			{
+				OutPath.emplace_back(n + SpanBeginIndex);
+			}
+			std::reverse(OutPath.begin(), OutPath.end());
+			return true;
+		}
+
+		if (Links)
+		{
+			int LinkEnd = Compact.GetLinkEnd(Current + SpanBeginIndex);
+			for (int k = Compact.GetLinkBegin(Current + SpanBeginIndex); k < LinkEnd; k++)
+			{
+				Relax(Current, Compact.GetLinkedSpan(k) - SpanBeginIndex, TargetPos);
+			}
+			continue;
+		}
+
+		const Span& CurrentSpan = Compact.GetSpan(Current + SpanBeginIndex);
+		Compact.ForEachNeighbor(CurrentSpan.ListIndex, [&](int NeighborListIndex)
+		{
+			int NeighborSpanEnd = Compact.GetListSpanEnd(NeighborListIndex);
+			for (int j = Compact.GetListSpanBegin(NeighborListIndex); j < NeighborSpanEnd; j++)
+			{
+				if (std::abs(Compact.GetSpan(j).top - CurrentSpan.top) > ClimbHeight)
+				{
+					continue;
+				}
+				Relax(Current, j - SpanBeginIndex, TargetPos);
+			}
+		});
+	}
+	return false;
+}
+
+void SpanPathFinder::Relax(int Current, int Neighbor, const glm::vec3& TargetPos)
+{
+	SearchNode& NeighborNode = Nodes[Neighbor];
+	float g = Nodes[Current].g + Sphere.Stride;
+	if (NeighborNode.Generation != Generation)
+	{
+		NeighborNode.Generation = Generation;
+		NeighborNode.g = g;
+		NeighborNode.f = g + Heuristic(Neighbor + SpanBeginIndex, TargetPos);
+		NeighborNode.Parent = Current;
+		HeapPush(Neighbor);
+	}
+	else if (NeighborNode.HeapIndex != ClosedMark && g < NeighborNode.g)
+	{
+		NeighborNode.f -= NeighborNode.g - g;
+		NeighborNode.g = g;
+		NeighborNode.Parent = Current;
+		HeapSiftUp(NeighborNode.HeapIndex);
+	}
+}
+
+void SpanPathFinder::HeapPush(int Node)
+{
+	Nodes[Node].HeapIndex = int(OpenHeap.size());
+	OpenHeap.emplace_back(Node);
+	HeapSiftUp(Nodes[Node].HeapIndex);
+}
+
+int SpanPathFinder::HeapPop()
+{
+	int Top = OpenHeap[0];
+	OpenHeap[0] = OpenHeap.back();
+	Nodes[OpenHeap[0]].HeapIndex = 0;
+	OpenHeap.pop_back();
+	if (!OpenHeap.empty())
+	{
+		HeapSiftDown(0);
+	}
+	return Top;
+}
+
+void SpanPathFinder::HeapSiftUp(int Position)
+{
+	int Node = OpenHeap[Position];
+	float f = Nodes[Node].f;
+	while (Position > 0)
+	{
+		int ParentPosition = (Position - 1) / 2;
+		int ParentNode = OpenHeap[ParentPosition];
+		if (Nodes[ParentNode].f <= f)
+		{
+			break;
+		}
+		OpenHeap[Position] = ParentNode;
+		Nodes[ParentNode].HeapIndex = Position;
+		Position = ParentPosition;
+	}
+	OpenHeap[Position] = Node;
+	Nodes[Node].HeapIndex = Position;
+}
+
+void SpanPathFinder::HeapSiftDown(int Position)
+{
+	int Size = int(OpenHeap.size());
+	int Node = OpenHeap[Position];
+	float f = Nodes[Node].f;
+	while (true)
+	{
+		int Child = Position * 2 + 1;
+		if (Child >= Size)
+		{
+			break;
+		}
+		if (Child + 1 < Size && Nodes[OpenHeap[Child + 1]].f < Nodes[OpenHeap[Child]].f)
+		{
+			Child++;
+		}
+		if (Nodes[OpenHeap[Child]].f >= f)
+		{
+			break;
+		}
+		OpenHeap[Position] = OpenHeap[Child];
+		Nodes[OpenHeap[Position]].HeapIndex = Position;
+		Position = Child;
+	}
+	OpenHeap[Position] = Node;
+	Nodes[Node].HeapIndex = Position;
+}
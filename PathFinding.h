@@ -0,0 +1,82 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "glm/glm.hpp"
+
+class SphereMgr;
+class CompactSpanData;
+class SpanLandmarks;
+struct Span;
+
+/*
+* 基于Span图的A*寻路
+* Span编号：SpanData::Compact中的Span编号，编号在整个SpanData中唯一
+* 每个球构造一个SpanPathFinder，构造前需要先调用SpanData::Compaction，数据改变后需要重新构造
+* 搜索节点按Span编号预先分配好，用Generation标记是否属于本次搜索，开放列表是带索引的二叉堆
+* FindPath在搜索过程中不会分配堆内存
+* Compact中有连接（SpanData::BuildLinks）且连接的ClimbHeight与本对象相同时，直接按连接展开邻居，起点与终点不在同一个连通分量时不搜索
+* 设置了路标表（SetLandmarks）并且使用连接时，启发值取直线距离与路标给出的下界中较大的一个
+*/
+class SpanPathFinder
+{
+public:
+	explicit SpanPathFinder(const SphereMgr& Sphere);
+	/*
+	* 寻找从FromSpan到ToSpan的路径，结果按顺序写入OutPath（包括起点和终点）
+	* 找不到路径或者展开的节点数超过MaxSearchNodes时返回false，OutPath为空
+	*/
+	bool FindPath(int FromSpan, int ToSpan, std::vector<int>& OutPath);
+	const Span& GetSpan(int SpanIndex) const;
+	/*
+	* Span上表面中心点的世界坐标
+	*/
+	glm::vec3 GetSpanTopPos(int SpanIndex) const;
+	int GetSpanBeginIndex() const { return SpanBeginIndex; }
+	int GetSpanNum() const { return int(Nodes.size()); }
+	int GetLastExpandedNum() const { return LastExpandedNum; }
+	/*
+	* 下一次FindPath是否会使用预计算的连接
+	*/
+	bool UsesLinks() const;
+	/*
+	* 使用路标表改进启发值，nullptr为不使用；Landmarks必须是本球的表，生命周期需要比本对象长
+	* 表的ClimbHeight与本对象不同时不使用
+	*/
+	void SetLandmarks(const SpanLandmarks* Landmarks) { this->Landmarks = Landmarks; }
+public:
+	int MaxSearchNodes = 20000;
+	float ClimbHeight;//相邻Span上表面的最大高度差
+	bool UseLinks = true;//为false时总是逐个比较邻居SpanList中Span的高度
+private:
+	/*
+	* 搜索节点，HeapIndex >= 0 表示在开放列表中，等于ClosedMark表示已经关闭
+	*/
+	struct SearchNode
+	{
+		float g;
+		float f;
+		int Parent;
+		int HeapIndex;
+		uint32_t Generation;
+	};
+	static constexpr int ClosedMark = -1;
+	float Heuristic(int SpanIndex, const glm::vec3& TargetPos) const;
+	void Relax(int Current, int Neighbor, const glm::vec3& TargetPos);
+	void HeapPush(int Node);
+	int HeapPop();
+	void HeapSiftUp(int Position);
+	void HeapSiftDown(int Position);
+private:
+	const SphereMgr& Sphere;
+	const CompactSpanData& Compact;
+	int SpanBeginIndex = 0;//本球第一个Span的编号
+	std::vector<glm::vec3> TileUp;//每个Tile的向上方向，按TileIndex索引
+	std::vector<SearchNode> Nodes;//按 Span编号 - SpanBeginIndex 索引
+	std::vector<int> OpenHeap;
+	uint32_t Generation = 0;
+	int LastExpandedNum = 0;
+	const SpanLandmarks* Landmarks = nullptr;
+	bool UseLandmarks = false;//本次搜索是否使用路标表
+	const uint16_t* TargetForward = nullptr;//终点与各路标之间的步数
+	const uint16_t* TargetBackward = nullptr;
+};
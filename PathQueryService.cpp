@@ -0,0 +1,159 @@
+#include "PathQueryService.h"
+#include "TaskScheduler.h"
+#include <chrono>
+
+PathQueryService::PathQueryService(const SphereMgr& Sphere, int ThreadNum)
+{
+	int Num = WorkStealingScheduler::ResolveThreadNum(ThreadNum);
+	for (int i = 0; i < Num; i++)
+	{
+		Finders.emplace_back(std::make_unique<SpanPathFinder>(Sphere));
+	}
+	MaxSearchNodes = Finders[0]->MaxSearchNodes;
+	Workers.reserve(Num);
+	for (int i = 0; i < Num; i++)
+	{
+		Workers.emplace_back(&PathQueryService::WorkerLoop, this, i);
+	}
+}
+
+PathQueryService::~PathQueryService()
+{
+	{
+		std::lock_guard<std::mutex> Guard(RequestLock);
+		Stopping = true;
+		Requests.clear();
+	}
+	RequestReady.notify_all();
+	Idle.notify_all();
+	for (auto&& w : Workers)
+	{
+		w.join();
+	}
+}
+
+std::future<PathQueryResult> PathQueryService::Submit(int FromSpan, int ToSpan)
+{
+	Request r;
+	r.FromSpan = FromSpan;
+	r.ToSpan = ToSpan;
+	r.UsePromise = true;
+	std::future<PathQueryResult> Future = r.Promise.get_future();
+	Enqueue(std::move(r));
+	return Future;
+}
+
+void PathQueryService::Submit(int FromSpan, int ToSpan, Callback OnComplete)
+{
+	//空的回调在DispatchCompleted中调用会抛出bad_function_call，没有人接收结果，直接不提交
+	if (!OnComplete)
+	{
+		return;
+	}
+	Request r;
+	r.FromSpan = FromSpan;
+	r.ToSpan = ToSpan;
+	r.OnComplete = std::move(OnComplete);
+	r.UsePromise = false;
+	Enqueue(std::move(r));
+}
+
+void PathQueryService::Enqueue(Request&& r)
+{
+	{
+		std::lock_guard<std::mutex> Guard(RequestLock);
+		Requests.emplace_back(std::move(r));
+	}
+	RequestReady.notify_one();
+}
+
+int PathQueryService::DispatchCompleted(double BudgetMilliseconds)
+{
+	auto Begin = std::chrono::steady_clock::now();
+	int Num = 0;
+	while (true)
+	{
+		Completed c;
+		{
+			std::lock_guard<std::mutex> Guard(CompletedLock);
+			if (CompletedQueue.empty())
+			{
+				break;
+			}
+			c = std::move(CompletedQueue.front());
+			CompletedQueue.pop_front();
+		}
+		//回调在锁外执行，回调中可以再提交新的请求
+		c.OnComplete(c.Result);
+		Num++;
+		if (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Begin).count() >= BudgetMilliseconds)
+		{
+			break;
+		}
+	}
+	return Num;
+}
+
+void PathQueryService::WaitIdle()
+{
+	std::unique_lock<std::mutex> Guard(RequestLock);
+	Idle.wait(Guard, [this]() { return Stopping || (Requests.empty() && RunningNum == 0); });
+}
+
+int PathQueryService::GetPendingNum() const
+{
+	std::lock_guard<std::mutex> Guard(RequestLock);
+	return int(Requests.size()) + RunningNum;
+}
+
+int PathQueryService::GetCompletedNum() const
+{
+	std::lock_guard<std::mutex> Guard(CompletedLock);
+	return int(CompletedQueue.size());
+}
+
+void PathQueryService::WorkerLoop(int ThreadIndex)
+{
+	SpanPathFinder& Finder = *Finders[ThreadIndex];
+	while (true)
+	{
+		Request r;
+		{
+			std::unique_lock<std::mutex> Guard(RequestLock);
+			RequestReady.wait(Guard, [this]() { return Stopping || !Requests.empty(); });
+			if (Stopping)
+			{
+				return;
+			}
+			r = std::move(Requests.front());
+			Requests.pop_front();
+			RunningNum++;
+		}
+
+		PathQueryResult Result;
+		Result.FromSpan = r.FromSpan;
+		Result.ToSpan = r.ToSpan;
+		Finder.MaxSearchNodes = MaxSearchNodes;
+		Result.Found = Finder.FindPath(r.FromSpan, r.ToSpan, Result.Path);
+		Result.ExpandedNum = Finder.GetLastExpandedNum();
+
+		if (r.UsePromise)
+		{
+			r.Promise.set_value(std::move(Result));
+		}
+		else
+		{
+			std::lock_guard<std::mutex> Guard(CompletedLock);
+			CompletedQueue.push_back({ std::move(Result), std::move(r.OnComplete) });
+		}
+
+		{
+			std::lock_guard<std::mutex> Guard(RequestLock);
+			RunningNum--;
+			if (Requests.empty() && RunningNum == 0)
+			{
+				Idle.notify_all();
+			}
+		}
+	}
+}
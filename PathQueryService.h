@@ -0,0 +1,105 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <functional>
+#include <atomic>
+#include "glm/glm.hpp"
+#include "PathFinding.h"
+
+class SphereMgr;
+
+/*
+* 一次寻路请求的结果
+* Path：路径上每个Span的编号（包括起点和终点），找不到路径时为空
+* ExpandedNum：搜索展开的节点数
+*/
+struct PathQueryResult
+{
+	int FromSpan = -1;
+	int ToSpan = -1;
+	bool Found = false;
+	std::vector<int> Path;
+	int ExpandedNum = 0;
+};
+
+/*
+* 后台寻路服务
+* 调用者提交(起点, 终点)的Span编号，工作线程用各自的SpanPathFinder求解，提交不会阻塞调用线程
+* 结果通过future返回，或者把回调放进完成队列，由主线程每帧调用DispatchCompleted在预算时间内执行
+* 构造前需要先调用SpanData::Compaction，SpanData改变后需要重新构造
+* 析构时还没有开始的请求被丢弃：future得到broken_promise，回调不会执行
+*/
+class PathQueryService
+{
+public:
+	using Callback = std::function<void(const PathQueryResult&)>;
+	/*
+	* ThreadNum <= 0 时使用硬件线程数
+	*/
+	PathQueryService(const SphereMgr& Sphere, int ThreadNum);
+	~PathQueryService();
+	PathQueryService(const PathQueryService&) = delete;
+	PathQueryService& operator=(const PathQueryService&) = delete;
+
+	std::future<PathQueryResult> Submit(int FromSpan, int ToSpan);
+	/*
+	* OnComplete在调用DispatchCompleted的线程中执行，为空时忽略这个请求
+	*/
+	void Submit(int FromSpan, int ToSpan, Callback OnComplete);
+	/*
+	* 执行已完成请求的回调，直到完成队列为空或者用掉BudgetMilliseconds，至少执行一个
+	* 返回执行的回调数
+	*/
+	int DispatchCompleted(double BudgetMilliseconds);
+	/*
+	* 阻塞直到所有已经提交的请求都求解完成（回调仍然需要DispatchCompleted执行）
+	*/
+	void WaitIdle();
+	/*
+	* 还没有求解完成的请求数
+	*/
+	int GetPendingNum() const;
+	int GetCompletedNum() const;
+	int GetThreadNum() const { return int(Workers.size()); }
+	/*
+	* 与SpanPathFinder::MaxSearchNodes相同，对之后开始求解的请求生效
+	*/
+	void SetMaxSearchNodes(int Num) { MaxSearchNodes = Num; }
+	glm::vec3 GetSpanTopPos(int SpanIndex) const { return Finders[0]->GetSpanTopPos(SpanIndex); }
+private:
+	struct Request
+	{
+		int FromSpan;
+		int ToSpan;
+		std::promise<PathQueryResult> Promise;
+		Callback OnComplete;
+		bool UsePromise;
+	};
+	struct Completed
+	{
+		PathQueryResult Result;
+		Callback OnComplete;
+	};
+	void Enqueue(Request&& r);
+	void WorkerLoop(int ThreadIndex);
+private:
+	std::vector<std::unique_ptr<SpanPathFinder>> Finders;//每个工作线程一个，搜索状态不共享
+	std::vector<std::thread> Workers;
+
+	mutable std::mutex RequestLock;
+	std::condition_variable RequestReady;
+	std::condition_variable Idle;
+	std::deque<Request> Requests;
+	int RunningNum = 0;
+	bool Stopping = false;
+
+	mutable std::mutex CompletedLock;
+	std::deque<Completed> CompletedQueue;
+
+	std::atomic<int> MaxSearchNodes;
+};
@@ -0,0 +1,604 @@
+#include "PortalHierarchy.h"
+#include "HierarchicalPathFinding.h"
+#include "FileMapping.h"
+#include <algorithm>
+#include <functional>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<PortalHierarchy::Edge>::value && sizeof(PortalHierarchy::Edge) == 12, "PortalHierarchy::Edge is stored as-is in the hierarchy file");
+
+namespace
+{
+	const char HierarchyMagic[8] = { 'V','O','X','N','A','V','H','\0' };
+	const uint32_t HierarchyVersion = 1;
+
+	struct HierarchyHeader
+	{
+		char Magic[8];
+		uint32_t Version;
+		uint32_t HeaderSize;
+		uint64_t BakeChecksum;
+		uint64_t GraphHash;
+		uint64_t PayloadChecksum;
+		uint32_t PortalNum;
+		uint32_t UpEdgeNum;
+		uint32_t DownEdgeNum;
+		uint32_t ShortcutNum;
+	};
+
+	using Edge = PortalHierarchy::Edge;
+	using HeapEntry = std::pair<float, int>;
+	//只计算优先级时见证搜索的入口数上限是SettleLimit的几分之一，估计的捷径数略多于真正收缩时，收缩时仍然使用完整的上限
+	const int PrioritySettleDivisor = 4;
+
+	/*
+	* 收缩过程中的图：收缩一个入口后，把它从邻居的Out与In中删去，它自己的Out与In不再改变
+	* 所以收缩完成后Out[v]都是到更晚收缩的入口的边，In[v]都是从更晚收缩的入口来的边
+	* 同一对入口之间只保留代价最小的一条边
+	*/
+	class Contractor
+	{
+	public:
+		Contractor(const TilePortalGraph& Graph, int SettleLimit)
+			:SettleLimit(std::max(1, SettleLimit))
+		{
+			int PortalNum = Graph.GetPortalNum();
+			Out.resize(PortalNum);
+			In.resize(PortalNum);
+			Contracted.assign(PortalNum, false);
+			DeletedNeighbors.assign(PortalNum, 0);
+			WitnessCost.resize(PortalNum);
+			WitnessGeneration.assign(PortalNum, 0);
+			for (int p = 0; p < PortalNum; p++)
+			{
+				for (const TilePortalGraph::PortalEdge* e = Graph.GetEdgeBegin(p); e != Graph.GetEdgeEnd(p); e++)
+				{
+					AddEdge(p, e->Target, e->Cost, -1);
+				}
+			}
+		}
+
+		/*
+		* 按重要度从低到高收缩所有入口，重要度 = 需要的捷径数 - 去掉的边数 + 已经收缩的邻居数
+		* 重要度是惰性更新的：取出时重新计算，比堆中下一个大就放回去
+		* 只有上次计算之后有邻居被收缩（边也只会在这时增加）的入口才重新计算，否则堆中的值仍然有效，直接收缩
+		*/
+		void Run(std::vector<int>& Rank, int& ShortcutNum)
+		{
+			int PortalNum = int(Out.size());
+			Rank.assign(PortalNum, -1);
+			ShortcutNum = 0;
+			std::vector<HeapEntry> Heap;
+			std::vector<bool> Dirty(PortalNum, false);
+			for (int v = 0; v < PortalNum; v++)
+			{
+				Heap.emplace_back(float(Priority(v)), v);
+			}
+			std::make_heap(Heap.begin(), Heap.end(), std::greater<HeapEntry>());
+			int Order = 0;
+			while (!Heap.empty())
+			{
+				std::pop_heap(Heap.begin(), Heap.end(), std::greater<HeapEntry>());
+				int v = Heap.back().second;
+				Heap.pop_back();
+				if (Dirty[v])
+				{
+					Dirty[v] = false;
+					float Current = float(Priority(v));
+					if (!Heap.empty() && Current > Heap.front().first)
+					{
+						Heap.emplace_back(Current, v);
+						std::push_heap(Heap.begin(), Heap.end(), std::greater<HeapEntry>());
+						continue;
+					}
+				}
+				ShortcutNum += Contract(v, true);
+				Contracted[v] = true;
+				Rank[v] = Order++;
+				for (auto&& e : Out[v])
+				{
+					DeletedNeighbors[e.Target]++;
+					Dirty[e.Target] = true;
+					RemoveEdge(In[e.Target], v);
+				}
+				for (auto&& e : In[v])
+				{
+					DeletedNeighbors[e.Target]++;
+					Dirty[e.Target] = true;
+					RemoveEdge(Out[e.Target], v);
+				}
+			}
+		}
+
+		/*
+		* 收缩后所有的边（包括捷径），Out[u]中的Target是边的终点，In[v]中的Target是边的起点
+		*/
+		const std::vector<std::vector<Edge>>& GetOutEdges() const { return Out; }
+		const std::vector<std::vector<Edge>>& GetInEdges() const { return In; }
+	private:
+		static void RemoveEdge(std::vector<Edge>& Edges, int Target)
+		{
+			for (size_t i = 0; i < Edges.size(); i++)
+			{
+				if (Edges[i].Target == Target)
+				{
+					Edges[i] = Edges.back();
+					Edges.pop_back();
+					return;
+				}
+			}
+		}
+
+		void AddEdge(int From, int To, float Cost, int Middle)
+		{
+			for (auto&& e : Out[From])
+			{
+				if (e.Target == To)
+				{
+					if (Cost < e.Cost)
+					{
+						e.Cost = Cost;
+						e.Middle = Middle;
+						for (auto&& r : In[To])
+						{
+							if (r.Target == From)
+							{
+								r.Cost = Cost;
+								r.Middle = Middle;
+							}
+						}
+					}
+					return;
+				}
+			}
+			Out[From].push_back({ To, Cost, Middle });
+			In[To].push_back({ From, Cost, Middle });
+		}
+
+		int Priority(int v)
+		{
+			int RemovedNum = 0;
+			for (auto&& e : Out[v])
+			{
+				RemovedNum += !Contracted[e.Target];
+			}
+			for (auto&& e : In[v])
+			{
+				RemovedNum += !Contracted[e.Target];
+			}
+			return Contract(v, false) - RemovedNum + DeletedNeighbors[v];
+		}
+
+		/*
+		* 返回收缩v需要的捷径数，Apply为true时加上这些捷径
+		*/
+		int Contract(int v, bool Apply)
+		{
+			int Num = 0;
+			Pending.clear();
+			for (auto&& in : In[v])
+			{
+				int u = in.Target;
+				if (Contracted[u])
+				{
+					continue;
+				}
+				float MaxCost = -1.0f;
+				for (auto&& out : Out[v])
+				{
+					if (!Contracted[out.Target] && out.Target != u)
+					{
+						MaxCost = std::max(MaxCost, in.Cost + out.Cost);
+					}
+				}
+				if (MaxCost < 0)
+				{
+					continue;
+				}
+				WitnessSearch(u, v, MaxCost, Apply ? SettleLimit : std::max(1, SettleLimit / PrioritySettleDivisor));
+				for (auto&& out : Out[v])
+				{
+					int x = out.Target;
+					if (Contracted[x] || x == u)
+					{
+						continue;
+					}
+					float Via = in.Cost + out.Cost;
+					if (WitnessGeneration[x] != Generation || WitnessCost[x] > Via)
+					{
+						Num++;
+						if (Apply)
+						{
+							Pending.push_back({ u, x, Via });
+						}
+					}
+				}
+			}
+			for (auto&& s : Pending)
+			{
+				AddEdge(s.From, s.To, s.Cost, v);
+			}
+			return Num;
+		}
+
+		/*
+		* 从Source出发不经过Excluded的Dijkstra，只走没有收缩的入口，超过MaxCost或者确定了Limit个入口后停止
+		*/
+		void WitnessSearch(int Source, int Excluded, float MaxCost, int Limit)
+		{
+			Generation++;
+			Heap.clear();
+			WitnessCost[Source] = 0.0f;
+			WitnessGeneration[Source] = Generation;
+			Heap.emplace_back(0.0f, Source);
+			int SettledNum = 0;
+			while (!Heap.empty() && SettledNum < Limit)
+			{
+				std::pop_heap(Heap.begin(), Heap.end(), std::greater<HeapEntry>());
+				HeapEntry Top = Heap.back();
+				Heap.pop_back();
+				if (Top.first > WitnessCost[Top.second])
+				{
+					continue;
+				}
+				if (Top.first > MaxCost)
+				{
+					break;
+				}
+				SettledNum++;
+				for (auto&& e : Out[Top.second])
+				{
+					int x = e.Target;
+					if (Contracted[x] || x == Excluded)
+					{
+						continue;
+					}
+					float Cost = Top.first + e.Cost;
+					if (WitnessGeneration[x] != Generation || Cost < WitnessCost[x])
+					{
+						WitnessGeneration[x] = Generation;
+						WitnessCost[x] = Cost;
+						Heap.emplace_back(Cost, x);
+						std::push_heap(Heap.begin(), Heap.end(), std::greater<HeapEntry>());
+					}
+				}
+			}
+		}
+	private:
+		struct Shortcut
+		{
+			int From;
+			int To;
+			float Cost;
+		};
+		int SettleLimit;
+		std::vector<std::vector<Edge>> Out;
+		std::vector<std::vector<Edge>> In;//In[v]中的Target是边的起点
+		std::vector<bool> Contracted;
+		std::vector<int> DeletedNeighbors;
+		std::vector<Shortcut> Pending;
+		std::vector<float> WitnessCost;
+		std::vector<uint32_t> WitnessGeneration;
+		std::vector<HeapEntry> Heap;
+		uint32_t Generation = 0;
+	};
+}
+
+void PortalHierarchy::Build(const TilePortalGraph& Graph, int WitnessSettleLimit)
+{
+	Contractor c(Graph, WitnessSettleLimit);
+	c.Run(Rank, ShortcutNum);
+
+	//收缩后的Out就是Up，In就是Down，都以较低的入口为索引
+	int PortalNum = Graph.GetPortalNum();
+	auto&& Out = c.GetOutEdges();
+	auto&& In = c.GetInEdges();
+	UpBegin.assign(PortalNum + 1, 0);
+	DownBegin.assign(PortalNum + 1, 0);
+	for (int u = 0; u < PortalNum; u++)
+	{
+		UpBegin[u + 1] = UpBegin[u] + int(Out[u].size());
+		DownBegin[u + 1] = DownBegin[u] + int(In[u].size());
+	}
+	UpEdges.clear();
+	DownEdges.clear();
+	UpEdges.reserve(UpBegin[PortalNum]);
+	DownEdges.reserve(DownBegin[PortalNum]);
+	for (int u = 0; u < PortalNum; u++)
+	{
+		UpEdges.insert(UpEdges.end(), Out[u].begin(), Out[u].end());
+		DownEdges.insert(DownEdges.end(), In[u].begin(), In[u].end());
+	}
+	GraphHash = HashGraph(Graph);
+}
+
+uint64_t PortalHierarchy::HashGraph(const TilePortalGraph& Graph)
+{
+	int ClusterTileNum = Graph.GetClusterTileNum();
+	uint64_t Hash = HashBytes(&ClusterTileNum, sizeof(ClusterTileNum));
+	for (int p = 0; p < Graph.GetPortalNum(); p++)
+	{
+		int Span = Graph.GetPortalSpan(p);
+		Hash = HashBytes(&Span, sizeof(Span), Hash);
+		Hash = HashBytes(Graph.GetEdgeBegin(p), (Graph.GetEdgeEnd(p) - Graph.GetEdgeBegin(p)) * sizeof(TilePortalGraph::PortalEdge), Hash);
+	}
+	return Hash;
+}
+
+bool PortalHierarchy::Matches(const TilePortalGraph& Graph) const
+{
+	return IsValid() && GetPortalNum() == Graph.GetPortalNum() && GraphHash == HashGraph(Graph);
+}
+
+size_t PortalHierarchy::GetMemorySize() const
+{
+	return (Rank.capacity() + UpBegin.capacity() + DownBegin.capacity()) * sizeof(int) + (UpEdges.capacity() + DownEdges.capacity()) * sizeof(Edge);
+}
+
+const PortalHierarchy::Edge* PortalHierarchy::FindUp(int Portal, int Target) const
+{
+	for (int k = UpBegin[Portal]; k < UpBegin[Portal + 1]; k++)
+	{
+		if (UpEdges[k].Target == Target)
+		{
+			return &UpEdges[k];
+		}
+	}
+	return nullptr;
+}
+
+const PortalHierarchy::Edge* PortalHierarchy::FindDown(int Portal, int Target) const
+{
+	for (int k = DownBegin[Portal]; k < DownBegin[Portal + 1]; k++)
+	{
+		if (DownEdges[k].Target == Target)
+		{
+			return &DownEdges[k];
+		}
+	}
+	return nullptr;
+}
+
+bool PortalHierarchy::Save(const std::string& Path, uint64_t BakeChecksum) const
+{
+	if (!IsValid())
+	{
+		return false;
+	}
+	HierarchyHeader Header = {};
+	memcpy(Header.Magic, HierarchyMagic, sizeof(HierarchyMagic));
+	Header.Version = HierarchyVersion;
+	Header.HeaderSize = sizeof(HierarchyHeader);
+	Header.BakeChecksum = BakeChecksum;
+	Header.GraphHash = GraphHash;
+	Header.PortalNum = uint32_t(Rank.size());
+	Header.UpEdgeNum = uint32_t(UpEdges.size());
+	Header.DownEdgeNum = uint32_t(DownEdges.size());
+	Header.ShortcutNum = uint32_t(ShortcutNum);
+	uint64_t Checksum = HashBytes(Rank.data(), Rank.size() * sizeof(int));
+	Checksum = HashBytes(UpBegin.data(), UpBegin.size() * sizeof(int), Checksum);
+	Checksum = HashBytes(UpEdges.data(), UpEdges.size() * sizeof(Edge), Checksum);
+	Checksum = HashBytes(DownBegin.data(), DownBegin.size() * sizeof(int), Checksum);
+	Header.PayloadChecksum = HashBytes(DownEdges.data(), DownEdges.size() * sizeof(Edge), Checksum);
+
+	//先写临时文件再改名，其它进程不会读到写了一半的文件
+	std::string TempPath = Path + ".tmp";
+	{
+		std::ofstream File(TempPath, std::ios::binary | std::ios::trunc);
+		if (!File)
+		{
+			return false;
+		}
+		File.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+		File.write(reinterpret_cast<const char*>(Rank.data()), Rank.size() * sizeof(int));
+		File.write(reinterpret_cast<const char*>(UpBegin.data()), UpBegin.size() * sizeof(int));
+		File.write(reinterpret_cast<const char*>(UpEdges.data()), UpEdges.size() * sizeof(Edge));
+		File.write(reinterpret_cast<const char*>(DownBegin.data()), DownBegin.size() * sizeof(int));
+		File.write(reinterpret_cast<const char*>(DownEdges.data()), DownEdges.size() * sizeof(Edge));
+		if (!File)
+		{
+			return false;
+		}
+	}
+	std::error_code Error;
+	std::filesystem::rename(TempPath, Path, Error);
+	return !Error;
+}
+
+bool PortalHierarchy::Load(const std::string& Path, const TilePortalGraph& Graph, uint64_t BakeChecksum)
+{
+	MappedFile File;
+	if (!File.Open(Path) || File.GetSize() < sizeof(HierarchyHeader))
+	{
+		return false;
+	}
+	HierarchyHeader Header;
+	memcpy(&Header, File.GetData(), sizeof(Header));
+	if (memcmp(Header.Magic, HierarchyMagic, sizeof(HierarchyMagic)) != 0 || Header.Version != HierarchyVersion || Header.HeaderSize != sizeof(HierarchyHeader)
+		|| Header.BakeChecksum != BakeChecksum || Header.PortalNum != Graph.GetPortalNum())
+	{
+		return false;
+	}
+	size_t PortalNum = Header.PortalNum;
+	size_t RankBytes = PortalNum * sizeof(int);
+	size_t BeginBytes = (PortalNum + 1) * sizeof(int);
+	size_t UpBytes = size_t(Header.UpEdgeNum) * sizeof(Edge);
+	size_t DownBytes = size_t(Header.DownEdgeNum) * sizeof(Edge);
+	if (File.GetSize() != sizeof(HierarchyHeader) + RankBytes + BeginBytes * 2 + UpBytes + DownBytes)
+	{
+		return false;
+	}
+	const uint8_t* Payload = File.GetData() + sizeof(HierarchyHeader);
+	if (HashBytes(Payload, File.GetSize() - sizeof(HierarchyHeader)) != Header.PayloadChecksum || Header.GraphHash != HashGraph(Graph))
+	{
+		return false;
+	}
+
+	auto Copy = [&Payload](auto& Vector, size_t Num)
+	{
+		Vector.resize(Num);
+		memcpy(Vector.data(), Payload, Num * sizeof(Vector[0]));
+		Payload += Num * sizeof(Vector[0]);
+	};
+	Copy(Rank, PortalNum);
+	Copy(UpBegin, PortalNum + 1);
+	Copy(UpEdges, Header.UpEdgeNum);
+	Copy(DownBegin, PortalNum + 1);
+	Copy(DownEdges, Header.DownEdgeNum);
+	GraphHash = Header.GraphHash;
+	ShortcutNum = int(Header.ShortcutNum);
+	return true;
+}
+
+PortalHierarchy::Query::Query(const PortalHierarchy& h)
+	:Hierarchy(h)
+{
+	for (int Side = 0; Side < 2; Side++)
+	{
+		Nodes[Side].resize(Hierarchy.GetPortalNum());
+		for (auto&& n : Nodes[Side])
+		{
+			n.Generation = 0;
+		}
+	}
+}
+
+float PortalHierarchy::Query::Run(const std::vector<std::pair<int, float>>& Sources, const std::vector<std::pair<int, float>>& Targets, std::vector<int>* OutPortals)
+{
+	LastSettledNum = 0;
+	Generation++;
+	if (Generation == 0)
+	{
+		for (int Side = 0; Side < 2; Side++)
+		{
+			for (auto&& n : Nodes[Side])
+			{
+				n.Generation = 0;
+			}
+		}
+		Generation = 1;
+	}
+
+	auto Open = [this](int Side, int Portal, float Cost, int Parent, int Middle)
+	{
+		Node& n = Nodes[Side][Portal];
+		if (n.Generation == Generation && (n.Closed || n.Cost <= Cost))
+		{
+			return;
+		}
+		n.Generation = Generation;
+		n.Cost = Cost;
+		n.Parent = Parent;
+		n.Middle = Middle;
+		n.Closed = false;
+		OpenHeap[Side].emplace_back(Cost, Portal);
+		std::push_heap(OpenHeap[Side].begin(), OpenHeap[Side].end(), std::greater<HeapEntry>());
+	};
+	for (int Side = 0; Side < 2; Side++)
+	{
+		OpenHeap[Side].clear();
+		for (auto&& s : Side == 0 ? Sources : Targets)
+		{
+			Open(Side, s.first, s.second, -1, -1);
+		}
+	}
+
+	//起点一侧沿Up走，终点一侧沿Down走，堆顶不小于已知的最短距离时这一侧就结束了
+	float Best = std::numeric_limits<float>::max();
+	int Meet = -1;
+	while (true)
+	{
+		for (int Side = 0; Side < 2; Side++)
+		{
+			if (!OpenHeap[Side].empty() && OpenHeap[Side].front().first >= Best)
+			{
+				OpenHeap[Side].clear();
+			}
+		}
+		if (OpenHeap[0].empty() && OpenHeap[1].empty())
+		{
+			break;
+		}
+		int Side = OpenHeap[1].empty() || (!OpenHeap[0].empty() && OpenHeap[0].front().first <= OpenHeap[1].front().first) ? 0 : 1;
+		std::pop_heap(OpenHeap[Side].begin(), OpenHeap[Side].end(), std::greater<HeapEntry>());
+		int v = OpenHeap[Side].back().second;
+		OpenHeap[Side].pop_back();
+		Node& n = Nodes[Side][v];
+		if (n.Closed)
+		{
+			continue;
+		}
+		n.Closed = true;
+		LastSettledNum++;
+
+		const Node& Other = Nodes[1 - Side][v];
+		if (Other.Generation == Generation && n.Cost + Other.Cost < Best)
+		{
+			Best = n.Cost + Other.Cost;
+			Meet = v;
+		}
+		//按需停顿：本侧已经到达的更高层入口经过反向的边到v更近时，v的距离不是最短的，不从v展开
+		const std::vector<int>& StallBegin = Side == 0 ? Hierarchy.DownBegin : Hierarchy.UpBegin;
+		const std::vector<Edge>& StallEdges = Side == 0 ? Hierarchy.DownEdges : Hierarchy.UpEdges;
+		bool Stalled = false;
+		for (int k = StallBegin[v]; k < StallBegin[v + 1] && !Stalled; k++)
+		{
+			const Node& Higher = Nodes[Side][StallEdges[k].Target];
+			Stalled = Higher.Generation == Generation && Higher.Cost + StallEdges[k].Cost < n.Cost;
+		}
+		if (Stalled)
+		{
+			continue;
+		}
+		const std::vector<int>& Begin = Side == 0 ? Hierarchy.UpBegin : Hierarchy.DownBegin;
+		const std::vector<Edge>& Edges = Side == 0 ? Hierarchy.UpEdges : Hierarchy.DownEdges;
+		for (int k = Begin[v]; k < Begin[v + 1]; k++)
+		{
+			Open(Side, Edges[k].Target, n.Cost + Edges[k].Cost, v, Edges[k].Middle);
+		}
+	}
+	if (Meet < 0)
+	{
+		return -1.0f;
+	}
+
+	if (OutPortals)
+	{
+		//起点一侧从相遇点倒推到起点，终点一侧从相遇点顺着Parent走到终点，每一段边都展开成原来的边
+		OutPortals->clear();
+		std::vector<int> Chain;
+		for (int p = Meet; p != -1; p = Nodes[0][p].Parent)
+		{
+			Chain.emplace_back(p);
+		}
+		std::reverse(Chain.begin(), Chain.end());
+		OutPortals->emplace_back(Chain[0]);
+		for (size_t i = 1; i < Chain.size(); i++)
+		{
+			Unpack(Chain[i - 1], Chain[i], Nodes[0][Chain[i]].Middle, *OutPortals);
+		}
+		for (int p = Meet; Nodes[1][p].Parent != -1; p = Nodes[1][p].Parent)
+		{
+			Unpack(p, Nodes[1][p].Parent, Nodes[1][p].Middle, *OutPortals);
+		}
+	}
+	return Best;
+}
+
+void PortalHierarchy::Query::Unpack(int From, int To, int Middle, std::vector<int>& OutPortals) const
+{
+	if (Middle < 0)
+	{
+		OutPortals.emplace_back(To);
+		return;
+	}
+	//中间入口比两端都先收缩：From->Middle在Down[Middle]中，Middle->To在Up[Middle]中
+	const Edge* First = Hierarchy.FindDown(Middle, From);
+	const Edge* Second = Hierarchy.FindUp(Middle, To);
+	Unpack(From, Middle, First ? First->Middle : -1, OutPortals);
+	Unpack(Middle, To, Second ? Second->Middle : -1, OutPortals);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <utility>
+
+class TilePortalGraph;
+
+/*
+* TilePortalGraph上的收缩层次（Contraction Hierarchies），用于静态烘焙上大量的长距离查询
+* 预处理：按重要度从低到高逐个收缩入口，收缩v时对每对 u->v->x，如果不经过v找不到同样短的路径（局部的见证搜索），就加一条u->x的捷径
+* 查询：起点一侧只走向更高层的边，终点一侧只走从更高层来的边，两边的双向Dijkstra在最高层的入口相遇
+* 预处理时只在邻居被收缩后重新计算入口的优先级；查询时能从另一侧更高层的入口以更短距离到达的入口不再展开（stall-on-demand）
+* 边与捷径都按收缩顺序分成两组：Up[v]是v->x（x比v晚收缩），Down[v]是x->v（x比v晚收缩，保存的Target是x）
+* 捷径记录被收缩的中间入口，展开后是TilePortalGraph上原来的边
+* 可以保存到文件，文件以烘焙文件的校验和与抽象图的哈希为键，任何一个不同都不会被加载
+*/
+class PortalHierarchy
+{
+public:
+	struct Edge
+	{
+		int Target;
+		float Cost;
+		int Middle;//捷径的中间入口，原来的边为-1
+	};
+	/*
+	* 查询的搜索状态，每个线程使用自己的Query，PortalHierarchy的生命周期需要比本对象长
+	*/
+	class Query
+	{
+	public:
+		explicit Query(const PortalHierarchy& Hierarchy);
+		/*
+		* Sources：(入口, 起点到入口的距离)，Targets：(入口, 入口到终点的距离)
+		* 返回经过入口的最短距离，没有路径时返回负数
+		* OutPortals不为空时写入路径经过的入口序列（捷径已经展开）
+		*/
+		float Run(const std::vector<std::pair<int, float>>& Sources, const std::vector<std::pair<int, float>>& Targets, std::vector<int>* OutPortals);
+		/*
+		* 上一次Run中两个方向一共确定的入口数
+		*/
+		int GetLastSettledNum() const { return LastSettledNum; }
+	private:
+		struct Node
+		{
+			float Cost;
+			int Parent;
+			int Middle;//从Parent到本入口的边的中间入口
+			uint32_t Generation;
+			bool Closed;
+		};
+		void Unpack(int From, int To, int Middle, std::vector<int>& OutPortals) const;
+	private:
+		const PortalHierarchy& Hierarchy;
+		std::vector<Node> Nodes[2];//0为起点一侧，1为终点一侧
+		std::vector<std::pair<float, int>> OpenHeap[2];
+		uint32_t Generation = 0;
+		int LastSettledNum = 0;
+	};
+
+	PortalHierarchy() = default;
+	/*
+	* 收缩整个抽象图，WitnessSettleLimit是每次见证搜索最多确定的入口数，越小预处理越快，捷径越多
+	*/
+	void Build(const TilePortalGraph& Graph, int WitnessSettleLimit = 64);
+	/*
+	* BakeChecksum：对应的烘焙文件的校验和（navBake::ReadNavBakeChecksum）
+	*/
+	bool Save(const std::string& Path, uint64_t BakeChecksum) const;
+	/*
+	* 文件不存在、格式错误，或者BakeChecksum与Graph与保存时不同时返回false，此时本对象不会被修改
+	*/
+	bool Load(const std::string& Path, const TilePortalGraph& Graph, uint64_t BakeChecksum);
+	/*
+	* 是否是由Graph（内容相同的抽象图）生成的
+	*/
+	bool Matches(const TilePortalGraph& Graph) const;
+	bool IsValid() const { return !UpBegin.empty(); }
+	int GetPortalNum() const { return int(Rank.size()); }
+	int GetShortcutNum() const { return ShortcutNum; }
+	int GetEdgeNum() const { return int(UpEdges.size() + DownEdges.size()); }
+	size_t GetMemorySize() const;
+	/*
+	* 抽象图的入口与边的哈希
+	*/
+	static uint64_t HashGraph(const TilePortalGraph& Graph);
+private:
+	const Edge* FindUp(int Portal, int Target) const;
+	const Edge* FindDown(int Portal, int Target) const;
+private:
+	uint64_t GraphHash = 0;
+	int ShortcutNum = 0;
+	std::vector<int> Rank;//收缩顺序，越大越重要
+	std::vector<int> UpBegin;
+	std::vector<Edge> UpEdges;
+	std::vector<int> DownBegin;
+	std::vector<Edge> DownEdges;
+};
@@ -324,6 +324,51 @@ bool rcCreateHeightfield(rcContext* context, rcHeightfield& heightfield, int siz
 	return true;
 }
 
+bool rcResetHeightfield(rcContext* context, rcHeightfield& heightfield, int sizeX, int sizeZ,
+                        const float* minBounds, const float* maxBounds,
+                        float cellSize, float cellHeight)
+{
+	rcIgnoreUnused(context);
+
+	// Rebuild the free list from every pool instead of walking the columns.
+	rcSpan* freeList = NULL;
+	for (rcSpanPool* pool = heightfield.pools; pool; pool = pool->next)
+	{
+		rcSpan* head = &pool->items[0];
+		rcSpan* it = &pool->items[RC_SPANS_PER_POOL];
+		do
+		{
+			--it;
+			it->next = freeList;
+			freeList = it;
+		}
+		while (it != head);
+	}
+	heightfield.freelist = freeList;
+
+	if (heightfield.spans && sizeX * sizeZ != heightfield.width * heightfield.height)
+	{
+		rcFree(heightfield.spans);
+		heightfield.spans = NULL;
+	}
+	heightfield.width = sizeX;
+	heightfield.height = sizeZ;
+	rcVcopy(heightfield.bmin, minBounds);
+	rcVcopy(heightfield.bmax, maxBounds);
+	heightfield.cs = cellSize;
+	heightfield.ch = cellHeight;
+	if (!heightfield.spans)
+	{
+		heightfield.spans = (rcSpan**)rcAlloc(sizeof(rcSpan*) * heightfield.width * heightfield.height, RC_ALLOC_PERM);
+		if (!heightfield.spans)
+		{
+			return false;
+		}
+	}
+	memset(heightfield.spans, 0, sizeof(rcSpan*) * heightfield.width * heightfield.height);
+	return true;
+}
+
 static void calcTriNormal(const float* v0, const float* v1, const float* v2, float* faceNormal)
 {
 	float e0[3], e1[3];
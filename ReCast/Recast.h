@@ -851,6 +851,28 @@ bool rcCreateHeightfield(rcContext* context, rcHeightfield& heightfield, int siz
 						 const float* minBounds, const float* maxBounds,
 						 float cellSize, float cellHeight);
 
+/// Reinitializes a heightfield in place so it can be rasterized into again.
+/// All spans are returned to the free list, but the span pools are kept, and the column
+/// array is reused when the cell count does not change. Once the pools have grown large
+/// enough, rasterizing and resetting the same heightfield does not touch the allocator.
+/// Can also be used instead of #rcCreateHeightfield on a newly allocated heightfield.
+/// 
+/// @see rcCreateHeightfield, rcHeightfield
+/// @ingroup recast
+/// 
+/// @param[in,out]	context		The build context to use during the operation.
+/// @param[in,out]	heightfield	The heightfield to reset.
+/// @param[in]		sizeX		The width of the field along the x-axis. [Limit: >= 0] [Units: vx]
+/// @param[in]		sizeZ		The height of the field along the z-axis. [Limit: >= 0] [Units: vx]
+/// @param[in]		minBounds	The minimum bounds of the field's AABB. [(x, y, z)] [Units: wu]
+/// @param[in]		maxBounds	The maximum bounds of the field's AABB. [(x, y, z)] [Units: wu]
+/// @param[in]		cellSize	The xz-plane cell size to use for the field. [Limit: > 0] [Units: wu]
+/// @param[in]		cellHeight	The y-axis cell size to use for field. [Limit: > 0] [Units: wu]
+/// @returns True if the operation completed successfully.
+bool rcResetHeightfield(rcContext* context, rcHeightfield& heightfield, int sizeX, int sizeZ,
+						const float* minBounds, const float* maxBounds,
+						float cellSize, float cellHeight);
+
 /// Sets the area id of all triangles with a slope below the specified value
 /// to #RC_WALKABLE_AREA.
 ///
@@ -0,0 +1,379 @@
+#include "ReCastAllocator.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdlib>
+
+namespace
+{
+	const size_t HeaderSize = 16;
+	const size_t TempChunkSize = size_t(1) << 20;
+	const int MinClassShift = 5;//最小一级32字节
+	const int MaxClassShift = 16;//最大一级64KB
+	const int ClassNum = MaxClassShift - MinClassShift + 1;
+	const size_t PoolSlabSize = size_t(1) << 18;
+
+	enum BlockKind : uint32_t
+	{
+		KindMalloc,
+		KindTemp,
+		KindPool,
+	};
+
+	struct TempArena;
+
+	/*
+	* 每次分配前面的头，Owner只对KindTemp有效，Extra对KindMalloc是rcAllocHint，对KindPool是级别
+	*/
+	struct alignas(16) BlockHeader
+	{
+		TempArena* Owner;
+		uint32_t Kind;
+		uint32_t Extra;
+	};
+	static_assert(sizeof(BlockHeader) == HeaderSize, "BlockHeader must keep the returned memory 16-byte aligned");
+
+	struct Counter
+	{
+		std::atomic<uint64_t> AllocNum{ 0 };
+		std::atomic<uint64_t> AllocBytes{ 0 };
+		std::atomic<uint64_t> FreeNum{ 0 };
+	};
+	Counter Counters[2];
+
+	void CountAlloc(rcAllocHint Hint, size_t Size)
+	{
+		Counters[Hint].AllocNum.fetch_add(1, std::memory_order_relaxed);
+		Counters[Hint].AllocBytes.fetch_add(Size, std::memory_order_relaxed);
+	}
+
+	void CountFree(rcAllocHint Hint)
+	{
+		Counters[Hint].FreeNum.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	size_t AlignUp(size_t Size)
+	{
+		return (Size + HeaderSize - 1) / HeaderSize * HeaderSize;
+	}
+
+	/*
+	* 线程的临时内存，Live在其它线程释放时也可能减少，所以是原子的
+	*/
+	struct TempArena
+	{
+		struct Chunk
+		{
+			uint8_t* Data;
+			size_t Size;
+		};
+		std::vector<Chunk> Chunks;
+		size_t Current = 0;
+		size_t Offset = 0;
+		std::atomic<int> Live{ 0 };
+
+		~TempArena()
+		{
+			for (auto&& c : Chunks)
+			{
+				free(c.Data);
+			}
+		}
+
+		void Rewind()
+		{
+			Current = 0;
+			Offset = 0;
+		}
+
+		void* Allocate(size_t Size)
+		{
+			//ResetTempArena之后再释放之前的内存会让Live小于0，同样当作全部已经释放
+			//acquire与HeaderFree中的release配对，其它线程对这些内存的使用都在重新分配之前完成
+			if (Live.load(std::memory_order_acquire) <= 0)
+			{
+				Live.store(0, std::memory_order_relaxed);
+				Rewind();
+			}
+			size_t Need = AlignUp(Size) + HeaderSize;
+			while (Current < Chunks.size() && Offset + Need > Chunks[Current].Size)
+			{
+				Current++;
+				Offset = 0;
+			}
+			if (Current == Chunks.size())
+			{
+				size_t ChunkSize = Need > TempChunkSize ? Need : TempChunkSize;
+				uint8_t* Data = static_cast<uint8_t*>(malloc(ChunkSize));
+				if (!Data)
+				{
+					return nullptr;
+				}
+				Chunks.push_back({ Data, ChunkSize });
+			}
+			//malloc返回的内存至少16字节对齐（x64），每次分配的大小也是16的倍数
+			BlockHeader* Header = reinterpret_cast<BlockHeader*>(Chunks[Current].Data + Offset);
+			Offset += Need;
+			Live.fetch_add(1, std::memory_order_relaxed);
+			Header->Owner = this;
+			Header->Kind = KindTemp;
+			Header->Extra = RC_ALLOC_TEMP;
+			return Header + 1;
+		}
+	};
+
+	/*
+	* 线程退出后其它线程还可能释放它的临时内存，所以线程结束时不销毁TempArena，而是放进这里，
+	* 之后新线程复用其中已经全部释放的，Uninstall时删除已经全部释放的
+	*/
+	struct RetiredArenaList
+	{
+		std::mutex Lock;
+		std::vector<TempArena*> Arenas;
+
+		~RetiredArenaList()
+		{
+			for (TempArena* Arena : Arenas)
+			{
+				delete Arena;
+			}
+		}
+
+		TempArena* Acquire()
+		{
+			std::lock_guard<std::mutex> Guard(Lock);
+			for (size_t i = 0; i < Arenas.size(); i++)
+			{
+				if (Arenas[i]->Live.load(std::memory_order_acquire) <= 0)
+				{
+					TempArena* Arena = Arenas[i];
+					Arenas[i] = Arenas.back();
+					Arenas.pop_back();
+					return Arena;
+				}
+			}
+			return new TempArena();
+		}
+
+		void Retire(TempArena* Arena)
+		{
+			std::lock_guard<std::mutex> Guard(Lock);
+			Arenas.push_back(Arena);
+		}
+
+		void Trim()
+		{
+			std::lock_guard<std::mutex> Guard(Lock);
+			for (size_t i = 0; i < Arenas.size();)
+			{
+				if (Arenas[i]->Live.load(std::memory_order_acquire) <= 0)
+				{
+					delete Arenas[i];
+					Arenas[i] = Arenas.back();
+					Arenas.pop_back();
+				}
+				else
+				{
+					i++;
+				}
+			}
+		}
+	};
+	RetiredArenaList RetiredArenas;
+
+	/*
+	* 每个线程第一次分配临时内存时才取得TempArena，线程结束时交给RetiredArenas
+	*/
+	struct LocalArenaHolder
+	{
+		TempArena* Arena = nullptr;
+
+		~LocalArenaHolder()
+		{
+			if (Arena)
+			{
+				RetiredArenas.Retire(Arena);
+			}
+		}
+
+		TempArena& Get()
+		{
+			if (!Arena)
+			{
+				Arena = RetiredArenas.Acquire();
+			}
+			return *Arena;
+		}
+	};
+	thread_local LocalArenaHolder LocalArena;
+
+	/*
+	* 一级内存池，Slabs只增加不归还
+	*/
+	struct SizeClassPool
+	{
+		std::mutex Lock;
+		BlockHeader* FreeList = nullptr;
+		std::vector<uint8_t*> Slabs;
+	};
+	SizeClassPool Pools[ClassNum];
+
+	int GetSizeClass(size_t Size)
+	{
+		size_t Need = Size + HeaderSize;
+		int Shift = MinClassShift;
+		while ((size_t(1) << Shift) < Need)
+		{
+			Shift++;
+		}
+		return Shift - MinClassShift;
+	}
+
+	void* PoolAllocate(int Class)
+	{
+		SizeClassPool& Pool = Pools[Class];
+		size_t BlockSize = size_t(1) << (Class + MinClassShift);
+		std::lock_guard<std::mutex> Guard(Pool.Lock);
+		if (!Pool.FreeList)
+		{
+			size_t SlabSize = BlockSize > PoolSlabSize ? BlockSize : PoolSlabSize;
+			uint8_t* Slab = static_cast<uint8_t*>(malloc(SlabSize));
+			if (!Slab)
+			{
+				return nullptr;
+			}
+			Pool.Slabs.push_back(Slab);
+			//空闲块用头里的Owner串成链表，地址小的在前面
+			for (size_t i = SlabSize / BlockSize; i > 0; i--)
+			{
+				BlockHeader* Block = reinterpret_cast<BlockHeader*>(Slab + (i - 1) * BlockSize);
+				Block->Owner = reinterpret_cast<TempArena*>(Pool.FreeList);
+				Pool.FreeList = Block;
+			}
+		}
+		BlockHeader* Header = Pool.FreeList;
+		Pool.FreeList = reinterpret_cast<BlockHeader*>(Header->Owner);
+		Header->Owner = nullptr;
+		Header->Kind = KindPool;
+		Header->Extra = uint32_t(Class);
+		return Header + 1;
+	}
+
+	void PoolFree(BlockHeader* Header)
+	{
+		SizeClassPool& Pool = Pools[Header->Extra];
+		std::lock_guard<std::mutex> Guard(Pool.Lock);
+		Header->Owner = reinterpret_cast<TempArena*>(Pool.FreeList);
+		Pool.FreeList = Header;
+	}
+
+	void* MallocAllocate(size_t Size, rcAllocHint Hint)
+	{
+		BlockHeader* Header = static_cast<BlockHeader*>(malloc(Size + HeaderSize));
+		if (!Header)
+		{
+			return nullptr;
+		}
+		Header->Owner = nullptr;
+		Header->Kind = KindMalloc;
+		Header->Extra = Hint;
+		return Header + 1;
+	}
+
+	void* PooledAlloc(size_t Size, rcAllocHint Hint)
+	{
+		CountAlloc(Hint, Size);
+		if (Hint == RC_ALLOC_TEMP)
+		{
+			return LocalArena.Get().Allocate(Size);
+		}
+		int Class = GetSizeClass(Size);
+		if (Class < ClassNum)
+		{
+			return PoolAllocate(Class);
+		}
+		return MallocAllocate(Size, Hint);
+	}
+
+	void* CountingAlloc(size_t Size, rcAllocHint Hint)
+	{
+		CountAlloc(Hint, Size);
+		return MallocAllocate(Size, Hint);
+	}
+
+	void HeaderFree(void* Ptr)
+	{
+		BlockHeader* Header = static_cast<BlockHeader*>(Ptr) - 1;
+		switch (Header->Kind)
+		{
+		case KindTemp:
+			CountFree(RC_ALLOC_TEMP);
+			//Owner的线程可能已经结束，TempArena在RetiredArenas中仍然有效
+			Header->Owner->Live.fetch_sub(1, std::memory_order_release);
+			break;
+		case KindPool:
+			CountFree(RC_ALLOC_PERM);
+			PoolFree(Header);
+			break;
+		default:
+			CountFree(rcAllocHint(Header->Extra));
+			free(Header);
+			break;
+		}
+	}
+}
+
+namespace recastAllocator
+{
+	void InstallPooled()
+	{
+		rcAllocSetCustom(PooledAlloc, HeaderFree);
+	}
+
+	void InstallCountingMalloc()
+	{
+		rcAllocSetCustom(CountingAlloc, HeaderFree);
+	}
+
+	void Uninstall()
+	{
+		rcAllocSetCustom(nullptr, nullptr);
+		RetiredArenas.Trim();
+	}
+
+	void ResetTempArena()
+	{
+		TempArena& Arena = LocalArena.Get();
+		Arena.Live.store(0, std::memory_order_relaxed);
+		Arena.Rewind();
+	}
+
+	size_t GetTempArenaCapacity()
+	{
+		size_t Capacity = 0;
+		for (auto&& c : LocalArena.Get().Chunks)
+		{
+			Capacity += c.Size;
+		}
+		return Capacity;
+	}
+
+	AllocStats GetStats(rcAllocHint Hint)
+	{
+		AllocStats Stats;
+		Stats.AllocNum = Counters[Hint].AllocNum.load(std::memory_order_relaxed);
+		Stats.AllocBytes = Counters[Hint].AllocBytes.load(std::memory_order_relaxed);
+		Stats.FreeNum = Counters[Hint].FreeNum.load(std::memory_order_relaxed);
+		return Stats;
+	}
+
+	void ResetStats()
+	{
+		for (auto&& c : Counters)
+		{
+			c.AllocNum.store(0, std::memory_order_relaxed);
+			c.AllocBytes.store(0, std::memory_order_relaxed);
+			c.FreeNum.store(0, std::memory_order_relaxed);
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "ReCast/RecastAlloc.h"
+
+/*
+* 通过rcAllocSetCustom安装的Recast分配器
+* RC_ALLOC_TEMP：每个线程一块线性内存（按块增长），分配只移动指针，释放只减少计数，
+*               本线程的临时内存全部释放后（或调用ResetTempArena后）下一次分配从头开始，
+*               可以在其它线程释放，线程结束后它的线性内存保留到其中的分配全部释放，再交给新线程复用
+* RC_ALLOC_PERM：按2的幂分级的内存池，每级一个空闲链表，超过最大一级的直接使用malloc
+* 每次分配前面有一个16字节的头，记录这块内存属于哪种分配，rcFree根据它归还
+* 安装前分配的内存不能在安装后释放，反之亦然：必须在第一次调用Recast之前安装，并在释放所有Recast对象之后卸载
+*/
+namespace recastAllocator
+{
+	/*
+	* 每种rcAllocHint的统计，所有线程合计
+	*/
+	struct AllocStats
+	{
+		uint64_t AllocNum = 0;
+		uint64_t AllocBytes = 0;
+		uint64_t FreeNum = 0;
+	};
+	/*
+	* 安装线性内存与内存池分配器
+	*/
+	void InstallPooled();
+	/*
+	* 安装只统计、直接使用malloc的分配器，用于和InstallPooled对比
+	*/
+	void InstallCountingMalloc();
+	/*
+	* 恢复Recast默认的malloc，并归还已结束线程中已经全部释放的线性内存
+	*/
+	void Uninstall();
+	/*
+	* 丢弃当前线程线性内存中的所有临时分配，调用者保证其中没有还在使用的内存
+	* 一般在两个Tile之间调用
+	*/
+	void ResetTempArena();
+	/*
+	* 当前线程线性内存占用的字节数（包括已经丢弃但没有归还给系统的）
+	*/
+	size_t GetTempArenaCapacity();
+	AllocStats GetStats(rcAllocHint Hint);
+	void ResetStats();
+}
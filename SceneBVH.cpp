@@ -0,0 +1,202 @@
+#include "SceneBVH.h"
+#include "SceneMgr.h"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+	const int LeafObjectNum = 4;
+	const int BinNum = 12;
+	const int MaxStackDepth = 64;
+	const int MaxSAHDepth = 32;//超过这个深度后改用中位数分割，保证树的深度不超过MaxStackDepth
+
+	float SurfaceArea(const glm::vec3& Min, const glm::vec3& Max)
+	{
+		glm::vec3 d = Max - Min;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	struct Bounds
+	{
+		glm::vec3 Min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 Max = glm::vec3(-std::numeric_limits<float>::max());
+		void Grow(const glm::vec3& PMin, const glm::vec3& PMax)
+		{
+			Min = glm::vec3(std::min(Min.x, PMin.x), std::min(Min.y, PMin.y), std::min(Min.z, PMin.z));
+			Max = glm::vec3(std::max(Max.x, PMax.x), std::max(Max.y, PMax.y), std::max(Max.z, PMax.z));
+		}
+	};
+}
+
+void MeshObjectBVH::Build(const std::vector<MeshObject>& Objects)
+{
+	Clear();
+	if (Objects.empty())
+	{
+		return;
+	}
+	int ObjectNum = int(Objects.size());
+	ObjectIndices.resize(ObjectNum);
+	ObjectMin.resize(ObjectNum);
+	ObjectMax.resize(ObjectNum);
+	Centers.resize(ObjectNum);
+	for (int i = 0; i < ObjectNum; i++)
+	{
+		ObjectIndices[i] = i;
+		ObjectMin[i] = Objects[i].WorldMin;
+		ObjectMax[i] = Objects[i].WorldMax;
+		Centers[i] = (Objects[i].WorldMin + Objects[i].WorldMax) * 0.5f;
+	}
+	Nodes.reserve(ObjectNum * 2 / LeafObjectNum + 1);
+	BuildNode(0, ObjectNum, 0);
+	std::vector<glm::vec3>().swap(Centers);
+}
+
+int MeshObjectBVH::BuildNode(int Begin, int End, int Depth)
+{
+	int NodeIndex = int(Nodes.size());
+	Nodes.emplace_back();
+
+	Bounds NodeBounds;
+	Bounds CenterBounds;
+	for (int i = Begin; i < End; i++)
+	{
+		int o = ObjectIndices[i];
+		NodeBounds.Grow(ObjectMin[o], ObjectMax[o]);
+		CenterBounds.Grow(Centers[o], Centers[o]);
+	}
+	Nodes[NodeIndex].Min = NodeBounds.Min;
+	Nodes[NodeIndex].Max = NodeBounds.Max;
+
+	int Count = End - Begin;
+	glm::vec3 Extent = CenterBounds.Max - CenterBounds.Min;
+	int Axis = Extent.x > Extent.y ? (Extent.x > Extent.z ? 0 : 2) : (Extent.y > Extent.z ? 1 : 2);
+	if (Count <= LeafObjectNum || Extent[Axis] <= 0.0f)
+	{
+		Nodes[NodeIndex].First = Begin;
+		Nodes[NodeIndex].Count = Count;
+		return NodeIndex;
+	}
+
+	//按中心点分桶，选择SAH代价最小的分割位置
+	Bounds BinBounds[BinNum];
+	int BinCount[BinNum] = {};
+	float Scale = BinNum / Extent[Axis];
+	auto BinOf = [&](int o)
+	{
+		int b = int((Centers[o][Axis] - CenterBounds.Min[Axis]) * Scale);
+		return std::min(b, BinNum - 1);
+	};
+	for (int i = Begin; i < End; i++)
+	{
+		int o = ObjectIndices[i];
+		int b = BinOf(o);
+		BinCount[b]++;
+		BinBounds[b].Grow(ObjectMin[o], ObjectMax[o]);
+	}
+	float LeftArea[BinNum - 1];
+	int LeftCount[BinNum - 1];
+	Bounds Accumulate;
+	int AccumulateCount = 0;
+	for (int b = 0; b < BinNum - 1; b++)
+	{
+		AccumulateCount += BinCount[b];
+		if (BinCount[b] > 0)
+		{
+			Accumulate.Grow(BinBounds[b].Min, BinBounds[b].Max);
+		}
+		LeftCount[b] = AccumulateCount;
+		LeftArea[b] = AccumulateCount > 0 ? SurfaceArea(Accumulate.Min, Accumulate.Max) : 0.0f;
+	}
+	int BestSplit = -1;
+	float BestCost = std::numeric_limits<float>::max();
+	Accumulate = Bounds();
+	AccumulateCount = 0;
+	for (int b = BinNum - 1; b > 0 && Depth < MaxSAHDepth; b--)
+	{
+		AccumulateCount += BinCount[b];
+		if (BinCount[b] > 0)
+		{
+			Accumulate.Grow(BinBounds[b].Min, BinBounds[b].Max);
+		}
+		if (AccumulateCount == 0 || LeftCount[b - 1] == 0)
+		{
+			continue;
+		}
+		float Cost = LeftArea[b - 1] * LeftCount[b - 1] + SurfaceArea(Accumulate.Min, Accumulate.Max) * AccumulateCount;
+		if (Cost < BestCost)
+		{
+			BestCost = Cost;
+			BestSplit = b;
+		}
+	}
+
+	int Middle;
+	if (BestSplit < 0)
+	{
+		Middle = Begin + Count / 2;
+		std::nth_element(ObjectIndices.begin() + Begin, ObjectIndices.begin() + Middle, ObjectIndices.begin() + End,
+			[&](int a, int b) { return Centers[a][Axis] < Centers[b][Axis]; });
+	}
+	else
+	{
+		Middle = int(std::partition(ObjectIndices.begin() + Begin, ObjectIndices.begin() + End,
+			[&](int o) { return BinOf(o) < BestSplit; }) - ObjectIndices.begin());
+	}
+
+	BuildNode(Begin, Middle, Depth + 1);
+	int Right = BuildNode(Middle, End, Depth + 1);
+	Nodes[NodeIndex].First = Begin;
+	Nodes[NodeIndex].RightChild = Right;
+	Nodes[NodeIndex].Count = 0;
+	return NodeIndex;
+}
+
+void MeshObjectBVH::Query(const glm::vec3& Min, const glm::vec3& Max, std::vector<int>& Out) const
+{
+	if (Nodes.empty())
+	{
+		return;
+	}
+	auto Intersect = [&](const glm::vec3& BMin, const glm::vec3& BMax)
+	{
+		return BMax.x > Min.x && BMin.x < Max.x && BMax.y > Min.y && BMin.y < Max.y && BMax.z > Min.z && BMin.z < Max.z;
+	};
+
+	int Stack[MaxStackDepth];
+	int StackSize = 0;
+	Stack[StackSize++] = 0;
+	while (StackSize > 0)
+	{
+		const Node& n = Nodes[Stack[--StackSize]];
+		if (!Intersect(n.Min, n.Max))
+		{
+			continue;
+		}
+		if (n.Count > 0)
+		{
+			for (int i = n.First; i < n.First + n.Count; i++)
+			{
+				int o = ObjectIndices[i];
+				if (Intersect(ObjectMin[o], ObjectMax[o]))
+				{
+					Out.emplace_back(o);
+				}
+			}
+		}
+		else
+		{
+			Stack[StackSize++] = n.RightChild;
+			Stack[StackSize++] = int(&n - Nodes.data()) + 1;
+		}
+	}
+}
+
+void MeshObjectBVH::Clear()
+{
+	std::vector<Node>().swap(Nodes);
+	std::vector<int>().swap(ObjectIndices);
+	std::vector<glm::vec3>().swap(ObjectMin);
+	std::vector<glm::vec3>().swap(ObjectMax);
+	std::vector<glm::vec3>().swap(Centers);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include "glm/glm.hpp"
+
+struct MeshObject;
+
+/*
+* MeshObject世界AABB的层次包围盒（BVH）
+* 用分桶SAH自顶向下构建，节点连续存放，左孩子紧跟在父节点之后
+* 场景加载完成后构建一次，MeshObjects改变后需要重新构建（见SceneMgr::UpdateObjectBVH）
+*/
+class MeshObjectBVH
+{
+public:
+	void Build(const std::vector<MeshObject>& Objects);
+	/*
+	* 把与[Min, Max]相交的MeshObject的下标追加到Out中（判断方式与voxelFuncs::wetherAABBIntersect相同），顺序不固定
+	*/
+	void Query(const glm::vec3& Min, const glm::vec3& Max, std::vector<int>& Out) const;
+	int GetObjectNum() const { return int(ObjectIndices.size()); }
+	int GetNodeNum() const { return int(Nodes.size()); }
+	void Clear();
+private:
+	/*
+	* Count > 0 为叶子节点，包含ObjectIndices[First, First + Count)
+	* Count == 0 为内部节点，左孩子为当前节点的下一个，右孩子为RightChild
+	*/
+	struct Node
+	{
+		glm::vec3 Min;
+		glm::vec3 Max;
+		int First;
+		int RightChild;
+		int Count;
+	};
+	int BuildNode(int Begin, int End, int Depth);
+private:
+	std::vector<Node> Nodes;
+	std::vector<int> ObjectIndices;
+	std::vector<glm::vec3> ObjectMin;
+	std::vector<glm::vec3> ObjectMax;
+	std::vector<glm::vec3> Centers;
+};
@@ -1,5 +1,11 @@
 #include "SceneMgr.h"
+#include "MeshCache.h"
+#include "FileMapping.h"
+#include "TaskScheduler.h"
 #include <fstream>
+#include <sstream>
+#include <exception>
+#include <mutex>
 inline void GetMeshObjectWorldAABB(MeshObject& object, std::shared_ptr<MeshData> Mesh)
 {
 	glm::mat4 m;
@@ -61,14 +67,18 @@ void SceneMgr::LoadMeshData(const std::string& path)
 	}
 }
 
-void SceneMgr::LoadJsonData(const std::string& path)
+void SceneMgr::LoadJsonData(const std::string& path, const std::string& SceneFile)
 {
 	using json = nlohmann::json;
 	json senceJson;
-	std::ifstream sceneFile(path + "\\" + "scene_596.json");
+	std::ifstream sceneFile(path + PathSeparator + SceneFile);
 	sceneFile >> senceJson;
 	size_t MeshObjectSize = senceJson.at("mesh").size();
-	MeshObjects.reserve(MeshObjectSize);
+	size_t FirstObject = MeshObjects.size();
+	int FirstNewMesh = int(Meshes.size());
+	MeshObjects.reserve(FirstObject + MeshObjectSize);
+
+	//1.解析场景清单，按第一次出现的顺序给还没有加载过的模型分配MeshId
 	for (int i = 0; i < MeshObjectSize; i++)
 	{
 		std::string&& MeshPath = senceJson.at("mesh")[i].at("meshPath");
@@ -76,37 +86,144 @@ void SceneMgr::LoadJsonData(const std::string& path)
 		auto&& worldQuat = senceJson.at("mesh")[i].at("worldQuat");
 		auto&& scale = senceJson.at("mesh")[i].at("scale");
 
-		std::replace(MeshPath.begin(), MeshPath.end(), '/', '\\');
-		MeshPath = path + "\\" + MeshPath;
+		std::replace(MeshPath.begin(), MeshPath.end(), PathSeparator == '/' ? '\\' : '/', PathSeparator);
+		MeshPath = path + PathSeparator + MeshPath;
 		MeshObjects.emplace_back(MeshPath, glm::vec3(worldPos[0], worldPos[1], worldPos[2]), glm::quat(worldQuat[3], worldQuat[0], worldQuat[1], worldQuat[2]), glm::vec3(scale[0], scale[1], scale[2]));
-		if (MeshMap.count(MeshPath) < 1)
+		MeshObjects.back().MeshId = InternMesh(MeshPath);
+	}
+
+	//2.并行加载模型，每个任务只写自己的MeshData，MeshMap与Meshes在上面已经填好，这里不再修改
+	//  任务中的异常在所有任务结束后重新抛出，与单线程时一样由调用者处理
+	WorkStealingScheduler Scheduler(LoadThreadNum);
+	std::exception_ptr FirstError;
+	std::mutex ErrorLock;
+	Scheduler.ParallelFor(int(Meshes.size()) - FirstNewMesh, [&](int TaskIndex, int)
+	{
+		try
+		{
+			LoadMesh(*Meshes[FirstNewMesh + TaskIndex]);
+		}
+		catch (...)
 		{
-			LoadMesh(MeshPath);
+			std::lock_guard<std::mutex> Guard(ErrorLock);
+			if (!FirstError)
+			{
+				FirstError = std::current_exception();
+			}
 		}
-		GetMeshObjectWorldAABB(MeshObjects[MeshObjects.size() - 1], MeshMap[MeshPath]);
-		TriangleNum += MeshMap[MeshPath]->indices.size() / 3.0f;
+	});
+	if (FirstError)
+	{
+		std::rethrow_exception(FirstError);
+	}
+
+	//3.并行计算每个MeshObject在世界坐标系下的AABB
+	Scheduler.ParallelFor(int(MeshObjectSize), [&](int TaskIndex, int)
+	{
+		MeshObject& Object = MeshObjects[FirstObject + TaskIndex];
+		GetMeshObjectWorldAABB(Object, Meshes[Object.MeshId]);
+	});
+
+	//三角形数按场景中的顺序累加，结果与加载顺序无关
+	for (size_t i = FirstObject; i < MeshObjects.size(); i++)
+	{
+		TriangleNum += GetMesh(MeshObjects[i].MeshId).indices.size() / 3.0f;
+	}
+
+	BuildObjectBVH();
+}
+
+void SceneMgr::BuildObjectBVH()
+{
+	ObjectBVH.Build(MeshObjects);
+	ObjectBVHHash = HashObjects();
+	VertexCache.Clear();
+}
+
+bool SceneMgr::UpdateObjectBVH()
+{
+	if (ObjectBVH.GetObjectNum() == MeshObjects.size() && ObjectBVHHash == HashObjects())
+	{
+		return false;
+	}
+	BuildObjectBVH();
+	return true;
+}
+
+uint64_t SceneMgr::HashObjects() const
+{
+	uint64_t Hash = HashBytes(nullptr, 0);
+	for (auto&& Object : MeshObjects)
+	{
+		float Transform[16] = { Object.WorldPos.x, Object.WorldPos.y, Object.WorldPos.z,
+			Object.rotation.x, Object.rotation.y, Object.rotation.z, Object.rotation.w,
+			Object.scale.x, Object.scale.y, Object.scale.z,
+			Object.WorldMin.x, Object.WorldMin.y, Object.WorldMin.z,
+			Object.WorldMax.x, Object.WorldMax.y, Object.WorldMax.z };
+		Hash = HashBytes(Object.MeshPathName.data(), Object.MeshPathName.size(), Hash);
+		Hash = HashBytes(&Object.MeshId, sizeof(Object.MeshId), Hash);
+		Hash = HashBytes(Transform, sizeof(Transform), Hash);
+	}
+	return Hash;
+}
+
+int SceneMgr::InternMesh(const std::string& MeshPath)
+{
+	auto&& Mesh = MeshMap[MeshPath];
+	if (!Mesh)
+	{
+		Mesh = std::make_shared<MeshData>();
+		Mesh->MeshPathName = MeshPath;
+		Mesh->MeshId = int(Meshes.size());
+		Meshes.emplace_back(Mesh);
 	}
+	return Mesh->MeshId;
 }
 
-void SceneMgr::LoadMesh(const std::string& s)
+void SceneMgr::LoadMesh(MeshData& Mesh)
 {
-	std::shared_ptr<MeshData> Mesh = std::make_shared<MeshData>();
-	Mesh->MeshPathName = s;
-	MeshMap[s] = Mesh;
+	const std::string& s = Mesh.MeshPathName;
+	std::string CachePath;
+	std::string Source;
+	if (UseMeshCache)
+	{
+		CachePath = meshCache::GetCachePath(s, MeshCacheDirectory);
+		if (meshCache::LoadMeshCache(s, CachePath, Mesh, Source))
+		{
+			return;
+		}
+	}
+
 	using json = nlohmann::json;
-	json MeshJson;
-	std::ifstream MeshFile(s);
-	MeshFile >> MeshJson;
-	for (int i = 0; i < MeshJson.at("vertices").size(); i++)
+	//缓存过期时LoadMeshCache已经读过源文件
+	if (Source.empty())
+	{
+		std::ifstream MeshFile(s, std::ios::binary);
+		std::ostringstream Stream;
+		Stream << MeshFile.rdbuf();
+		Source = Stream.str();
+	}
+	json MeshJson = json::parse(Source);
+
+	const json& Vertices = MeshJson.at("vertices");
+	Mesh.worldVertices.reserve(Vertices.size());
+	for (auto&& Vertex : Vertices)
 	{
-		glm::vec3 Pos(MeshJson.at("vertices")[i][0], MeshJson.at("vertices")[i][1], MeshJson.at("vertices")[i][2]);
-		Mesh->ModelSpaceMin = glm::vec3(std::min(Mesh->ModelSpaceMin.x,Pos.x), std::min(Mesh->ModelSpaceMin.y,Pos.y), std::min(Mesh->ModelSpaceMin.z,Pos.z));
-		Mesh->ModelSpaceMax = glm::vec3(std::max(Mesh->ModelSpaceMax.x,Pos.x), std::max(Mesh->ModelSpaceMax.y,Pos.y), std::max(Mesh->ModelSpaceMax.z,Pos.z));
-		Mesh->worldVertices.emplace_back(Pos);
+		glm::vec3 Pos(Vertex[0].get<float>(), Vertex[1].get<float>(), Vertex[2].get<float>());
+		Mesh.ModelSpaceMin = glm::vec3(std::min(Mesh.ModelSpaceMin.x,Pos.x), std::min(Mesh.ModelSpaceMin.y,Pos.y), std::min(Mesh.ModelSpaceMin.z,Pos.z));
+		Mesh.ModelSpaceMax = glm::vec3(std::max(Mesh.ModelSpaceMax.x,Pos.x), std::max(Mesh.ModelSpaceMax.y,Pos.y), std::max(Mesh.ModelSpaceMax.z,Pos.z));
+		Mesh.worldVertices.emplace_back(Pos);
 	}
-	for (int i = 0; i < MeshJson.at("indices").size(); i++)
+	const json& Indices = MeshJson.at("indices");
+	Mesh.indices.reserve(Indices.size());
+	for (auto&& Index : Indices)
+	{
+		Mesh.indices.emplace_back(Index.get<int>());
+	}
+
+	if (UseMeshCache)
 	{
-		Mesh->indices.emplace_back(MeshJson.at("indices")[i]);
+		meshCache::SaveMeshCache(CachePath, Mesh, HashBytes(Source.data(), Source.size()));
 	}
 
 }
@@ -3,6 +3,8 @@
 #include"glm/glm.hpp"
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include "SceneBVH.h"
+#include "VertexCache.h"
 
 /*
 * 三角形汤，暂时不用
@@ -21,6 +23,7 @@ struct GeometryData
 struct MeshData
 {
 	std::string MeshPathName;
+	int MeshId = -1;//在SceneMgr::Meshes中的下标
 	std::vector<glm::vec3> worldVertices;
 	std::vector<int>           indices;
 	MeshData() = default;
@@ -39,6 +42,7 @@ struct MeshObject
 	glm::vec3 scale;
 	glm::vec3 WorldMin;
 	glm::vec3 WorldMax;
+	int MeshId = -1;//模型在SceneMgr::Meshes中的下标，由SceneMgr::InternMesh分配
 	MeshObject() = default;
 	MeshObject(const std::string& str,const glm::vec3& w,const glm::quat& q,const glm::vec3& scale)
 		:MeshPathName(str),WorldPos(w),rotation(q),scale(scale)
@@ -53,15 +57,60 @@ struct MeshObject
 
 };
 
+/*
+* 当前平台的路径分隔符
+*/
+#ifdef _WIN32
+const char PathSeparator = '\\';
+#else
+const char PathSeparator = '/';
+#endif
+
 class SceneMgr
 {
 public:
 	void LoadMeshData(const std::string& s = "D:\\master\\bin\\asset\\Test2\\596.json");
-	void LoadJsonData(const std::string& s = "D:\\master\\bin\\asset\\Test2\\JsonData2");
+	/*
+	* 加载场景：先解析场景清单，再用LoadThreadNum个线程并行加载所有新出现的模型，最后并行计算每个MeshObject的世界AABB
+	* MeshObjects的顺序与场景文件相同，TriangleNum与线程数无关
+	* s为场景目录，SceneFile为目录下的场景清单，清单中的模型路径相对于场景目录，'/'与'\\'都可以作为分隔符
+	*/
+	void LoadJsonData(const std::string& s = "D:\\master\\bin\\asset\\Test2\\JsonData2", const std::string& SceneFile = "scene_596.json");
 	std::vector<GeometryData> GeometryDatas;//三角形汤
 	std::vector<MeshObject> MeshObjects;
 	std::unordered_map<std::string, std::shared_ptr<MeshData>> MeshMap;//根据Mesh的路径名获取Mesh的指针
+	std::vector<std::shared_ptr<MeshData>> Meshes;//按MeshId索引的模型表，与MeshMap中的模型相同
 	int TriangleNum = 0;
+	bool UseMeshCache = true;//使用二进制的模型缓存，见MeshCache.h
+	std::string MeshCacheDirectory;//模型缓存的目录，为空时缓存放在模型文件旁边
+	int LoadThreadNum = 0;//加载模型使用的线程数，<= 0时使用硬件线程数
+	MeshObjectBVH ObjectBVH;//MeshObjects世界AABB的BVH，LoadJsonData结束时构建
+	WorldVertexCache VertexCache;//体素化时使用的世界坐标顶点缓存，默认预算为0即不缓存
+	/*
+	* 重新构建ObjectBVH并清空VertexCache，直接修改MeshObjects后需要调用
+	*/
+	void BuildObjectBVH();
+	/*
+	* MeshObjects与上次构建ObjectBVH时不同（数量、模型、变换或AABB改变）时调用BuildObjectBVH，返回是否重新构建
+	* voxelFuncs::ReCastSphereVoxelization开始时会调用，单独调用ReCastSingleTileReCast前需要自己调用
+	*/
+	bool UpdateObjectBVH();
+	/*
+	* 返回路径对应的MeshId，路径第一次出现时在MeshMap与Meshes中创建一个空的MeshData
+	*/
+	int InternMesh(const std::string& MeshPath);
+	/*
+	* 按MeshId取模型，不做字符串查找，可以在多个线程中同时调用
+	*/
+	const MeshData& GetMesh(int MeshId) const { return *Meshes[MeshId]; }
 private:
-	void LoadMesh(const std::string& s);
+	/*
+	* 加载Mesh.MeshPathName对应的模型，只写入Mesh，可以在多个线程中同时调用
+	*/
+	void LoadMesh(MeshData& Mesh);
+	/*
+	* 所有MeshObject的模型、变换与AABB的哈希，用于判断ObjectBVH是否过期
+	*/
+	uint64_t HashObjects() const;
+	uint64_t ObjectBVHHash = 0;//构建ObjectBVH时的HashObjects()
 };
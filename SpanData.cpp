@@ -1,3 +1,249 @@
 #include "SpanData.h"
+#include <algorithm>
+#include <cmath>
 
+void CompactSpanData::Build(const std::vector<SpanList>& Data)
+{
+	Clear();
+	SpanOffsets.resize(Data.size() + 1);
+	int SpanNum = 0;
+	for (int i = 0; i < Data.size(); i++)
+	{
+		SpanOffsets[i] = SpanNum;
+		SpanNum += int(Data[i].Spans.size());
+	}
+	SpanOffsets[Data.size()] = SpanNum;
 
+	Spans.reserve(SpanNum);
+	Lists.resize(Data.size());
+	ExtraNeighborOffsets.resize(Data.size() + 1);
+	for (int i = 0; i < Data.size(); i++)
+	{
+		const SpanList& Source = Data[i];
+		Spans.insert(Spans.end(), Source.Spans.begin(), Source.Spans.end());
+
+		ExtraNeighborOffsets[i] = int(ExtraNeighbors.size());
+		if (Source.neighborsIndex.size() > 4)
+		{
+			ExtraNeighbors.insert(ExtraNeighbors.end(), Source.neighborsIndex.begin() + 4, Source.neighborsIndex.end());
+		}
+
+		CompactSpanList& List = Lists[i];
+		List.CenteralWorldPos = Source.CenteralWorldPos;
+		List.TileIndex = Source.TileIndex;
+		for (int d = 0; d < 4; d++)
+		{
+			List.Neighbors[d] = d < Source.neighborsIndex.size() ? Source.neighborsIndex[d] : -1;
+		}
+	}
+
+	ExtraNeighborOffsets[Data.size()] = int(ExtraNeighbors.size());
+
+	SpanPtr = Spans.data();
+	OffsetPtr = SpanOffsets.data();
+	ListPtr = Lists.data();
+	ExtraNeighborOffsetPtr = ExtraNeighborOffsets.data();
+	ExtraNeighborPtr = ExtraNeighbors.data();
+	this->SpanNum = SpanNum;
+	ListNum = int(Lists.size());
+}
+
+void CompactSpanData::Attach(const Span* ExternalSpans, int ExternalSpanNum, const int* ExternalSpanOffsets, const CompactSpanList* ExternalLists, int ExternalListNum,
+	const int* ExternalExtraNeighborOffsets, const int* ExternalExtraNeighbors, std::shared_ptr<const void> Owner)
+{
+	Clear();
+	ExternalOwner = std::move(Owner);
+	SpanPtr = ExternalSpans;
+	OffsetPtr = ExternalSpanOffsets;
+	ListPtr = ExternalLists;
+	ExtraNeighborOffsetPtr = ExternalExtraNeighborOffsets;
+	ExtraNeighborPtr = ExternalExtraNeighbors;
+	SpanNum = ExternalSpanNum;
+	ListNum = ExternalListNum;
+}
+
+void CompactSpanData::BuildLinks(float ClimbHeight)
+{
+	LinkOffsets.assign(size_t(SpanNum) + 1, 0);
+	std::vector<int>().swap(LinkSpans);
+	LinkSpans.reserve(size_t(SpanNum) * 4);
+	for (int i = 0; i < SpanNum; i++)
+	{
+		LinkOffsets[i] = int(LinkSpans.size());
+		const Span& sp = SpanPtr[i];
+		ForEachNeighbor(sp.ListIndex, [&](int NeighborList)
+		{
+			for (int j = OffsetPtr[NeighborList]; j < OffsetPtr[NeighborList + 1]; j++)
+			{
+				if (std::abs(SpanPtr[j].top - sp.top) <= ClimbHeight)
+				{
+					LinkSpans.emplace_back(j);
+				}
+			}
+		});
+	}
+	LinkOffsets[SpanNum] = int(LinkSpans.size());
+	LinkSpans.shrink_to_fit();
+	LinkOffsetPtr = LinkOffsets.data();
+	LinkSpanPtr = LinkSpans.data();
+	LinkClimbHeight = ClimbHeight;
+	BuildComponents();
+}
+
+void CompactSpanData::AttachLinks(const int* ExternalLinkOffsets, const int* ExternalLinkSpans, float ClimbHeight)
+{
+	std::vector<int>().swap(LinkOffsets);
+	std::vector<int>().swap(LinkSpans);
+	LinkOffsetPtr = ExternalLinkOffsets;
+	LinkSpanPtr = ExternalLinkSpans;
+	LinkClimbHeight = ClimbHeight;
+	std::vector<int>().swap(Components);
+	std::vector<int>().swap(ComponentSizes);
+	ComponentPtr = nullptr;
+	ComponentSizePtr = nullptr;
+	ComponentNum = 0;
+}
+
+void CompactSpanData::BuildComponents()
+{
+	//并查集，根节点是分量中最小的Span编号
+	std::vector<int> Parent(SpanNum);
+	for (int i = 0; i < SpanNum; i++)
+	{
+		Parent[i] = i;
+	}
+	auto Find = [&Parent](int i)
+	{
+		while (Parent[i] != i)
+		{
+			Parent[i] = Parent[Parent[i]];
+			i = Parent[i];
+		}
+		return i;
+	};
+	for (int i = 0; i < SpanNum; i++)
+	{
+		for (int k = GetLinkBegin(i); k < GetLinkEnd(i); k++)
+		{
+			int j = GetLinkedSpan(k);
+			int a = Find(i);
+			int b = Find(j);
+			if (a != b)
+			{
+				Parent[std::max(a, b)] = std::min(a, b);
+			}
+		}
+	}
+
+	std::vector<int> Roots;
+	std::vector<int> RootSize(SpanNum, 0);
+	Components.resize(SpanNum);
+	for (int i = 0; i < SpanNum; i++)
+	{
+		Components[i] = Find(i);
+		if (Components[i] == i)
+		{
+			Roots.emplace_back(i);
+		}
+		RootSize[Components[i]]++;
+	}
+	std::stable_sort(Roots.begin(), Roots.end(), [&RootSize](int a, int b) { return RootSize[a] > RootSize[b]; });
+	ComponentSizes.resize(Roots.size());
+	for (int c = 0; c < Roots.size(); c++)
+	{
+		ComponentSizes[c] = RootSize[Roots[c]];
+		//Components中已经是根节点，Parent不再需要，根节点的位置改为存放分量编号
+		Parent[Roots[c]] = c;
+	}
+	for (int i = 0; i < SpanNum; i++)
+	{
+		Components[i] = Parent[Components[i]];
+	}
+	ComponentPtr = Components.data();
+	ComponentSizePtr = ComponentSizes.data();
+	ComponentNum = int(ComponentSizes.size());
+}
+
+void CompactSpanData::AttachComponents(const int* SpanComponents, const int* Sizes, int Num)
+{
+	std::vector<int>().swap(Components);
+	std::vector<int>().swap(ComponentSizes);
+	ComponentPtr = SpanComponents;
+	ComponentSizePtr = Sizes;
+	ComponentNum = Num;
+}
+
+size_t CompactSpanData::GetMemorySize() const
+{
+	return Spans.capacity() * sizeof(Span) + SpanOffsets.capacity() * sizeof(int) + Lists.capacity() * sizeof(CompactSpanList)
+		+ ExtraNeighborOffsets.capacity() * sizeof(int) + ExtraNeighbors.capacity() * sizeof(int) + LinkOffsets.capacity() * sizeof(int) + LinkSpans.capacity() * sizeof(int)
+		+ Components.capacity() * sizeof(int) + ComponentSizes.capacity() * sizeof(int);
+}
+
+void CompactSpanData::Clear()
+{
+	std::vector<Span>().swap(Spans);
+	std::vector<int>().swap(SpanOffsets);
+	std::vector<CompactSpanList>().swap(Lists);
+	std::vector<int>().swap(ExtraNeighborOffsets);
+	std::vector<int>().swap(ExtraNeighbors);
+	std::vector<int>().swap(LinkOffsets);
+	std::vector<int>().swap(LinkSpans);
+	std::vector<int>().swap(Components);
+	std::vector<int>().swap(ComponentSizes);
+	ExternalOwner.reset();
+	SpanPtr = nullptr;
+	OffsetPtr = nullptr;
+	ListPtr = nullptr;
+	ExtraNeighborOffsetPtr = nullptr;
+	ExtraNeighborPtr = nullptr;
+	LinkOffsetPtr = nullptr;
+	LinkSpanPtr = nullptr;
+	LinkClimbHeight = 0.0f;
+	ComponentPtr = nullptr;
+	ComponentSizePtr = nullptr;
+	ComponentNum = 0;
+	SpanNum = 0;
+	ListNum = 0;
+}
+
+void SpanData::Compaction(bool ReleaseSource)
+{
+	//加载的烘焙文件没有Data，重新构造会清空Compact
+	if (ReadOnly)
+	{
+		return;
+	}
+	Compact.Build(Data);
+	if (ReleaseSource)
+	{
+		for (auto&& List : Data)
+		{
+			std::vector<Span>().swap(List.Spans);
+			std::vector<int>().swap(List.neighborsIndex);
+		}
+	}
+}
+
+void SpanData::Clear()
+{
+	std::vector<SpanList>().swap(Data);
+	std::vector<std::pair<int, int>>().swap(Dictionary);
+	Compact.Clear();
+	ReadOnly = false;
+}
+
+void SpanData::BuildLinks(float ClimbHeight)
+{
+	Compact.BuildLinks(ClimbHeight);
+}
+
+size_t SpanData::GetMemorySize() const
+{
+	size_t Size = Data.capacity() * sizeof(SpanList) + Dictionary.capacity() * sizeof(std::pair<int, int>);
+	for (auto&& List : Data)
+	{
+		Size += List.Spans.capacity() * sizeof(Span) + List.neighborsIndex.capacity() * sizeof(int);
+	}
+	return Size;
+}
@@ -4,6 +4,8 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 #include <memory>
+#include <cstddef>
+#include <cstdint>
 
 /*
 * 每个高度场中的一个Span
@@ -25,7 +27,7 @@ struct Span
 * 每个高度场中的一个SpanList
 * Spans：保存Span的数组
 * CenteralWorldPos：底中心点在世界坐标系下的位置
-* neighborsIndex：邻居List在整个SpanListData中的索引
+* neighborsIndex：邻居List在整个SpanListData中的索引，前四个依次为NegX, X, NegZ, Z方向，之后是为了使邻居关系对称而补上的额外邻居
 * TileIndex：从属于的Tile编号，需要先知道是哪一个球，再使用此编号
 * SphereIndex：从属于的球编号
 */
@@ -41,14 +43,156 @@ struct SpanList
 	{
 
 	}
+	SpanList()
+		:CenteralWorldPos(0, 0, 0), TileIndex(0), SphereIndex(0)
+	{
+
+	}
+};
+
+/*
+* 压缩后的SpanList，不再单独持有Span和邻居的数组
+* CenteralWorldPos，TileIndex：与SpanList相同
+* Neighbors：四个方向的邻居List的索引，顺序为 NegX, X, NegZ, Z，与SpanList::neighborsIndex相同
+* SpanList::neighborsIndex中的额外邻居保存在CompactSpanData的ExtraNeighbors中
+*/
+struct CompactSpanList
+{
+	glm::vec3 CenteralWorldPos;
+	int TileIndex;
+	int Neighbors[4];
 };
 
+/*
+* SpanData的CSR格式，只读
+* Spans：所有Span连续存放，第i个SpanList的Span为 Spans[SpanOffsets[i], SpanOffsets[i + 1])
+* 一个Span在Spans中的下标就是它的Span编号，Span::ListIndex仍然指向所属的SpanList
+* 由SpanData::Compaction生成，SpanList的编号与SpanData::Data相同
+* 数据可以由自己持有（Build），也可以直接指向外部的内存（Attach，例如映射的烘焙文件），访问接口相同
+*/
+class CompactSpanData
+{
+public:
+	void Build(const std::vector<SpanList>& Data);
+	/*
+	* 不拷贝，直接使用外部的数组，Owner用于保证外部内存在使用期间有效
+	*/
+	void Attach(const Span* Spans, int SpanNum, const int* SpanOffsets, const CompactSpanList* Lists, int ListNum, const int* ExtraNeighborOffsets, const int* ExtraNeighbors, std::shared_ptr<const void> Owner);
+	/*
+	* 计算每个Span的连接：所有邻居SpanList（ForEachNeighbor）中上表面高度差不超过ClimbHeight的所有Span，与逐个比较高度的搜索完全相同
+	* 连接按CSR格式保存：第i个Span连接到 LinkSpans[LinkOffsets[i], LinkOffsets[i + 1])，
+	* 顺序为方向（NegX, X, NegZ, Z，然后是额外邻居）再按邻居SpanList中Span的顺序，与逐个比较时展开的顺序相同
+	* 同时按连接计算连通分量（见BuildComponents）
+	*/
+	void BuildLinks(float ClimbHeight);
+	/*
+	* 在Attach之后使用外部的连接数组：LinkOffsets大小为SpanNum + 1，LinkSpans大小为LinkOffsets[SpanNum]
+	* 由Attach的Owner保证有效，已有的连通分量被清除
+	*/
+	void AttachLinks(const int* LinkOffsets, const int* LinkSpans, float ClimbHeight);
+	/*
+	* 把连接看作无向边，用并查集给每个Span标上所属连通分量的编号
+	* 编号按分量的Span数从大到小排列（相同时按分量中最小的Span编号），0号是最大的分量
+	* 两个Span的编号不同时一定没有路径；编号相同不保证有路径，因为连接不一定是双向的
+	*/
+	void BuildComponents();
+	/*
+	* 在AttachLinks之后使用外部的连通分量数组：每个Span的编号（大小为SpanNum）与每个分量的Span数（大小为ComponentNum）
+	*/
+	void AttachComponents(const int* SpanComponents, const int* ComponentSizes, int ComponentNum);
+	bool HasComponents() const { return ComponentPtr != nullptr; }
+	int GetComponentNum() const { return ComponentNum; }
+	int GetSpanComponent(int SpanIndex) const { return ComponentPtr[SpanIndex]; }
+	int GetComponentSize(int Component) const { return ComponentSizePtr[Component]; }
+	const int* GetSpanComponents() const { return ComponentPtr; }
+	const int* GetComponentSizes() const { return ComponentSizePtr; }
+	bool HasLinks() const { return LinkOffsetPtr != nullptr; }
+	float GetLinkClimbHeight() const { return LinkClimbHeight; }
+	int GetLinkNum() const { return LinkOffsetPtr ? LinkOffsetPtr[SpanNum] : 0; }
+	/*
+	* SpanIndex的连接为[GetLinkBegin, GetLinkEnd)，GetLinkedSpan取其中一个连接到的Span编号，需要HasLinks()
+	*/
+	int GetLinkBegin(int SpanIndex) const { return LinkOffsetPtr[SpanIndex]; }
+	int GetLinkEnd(int SpanIndex) const { return LinkOffsetPtr[SpanIndex + 1]; }
+	int GetLinkedSpan(int LinkIndex) const { return LinkSpanPtr[LinkIndex]; }
+	const int* GetLinkOffsets() const { return LinkOffsetPtr; }
+	const int* GetLinkSpans() const { return LinkSpanPtr; }
+	int GetListNum() const { return ListNum; }
+	int GetSpanNum() const { return SpanNum; }
+	const CompactSpanList& GetList(int ListIndex) const { return ListPtr[ListIndex]; }
+	int GetListSpanBegin(int ListIndex) const { return OffsetPtr[ListIndex]; }
+	int GetListSpanEnd(int ListIndex) const { return OffsetPtr[ListIndex + 1]; }
+	int GetListSpanNum(int ListIndex) const { return OffsetPtr[ListIndex + 1] - OffsetPtr[ListIndex]; }
+	const Span& GetSpan(int SpanIndex) const { return SpanPtr[SpanIndex]; }
+	int GetNeighbor(int ListIndex, int Direct) const { return ListPtr[ListIndex].Neighbors[Direct]; }
+	/*
+	* ListIndex的额外邻居为 GetExtraNeighbor(k)，k在[GetExtraNeighborBegin, GetExtraNeighborEnd)中
+	*/
+	int GetExtraNeighborBegin(int ListIndex) const { return ExtraNeighborOffsetPtr[ListIndex]; }
+	int GetExtraNeighborEnd(int ListIndex) const { return ExtraNeighborOffsetPtr[ListIndex + 1]; }
+	int GetExtraNeighbor(int k) const { return ExtraNeighborPtr[k]; }
+	int GetExtraNeighborNum() const { return ExtraNeighborOffsetPtr ? ExtraNeighborOffsetPtr[ListNum] : 0; }
+	const int* GetExtraNeighborOffsets() const { return ExtraNeighborOffsetPtr; }
+	const int* GetExtraNeighbors() const { return ExtraNeighborPtr; }
+	/*
+	* 按 NegX, X, NegZ, Z 与额外邻居的顺序对ListIndex的每个有效的邻居List调用Func(NeighborListIndex)
+	*/
+	template<typename F>
+	void ForEachNeighbor(int ListIndex, F&& Func) const
+	{
+		for (int NeighborListIndex : ListPtr[ListIndex].Neighbors)
+		{
+			if (NeighborListIndex >= 0 && NeighborListIndex < ListNum)
+			{
+				Func(NeighborListIndex);
+			}
+		}
+		for (int k = ExtraNeighborOffsetPtr[ListIndex]; k < ExtraNeighborOffsetPtr[ListIndex + 1]; k++)
+		{
+			Func(ExtraNeighborPtr[k]);
+		}
+	}
+	const Span* GetSpans() const { return SpanPtr; }
+	const int* GetSpanOffsets() const { return OffsetPtr; }
+	const CompactSpanList* GetLists() const { return ListPtr; }
+	/*
+	* 自己持有的内存（字节），Attach的外部内存不计算在内
+	*/
+	size_t GetMemorySize() const;
+	void Clear();
+private:
+	std::vector<Span> Spans;
+	std::vector<int> SpanOffsets;
+	std::vector<CompactSpanList> Lists;
+	std::vector<int> ExtraNeighborOffsets;
+	std::vector<int> ExtraNeighbors;
+	std::vector<int> LinkOffsets;
+	std::vector<int> LinkSpans;
+	std::vector<int> Components;
+	std::vector<int> ComponentSizes;
+	std::shared_ptr<const void> ExternalOwner;
+	const Span* SpanPtr = nullptr;
+	const int* OffsetPtr = nullptr;
+	const CompactSpanList* ListPtr = nullptr;
+	const int* ExtraNeighborOffsetPtr = nullptr;
+	const int* ExtraNeighborPtr = nullptr;
+	const int* LinkOffsetPtr = nullptr;
+	const int* LinkSpanPtr = nullptr;
+	float LinkClimbHeight = 0.0f;
+	const int* ComponentPtr = nullptr;
+	const int* ComponentSizePtr = nullptr;
+	int ComponentNum = 0;
+	int SpanNum = 0;
+	int ListNum = 0;
+};
 
 /*
 * 所有的数据所组成的结构，单例
 * Data：保存所有的数据
 * Dictionary：保存有每个球的起始index
 *			  eg：Dictionary[0] = [0,10000] 代码编号从0到10000的SpanList都属于球0
+* ReadOnly：数据由navBake::LoadNavBake加载时为true，此时Data为空，只能通过Compact读取
+*			SphereMgr::Build、体素化与Compaction都不会执行，Clear之后恢复为false
 */
 class SpanData
 {
@@ -64,7 +208,26 @@ public:
 		return Instance;
 	}
 	
+	/*
+	* 把Data转换为CSR格式保存到Compact中，体素化完成后调用，ReadOnly时不做任何事
+	* ReleaseSource：为true时释放Data中每个SpanList的Span和邻居数组，之后只能通过Compact访问
+	*/
+	void Compaction(bool ReleaseSource = false);
+	/*
+	* 在Compaction之后计算Span之间的连接与连通分量，寻路时直接读取连接，不再逐个比较邻居SpanList中Span的高度
+	*/
+	void BuildLinks(float ClimbHeight);
+	/*
+	* Data占用的内存（字节），不包括内存分配器自身的开销
+	*/
+	size_t GetMemorySize() const;
+	/*
+	* 清空所有球的数据，之前Build或加载的SphereMgr都不能再使用
+	*/
+	void Clear();
 public:
 	std::vector<SpanList> Data;
 	std::vector<std::pair<int, int>> Dictionary;
+	CompactSpanData Compact;
+	bool ReadOnly = false;
 };
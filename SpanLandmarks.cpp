@@ -0,0 +1,172 @@
+#include "SpanLandmarks.h"
+#include "SphereSegmentation.h"
+#include "SpanData.h"
+#include "TaskScheduler.h"
+#include <random>
+
+namespace
+{
+	/*
+	* 一个球的连接图，Span用 Span编号 - SpanBeginIndex 表示
+	* 反向图：ReverseLinks[ReverseBegin[v], ReverseBegin[v + 1])是连接到v的Span
+	*/
+	struct LinkGraph
+	{
+		const CompactSpanData& Compact;
+		int SpanBeginIndex;
+		int SpanNum;
+		std::vector<int> ReverseBegin;
+		std::vector<int> ReverseLinks;
+
+		LinkGraph(const CompactSpanData& c, int Begin, int Num)
+			:Compact(c), SpanBeginIndex(Begin), SpanNum(Num)
+		{
+			ReverseBegin.assign(SpanNum + 1, 0);
+			for (int v = 0; v < SpanNum; v++)
+			{
+				for (int k = Compact.GetLinkBegin(v + SpanBeginIndex); k < Compact.GetLinkEnd(v + SpanBeginIndex); k++)
+				{
+					ReverseBegin[Compact.GetLinkedSpan(k) - SpanBeginIndex + 1]++;
+				}
+			}
+			for (int v = 0; v < SpanNum; v++)
+			{
+				ReverseBegin[v + 1] += ReverseBegin[v];
+			}
+			ReverseLinks.resize(ReverseBegin[SpanNum]);
+			std::vector<int> Fill(ReverseBegin.begin(), ReverseBegin.end() - 1);
+			for (int v = 0; v < SpanNum; v++)
+			{
+				for (int k = Compact.GetLinkBegin(v + SpanBeginIndex); k < Compact.GetLinkEnd(v + SpanBeginIndex); k++)
+				{
+					ReverseLinks[Fill[Compact.GetLinkedSpan(k) - SpanBeginIndex]++] = v;
+				}
+			}
+		}
+
+		/*
+		* 从Source开始沿连接（Reverse时沿连接的反方向）广度优先搜索，步数写入Distance，超过Unreachable - 1的步数按Unreachable - 1计
+		*/
+		void Search(int Source, bool Reverse, std::vector<uint16_t>& Distance, std::vector<int>& Queue) const
+		{
+			Distance.assign(SpanNum, SpanLandmarks::Unreachable);
+			Queue.clear();
+			Distance[Source] = 0;
+			Queue.emplace_back(Source);
+			for (size_t Head = 0; Head < Queue.size(); Head++)
+			{
+				int v = Queue[Head];
+				uint16_t Next = uint16_t(std::min(Distance[v] + 1, SpanLandmarks::Unreachable - 1));
+				auto Visit = [&](int u)
+				{
+					if (Distance[u] == SpanLandmarks::Unreachable)
+					{
+						Distance[u] = Next;
+						Queue.emplace_back(u);
+					}
+				};
+				if (Reverse)
+				{
+					for (int k = ReverseBegin[v]; k < ReverseBegin[v + 1]; k++)
+					{
+						Visit(ReverseLinks[k]);
+					}
+					continue;
+				}
+				for (int k = Compact.GetLinkBegin(v + SpanBeginIndex); k < Compact.GetLinkEnd(v + SpanBeginIndex); k++)
+				{
+					Visit(Compact.GetLinkedSpan(k) - SpanBeginIndex);
+				}
+			}
+		}
+	};
+}
+
+SpanLandmarks::SpanLandmarks(const SphereMgr& Sphere, int LandmarkNum, int ThreadNum)
+{
+	auto&& instance = SpanData::getInstance();
+	auto&& Compact = instance.Compact;
+	SpanBeginIndex = Compact.GetListSpanBegin(instance.Dictionary[Sphere.SphereId].first);
+	SpanNum = Compact.GetListSpanEnd(instance.Dictionary[Sphere.SphereId].second) - SpanBeginIndex;
+	ClimbHeight = Compact.GetLinkClimbHeight();
+	if (!Compact.HasLinks() || SpanNum == 0 || LandmarkNum <= 0)
+	{
+		return;
+	}
+	LinkGraph Graph(Compact, SpanBeginIndex, SpanNum);
+
+	//随机起点取在本球最大的连通分量中，路标都在起点能走到的范围内
+	std::mt19937 Random(SpanNum);
+	int Start = int(Random() % SpanNum);
+	if (Compact.HasComponents())
+	{
+		int Largest = Compact.GetSpanComponent(Start + SpanBeginIndex);
+		for (int v = 0; v < SpanNum; v++)
+		{
+			Largest = std::min(Largest, Compact.GetSpanComponent(v + SpanBeginIndex));
+		}
+		while (Compact.GetSpanComponent(Start + SpanBeginIndex) != Largest)
+		{
+			Start = int(Random() % SpanNum);
+		}
+	}
+
+	//最远点采样：MinDistance是每个Span到已选路标的最小步数
+	std::vector<uint16_t> Distance;
+	std::vector<int> Queue;
+	std::vector<std::vector<uint16_t>> ForwardColumns;
+	std::vector<uint16_t> MinDistance;
+	Graph.Search(Start, false, Distance, Queue);
+	int Next = Queue.back();
+	for (int i = 0; i < LandmarkNum; i++)
+	{
+		LandmarkSpans.emplace_back(Next + SpanBeginIndex);
+		Graph.Search(Next, false, Distance, Queue);
+		if (i == 0)
+		{
+			MinDistance = Distance;
+		}
+		int Farthest = -1;
+		for (int v = 0; v < SpanNum; v++)
+		{
+			MinDistance[v] = std::min(MinDistance[v], Distance[v]);
+			if (MinDistance[v] != Unreachable && MinDistance[v] > 0 && (Farthest < 0 || MinDistance[v] > MinDistance[Farthest]))
+			{
+				Farthest = v;
+			}
+		}
+		ForwardColumns.emplace_back(std::move(Distance));
+		if (Farthest < 0)
+		{
+			//能走到的Span都已经是路标
+			break;
+		}
+		Next = Farthest;
+	}
+
+	int Num = GetLandmarkNum();
+	std::vector<std::vector<uint16_t>> BackwardColumns(Num);
+	WorkStealingScheduler Scheduler(ThreadNum);
+	std::vector<std::vector<int>> Queues(Scheduler.GetThreadNum());
+	Scheduler.ParallelFor(Num, [&](int i, int ThreadIndex)
+	{
+		Graph.Search(LandmarkSpans[i] - SpanBeginIndex, true, BackwardColumns[i], Queues[ThreadIndex]);
+	});
+
+	//按Span连续存放，查询时一个Span的所有路标在同一段内存中
+	Forward.resize(size_t(SpanNum) * Num);
+	Backward.resize(size_t(SpanNum) * Num);
+	for (int v = 0; v < SpanNum; v++)
+	{
+		for (int i = 0; i < Num; i++)
+		{
+			Forward[size_t(v) * Num + i] = ForwardColumns[i][v];
+			Backward[size_t(v) * Num + i] = BackwardColumns[i][v];
+		}
+	}
+}
+
+size_t SpanLandmarks::GetMemorySize() const
+{
+	return (Forward.capacity() + Backward.capacity()) * sizeof(uint16_t) + LandmarkSpans.capacity() * sizeof(int);
+}
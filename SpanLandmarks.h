@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+class SphereMgr;
+
+/*
+* ALT寻路的路标表：在一个球的Span连接图上选若干路标，保存每个Span与每个路标之间的步数
+* 连接不一定是双向的，所以分别保存路标到Span（Forward）与Span到路标（Backward）的步数
+* 由三角不等式，从v到t至少需要 max(Forward[t] - Forward[v], Backward[v] - Backward[t]) 步（对所有路标取最大值）
+* 路标用最远点采样选取：第一个路标是离随机起点最远的Span，之后每次取离已有路标最远的Span
+* 每个Span每个路标占4字节，LandmarkNum越大下界越准，内存与构造时间也越多
+* 构造前需要先调用SpanData::Compaction与SpanData::BuildLinks，数据改变后需要重新构造
+*/
+class SpanLandmarks
+{
+public:
+	static constexpr uint16_t Unreachable = 0xffff;
+	/*
+	* ThreadNum <= 0 时使用硬件线程数，各路标的反向搜索并行执行
+	*/
+	SpanLandmarks(const SphereMgr& Sphere, int LandmarkNum, int ThreadNum = 1);
+	int GetLandmarkNum() const { return int(LandmarkSpans.size()); }
+	int GetLandmarkSpan(int Landmark) const { return LandmarkSpans[Landmark]; }
+	int GetSpanBeginIndex() const { return SpanBeginIndex; }
+	int GetSpanNum() const { return SpanNum; }
+	/*
+	* 表是按哪个ClimbHeight的连接计算的
+	*/
+	float GetClimbHeight() const { return ClimbHeight; }
+	/*
+	* SpanIndex（Span编号）与各路标之间的步数，每个数组有GetLandmarkNum()个元素，到不了为Unreachable
+	*/
+	const uint16_t* GetForward(int SpanIndex) const { return Forward.data() + size_t(SpanIndex - SpanBeginIndex) * LandmarkSpans.size(); }
+	const uint16_t* GetBackward(int SpanIndex) const { return Backward.data() + size_t(SpanIndex - SpanBeginIndex) * LandmarkSpans.size(); }
+	/*
+	* 从FromSpan到ToSpan至少需要的步数
+	*/
+	int GetLowerBound(int FromSpan, int ToSpan) const { return GetLowerBound(GetForward(FromSpan), GetBackward(FromSpan), GetForward(ToSpan), GetBackward(ToSpan)); }
+	int GetLowerBound(const uint16_t* FromForward, const uint16_t* FromBackward, const uint16_t* ToForward, const uint16_t* ToBackward) const
+	{
+		int Bound = 0;
+		for (int i = 0; i < LandmarkSpans.size(); i++)
+		{
+			if (FromForward[i] != Unreachable && ToForward[i] != Unreachable)
+			{
+				Bound = std::max(Bound, int(ToForward[i]) - int(FromForward[i]));
+			}
+			if (FromBackward[i] != Unreachable && ToBackward[i] != Unreachable)
+			{
+				Bound = std::max(Bound, int(FromBackward[i]) - int(ToBackward[i]));
+			}
+		}
+		return Bound;
+	}
+	size_t GetMemorySize() const;
+private:
+	int SpanBeginIndex = 0;
+	int SpanNum = 0;
+	float ClimbHeight = 0.0f;
+	std::vector<int> LandmarkSpans;
+	std::vector<uint16_t> Forward;//Forward[Span * LandmarkNum + i]：第i个路标到Span的步数
+	std::vector<uint16_t> Backward;//Backward[Span * LandmarkNum + i]：Span到第i个路标的步数
+};
@@ -1,9 +1,106 @@
 #include "SphereSegmentation.h"
 #include "SpanData.h"
+#include "TaskScheduler.h"
 #include <algorithm>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPHERE_QUERY_SSE 1
+#include <emmintrin.h>
+#endif
 
-void SphereMgr::Build(glm::vec3& Center, float radius, int Size, float s, int SphereIndex)
+namespace
 {
+	const float QueryPi = float(M_PI);
+
+	/*
+	* Abramowitz & Stegun 4.4.46：acos(x)，0 <= x <= 1，误差不超过2e-8
+	*/
+	inline float AcosPolynomial(float x)
+	{
+		return ((((((-0.0012624911f * x + 0.0066700901f) * x - 0.0170881256f) * x + 0.0308918810f) * x - 0.0501743046f) * x + 0.0889789874f) * x - 0.2145988016f) * x + 1.5707963050f;
+	}
+
+	/*
+	* Abramowitz & Stegun 4.4.49：atan(x) / x，|x| <= 1，误差不超过2e-8
+	*/
+	inline float AtanPolynomial(float x2)
+	{
+		return (((((((-0.0040540580f * x2 + 0.0218612288f) * x2 - 0.0559098861f) * x2 + 0.0964200441f) * x2 - 0.1390853351f) * x2 + 0.1994653599f) * x2 - 0.3332985605f) * x2 + 0.9999993329f);
+	}
+
+	inline float FastAcos(float x)
+	{
+		float a = std::min(std::abs(x), 1.0f);
+		float r = AcosPolynomial(a) * std::sqrt(1.0f - a);
+		return x < 0 ? QueryPi - r : r;
+	}
+
+	/*
+	* atan2(z, x)，结果在[0, 2π)
+	*/
+	inline float FastAtan2Positive(float z, float x)
+	{
+		float ax = std::abs(x);
+		float az = std::abs(z);
+		float a = std::min(ax, az) / std::max(std::max(ax, az), 1e-30f);
+		float r = a * AtanPolynomial(a * a);
+		r = az > ax ? QueryPi * 0.5f - r : r;
+		r = x < 0 ? QueryPi - r : r;
+		return z < 0 ? QueryPi * 2.0f - r : r;
+	}
+
+#ifdef SPHERE_QUERY_SSE
+	inline __m128 Select(__m128 Mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(Mask, a), _mm_andnot_ps(Mask, b));
+	}
+
+	inline __m128 FastAcos4(__m128 x)
+	{
+		const __m128 SignMask = _mm_set1_ps(-0.0f);
+		__m128 a = _mm_min_ps(_mm_andnot_ps(SignMask, x), _mm_set1_ps(1.0f));
+		__m128 p = _mm_set1_ps(-0.0012624911f);
+		p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0066700901f));
+		p = _mm_sub_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0170881256f));
+		p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0308918810f));
+		p = _mm_sub_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0501743046f));
+		p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0889789874f));
+		p = _mm_sub_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.2145988016f));
+		p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(1.5707963050f));
+		__m128 r = _mm_mul_ps(p, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a)));
+		return Select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(QueryPi), r), r);
+	}
+
+	inline __m128 FastAtan2Positive4(__m128 z, __m128 x)
+	{
+		const __m128 SignMask = _mm_set1_ps(-0.0f);
+		__m128 ax = _mm_andnot_ps(SignMask, x);
+		__m128 az = _mm_andnot_ps(SignMask, z);
+		__m128 a = _mm_div_ps(_mm_min_ps(ax, az), _mm_max_ps(_mm_max_ps(ax, az), _mm_set1_ps(1e-30f)));
+		__m128 x2 = _mm_mul_ps(a, a);
+		__m128 p = _mm_set1_ps(-0.0040540580f);
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(0.0218612288f));
+		p = _mm_sub_ps(_mm_mul_ps(p, x2), _mm_set1_ps(0.0559098861f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(0.0964200441f));
+		p = _mm_sub_ps(_mm_mul_ps(p, x2), _mm_set1_ps(0.1390853351f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(0.1994653599f));
+		p = _mm_sub_ps(_mm_mul_ps(p, x2), _mm_set1_ps(0.3332985605f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(0.9999993329f));
+		__m128 r = _mm_mul_ps(a, p);
+		r = Select(_mm_cmpgt_ps(az, ax), _mm_sub_ps(_mm_set1_ps(QueryPi * 0.5f), r), r);
+		r = Select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(QueryPi), r), r);
+		return Select(_mm_cmplt_ps(z, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(QueryPi * 2.0f), r), r);
+	}
+#endif
+}
+
+void SphereMgr::Build(glm::vec3& Center, float radius, int Size, float s, int SphereIndex, int ThreadNum)
+{
+	//加载的烘焙数据只读，Data为空，新的SpanList会与Dictionary中已有的编号重叠
+	if (SpanData::getInstance().ReadOnly)
+	{
+		return;
+	}
 	this->CenterPos = Center;
 	this->Radius = radius;
 	this->TileSize = Size;
@@ -40,6 +137,8 @@ void SphereMgr::Build(glm::vec3& Center, float radius, int Size, float s, int Sp
 			}
 			t.CenterPos = m * glm::vec4(t.CenterPos, 1.0f);
 			t.TileIndex = total_tiles_num;
+			t.RowIndex = i;
+			t.ColIndex = 0;
 			total_tiles_num++;
 		}
 		else {
@@ -57,19 +156,78 @@ void SphereMgr::Build(glm::vec3& Center, float radius, int Size, float s, int Sp
 				t.axis_v = glm::normalize(glm::cross(t.CenterPos, t.axis_u));
 				t.CenterPos = m * glm::vec4(t.CenterPos, 1.0f);
 				t.TileIndex = total_tiles_num;
+				t.RowIndex = i;
+				t.ColIndex = j;
 				total_tiles_num++;
 			}
 		}
 	}
 
-	//初始化一个临时的SpanList数组
-	std::vector<SpanList> tempLists;
-	tempLists.reserve(total_tiles_num * TileSize * TileSize);
-	SpanData::getInstance().Dictionary.emplace_back(std::make_pair(SpanData::getInstance().Data.size(), SpanData::getInstance().Data.size() + total_tiles_num * TileSize * TileSize - 1));
-	for (auto&& i : Tiles)
+	//TileIndex是按行连续编号的，直接展开成一维数组
+	FlatTiles.clear();
+	FlatTiles.reserve(total_tiles_num);
+	RowBeginIndex.resize(Tiles.size() + 1);
+	for (int i = 0; i < Tiles.size(); i++)
 	{
-		for (auto&& j : i)
+		RowBeginIndex[i] = int(FlatTiles.size());
+		FlatTiles.insert(FlatTiles.end(), Tiles[i].begin(), Tiles[i].end());
+	}
+	RowBeginIndex[Tiles.size()] = int(FlatTiles.size());
+
+	BuildQueryBasis();
+
+	//SpanList在Tile中的索引为 x * TileSize + z，x沿axis_u（向东），z沿axis_v（向南），所以x方向的邻居索引相差TileSize，z方向相差1
+	//Tile内部的邻居直接加减索引；同一行的Tile首尾相接成一个环，东西方向跨Tile的邻居就是相邻Tile的另一边
+	//南北方向跨行时两行的Tile数不同，用每一行的接缝表：同一行的Tile只是绕y轴旋转，边上的SpanList移动一格后的纬度与经度偏移都一样
+	//两极只有一个Tile的行没有这种对称性，沿Tile的轴移动一格后按世界坐标查找
+	std::vector<std::vector<SeamTarget>> SeamTables(Tiles.size());
+	for (int i = 0; i < Tiles.size(); i++)
+	{
+		if (Tiles[i].size() > 1)
 		{
+			BuildSeamTable(i, SeamTables[i]);
+		}
+	}
+
+	//先把本球的SpanList全部分配好，各Tile的SpanList位置是固定的，按Tile分块并行填写
+	auto&& instance = SpanData::getInstance();
+	int ListBegin = int(instance.Data.size());
+	int ListNumPerTile = TileSize * TileSize;
+	instance.Dictionary.emplace_back(std::make_pair(ListBegin, ListBegin + total_tiles_num * ListNumPerTile - 1));
+	instance.Data.resize(size_t(ListBegin) + size_t(total_tiles_num) * ListNumPerTile);
+
+	const int TileNumPerTask = 64;
+	WorkStealingScheduler Scheduler(ThreadNum);
+	Scheduler.ParallelFor((total_tiles_num + TileNumPerTask - 1) / TileNumPerTask, [&](int TaskIndex, int)
+	{
+		int TileEnd = std::min(total_tiles_num, (TaskIndex + 1) * TileNumPerTask);
+		for (int TileIndex = TaskIndex * TileNumPerTask; TileIndex < TileEnd; TileIndex++)
+		{
+			const Tile& j = FlatTiles[TileIndex];
+			const std::vector<Tile>& i = Tiles[j.RowIndex];
+			const std::vector<SeamTarget>& Seams = SeamTables[j.RowIndex];
+			double TileLongitude = 2.0 * M_PI * j.ColIndex / double(i.size());
+			int RowTileNum = int(i.size());
+			int WestTileIndex = i[(j.ColIndex + RowTileNum - 1) % RowTileNum].TileIndex;
+			int EastTileIndex = i[(j.ColIndex + 1) % RowTileNum].TileIndex;
+			auto EdgeNeighbor = [&](const SpanList& List, edgeNeighborDirect e, int x, int z)
+			{
+				if (Seams.empty())
+				{
+					glm::vec3 Step = (e == NegX ? -j.axis_u : e == X ? j.axis_u : e == NegZ ? -j.axis_v : j.axis_v) * Stride;
+					glm::vec3 Pos = List.CenteralWorldPos + Step;
+					return getSpanListIndexFromWorldPos(Pos.x, Pos.y, Pos.z);
+				}
+				if (e == NegX)
+				{
+					return WestTileIndex * ListNumPerTile + (TileSize - 1) * TileSize + z;
+				}
+				if (e == X)
+				{
+					return EastTileIndex * ListNumPerTile + z;
+				}
+				return ResolveSeamTarget(Seams[(e - NegZ) * TileSize + x], TileLongitude);
+			};
 			glm::vec3 centerPoint = j.CenterPos;
 			glm::vec3 u = j.axis_u;
 			glm::vec3 v = j.axis_v;
@@ -83,49 +241,216 @@ void SphereMgr::Build(glm::vec3& Center, float radius, int Size, float s, int Sp
 				{
 					glm::vec3 ListMinPoint = MinP + (u * float(x) * Stride) + (v * float(z) * Stride);
 					glm::vec3 ListCenterPoint = ListMinPoint + (u * Stride / 2.0f) + v * float(Stride / 2.0f);
-					tempLists.emplace_back(ListCenterPoint, j.TileIndex, SphereIndex);
-
-					auto&& List = tempLists[tempLists.size() - 1];
-					int ListIndexNow = SpanData::getInstance().Data.size() + j.TileIndex*TileSize*TileSize + x*TileSize + z;
+					int ListIndexNow = ListBegin + j.TileIndex * ListNumPerTile + x * TileSize + z;
+					SpanList& List = instance.Data[ListIndexNow];
+					List.CenteralWorldPos = ListCenterPoint;
+					List.TileIndex = j.TileIndex;
+					List.SphereIndex = SphereIndex;
+					List.neighborsIndex.reserve(4);
 					if (x != 0)
 					{
-						List.neighborsIndex.emplace_back(ListIndexNow - 1);
+						List.neighborsIndex.emplace_back(ListIndexNow - TileSize);
 					}
 					else
 					{
-						List.neighborsIndex.emplace_back(offsetGetEdgeSpanListNeighborIndex(List, edgeNeighborDirect::NegX) + SpanData::getInstance().Data.size());
+						List.neighborsIndex.emplace_back(EdgeNeighbor(List, edgeNeighborDirect::NegX, x, z) + ListBegin);
 					}
 
 					if (x != TileSize - 1)
 					{
-						List.neighborsIndex.emplace_back(ListIndexNow + 1);
+						List.neighborsIndex.emplace_back(ListIndexNow + TileSize);
 					}
 					else
 					{
-						List.neighborsIndex.emplace_back(offsetGetEdgeSpanListNeighborIndex(List, edgeNeighborDirect::X) + SpanData::getInstance().Data.size());
+						List.neighborsIndex.emplace_back(EdgeNeighbor(List, edgeNeighborDirect::X, x, z) + ListBegin);
 					}
 					if (z != 0)
 					{
-						List.neighborsIndex.emplace_back(ListIndexNow - TileSize);
+						List.neighborsIndex.emplace_back(ListIndexNow - 1);
 					}
 					else
 					{
-						List.neighborsIndex.emplace_back(offsetGetEdgeSpanListNeighborIndex(List, edgeNeighborDirect::NegZ) + SpanData::getInstance().Data.size());
+						List.neighborsIndex.emplace_back(EdgeNeighbor(List, edgeNeighborDirect::NegZ, x, z) + ListBegin);
 					}
 					if (z != TileSize - 1)
 					{
-						List.neighborsIndex.emplace_back(ListIndexNow + TileSize);
+						List.neighborsIndex.emplace_back(ListIndexNow + 1);
 					}
 					else
 					{
-						List.neighborsIndex.emplace_back(offsetGetEdgeSpanListNeighborIndex(List, edgeNeighborDirect::Z) + SpanData::getInstance().Data.size());
+						List.neighborsIndex.emplace_back(EdgeNeighbor(List, edgeNeighborDirect::Z, x, z) + ListBegin);
 					}
 				}
 			}
 		}
+	});
+
+	//跨行与两极的邻居是按位置找最近的SpanList，两行的SpanList数不同，不能一一对应
+	//B是A的邻居而A不是B的邻居时，把A加到B的四个方向之后作为额外的邻居，使邻居关系对称；按SpanList的顺序单线程添加，结果与线程数无关
+	int ListEnd = ListBegin + total_tiles_num * ListNumPerTile;
+	for (int a = ListBegin; a < ListEnd; a++)
+	{
+		for (int d = 0; d < 4; d++)
+		{
+			int b = instance.Data[a].neighborsIndex[d];
+			if (b < ListBegin || b >= ListEnd || b == a)
+			{
+				continue;
+			}
+			std::vector<int>& Back = instance.Data[b].neighborsIndex;
+			if (std::find(Back.begin(), Back.end(), a) == Back.end())
+			{
+				Back.emplace_back(a);
+			}
+		}
 	}
-	SpanData::getInstance().Data.insert(SpanData::getInstance().Data.end(), tempLists.begin(), tempLists.end());
-	std::vector<SpanList>().swap(tempLists);
+}
+
+void SphereMgr::BuildSeamTable(int Row, std::vector<SeamTarget>& Table) const
+{
+	//在经度为0的Tile上计算，与Build中Tile和SpanList的位置计算方式相同
+	int N = int(Tiles.size()) - 1;
+	double RowRadians = (-90.0 + Row * (180.0 / N)) / 180.0 * M_PI;
+	double y = sin(RowRadians);
+	double r = cos(RowRadians);
+	double Center[3] = { r, y, 0 };
+	double u[3] = { 0, 0, 1 };
+	double v[3] = { y, -r, 0 };
+	double HalfTile = TileSize / 2.0;
+	double CellRadians = Stride / Radius;
+	double LatitudeStride = M_PI / (double(N) * TileSize);
+
+	Table.resize(2 * TileSize);
+	for (int e = NegZ; e <= Z; e++)
+	{
+		for (int x = 0; x < TileSize; x++)
+		{
+			int z = e == NegZ ? 0 : TileSize - 1;
+			double a = (x + 0.5 - HalfTile) * CellRadians;
+			double b = (z + 0.5 - HalfTile) * CellRadians;
+			double p[3];
+			for (int c = 0; c < 3; c++)
+			{
+				p[c] = Center[c] + u[c] * a + v[c] * b;
+			}
+
+			//沿经线转一格，NegZ向北，Z向南，越过极点时经度会转半圈
+			double Horizontal = sqrt(p[0] * p[0] + p[2] * p[2]);
+			double Latitude = atan2(p[1], Horizontal) + (e == NegZ ? LatitudeStride : -LatitudeStride);
+			double Longitude = atan2(p[2], p[0]);
+			double d[3] = { cos(Latitude) * cos(Longitude), sin(Latitude), cos(Latitude) * sin(Longitude) };
+
+			SeamTarget& Target = Table[(e - NegZ) * TileSize + x];
+			Target.SinLatitude = d[1];
+			Target.CosLatitude = sqrt(d[0] * d[0] + d[2] * d[2]);
+			Target.Longitude = atan2(d[2], d[0]);
+			Target.Row = GetNearestRow(Target.SinLatitude);
+			for (int c = 0; c < 3; c++)
+			{
+				Target.Direction[c] = d[c];
+			}
+		}
+	}
+}
+
+int SphereMgr::ResolveSeamTarget(const SeamTarget& Target, double TileLongitude)
+{
+	const std::vector<Tile>& Row = Tiles[Target.Row];
+	if (Row.size() == 1)
+	{
+		//落在两极的Tile上，转到实际的经度后按世界坐标查找
+		double c = cos(TileLongitude);
+		double s = sin(TileLongitude);
+		glm::vec3 Pos(float(Target.Direction[0] * c - Target.Direction[2] * s), float(Target.Direction[1]), float(Target.Direction[0] * s + Target.Direction[2] * c));
+		Pos = CenterPos + Pos * Radius;
+		return getSpanListIndexFromWorldPos(Pos.x, Pos.y, Pos.z);
+	}
+
+	//最近的Tile，与get2TileIndexFromWorldPos相同按经度四舍五入
+	double ColumnStride = 2.0 * M_PI / double(Row.size());
+	double Longitude = TileLongitude + Target.Longitude;
+	int Column = int(floor(Longitude / ColumnStride + 0.5));
+	double Offset = Longitude - Column * ColumnStride;
+	Column = ((Column % int(Row.size())) + int(Row.size())) % int(Row.size());
+	const Tile& t = Row[Column];
+
+	//投影到Tile的u，v轴上，u指向东，v指向南
+	double RowRadians = (-90.0 + Target.Row * (180.0 / double(Tiles.size() - 1))) / 180.0 * M_PI;
+	double uDistance = Target.CosLatitude * sin(Offset);
+	double vDistance = sin(RowRadians) * Target.CosLatitude * cos(Offset) - cos(RowRadians) * Target.SinLatitude;
+	int xIndex = int(floor(uDistance * Radius / Stride + TileSize / 2.0));
+	int zIndex = int(floor(vDistance * Radius / Stride + TileSize / 2.0));
+	xIndex = std::clamp(xIndex, 0, TileSize - 1);
+	zIndex = std::clamp(zIndex, 0, TileSize - 1);
+	return t.TileIndex * TileSize * TileSize + xIndex * TileSize + zIndex;
+}
+
+int SphereMgr::GetNearestRow(double SinLatitude) const
+{
+	int N = int(Tiles.size()) - 1;
+	double Angle = asin(std::clamp(SinLatitude, -1.0, 1.0)) + M_PI / 2.0;
+	return std::clamp(int(floor(Angle / (M_PI / N) + 0.5)), 0, N);
+}
+
+NeighborSymmetryReport SphereMgr::CheckNeighborSymmetry() const
+{
+	NeighborSymmetryReport Report;
+	auto&& instance = SpanData::getInstance();
+	if (SphereId >= instance.Dictionary.size())
+	{
+		return Report;
+	}
+	int First = instance.Dictionary[SphereId].first;
+	int Last = instance.Dictionary[SphereId].second;
+	if (Last >= int(instance.Data.size()))
+	{
+		return Report;
+	}
+	for (int i = First; i <= Last; i++)
+	{
+		Report.ListNum++;
+		for (int Neighbor : instance.Data[i].neighborsIndex)
+		{
+			Report.EdgeNum++;
+			if (Neighbor < First || Neighbor > Last)
+			{
+				Report.InvalidNum++;
+				continue;
+			}
+			if (Neighbor == i)
+			{
+				Report.SelfNum++;
+				continue;
+			}
+			auto&& Back = instance.Data[Neighbor].neighborsIndex;
+			if (std::find(Back.begin(), Back.end(), i) == Back.end())
+			{
+				Report.AsymmetricNum++;
+			}
+		}
+	}
+	return Report;
+}
+
+void SphereMgr::Restore(const glm::vec3& Center, float radius, int Size, float s, int SphereIndex, std::vector<Tile>&& Flat, std::vector<int>&& RowBegin)
+{
+	this->CenterPos = Center;
+	this->Radius = radius;
+	this->TileSize = Size;
+	this->Stride = s;
+	this->SphereId = SphereIndex;
+	unitRadianSize = float(M_PI) / (float(M_PI) * Radius / (Stride * TileSize));
+
+	FlatTiles = std::move(Flat);
+	RowBeginIndex = std::move(RowBegin);
+	total_tiles_num = int(FlatTiles.size());
+	Tiles.clear();
+	Tiles.resize(RowBeginIndex.size() - 1);
+	for (int i = 0; i < Tiles.size(); i++)
+	{
+		Tiles[i].assign(FlatTiles.begin() + RowBeginIndex[i], FlatTiles.begin() + RowBeginIndex[i + 1]);
+	}
+	BuildQueryBasis();
 }
 
 int SphereMgr::getTileIndexFromWorldPos(float x, float y, float z)
@@ -192,22 +517,114 @@ int SphereMgr::getSpanListIndexFromWorldPos(float x, float y, float z)
 	return tile.TileIndex*TileSize*TileSize + xIndex * TileSize + zIndex;
 }
 
-const Tile& SphereMgr::GetTileByIndex(int index)
+void SphereMgr::BuildQueryBasis()
 {
-	int RowbeginIndex = 0;
+	QueryBasis.resize(FlatTiles.size());
+	for (int i = 0; i < FlatTiles.size(); i++)
+	{
+		const Tile& t = FlatTiles[i];
+		//与getSpanListIndexFromWorldPos相同，左下角相对于Tile中心的位置投影到u，v轴上
+		glm::vec3 toMin = (-t.axis_u * Stride * float(TileSize) / 2.0f) + (-t.axis_v * Stride * float(TileSize) / 2.0f);
+		TileQueryBasis& b = QueryBasis[i];
+		b.u[0] = t.axis_u.x;
+		b.u[1] = t.axis_u.y;
+		b.u[2] = t.axis_u.z;
+		b.MinU = glm::dot(t.axis_u, toMin);
+		b.v[0] = t.axis_v.x;
+		b.v[1] = t.axis_v.y;
+		b.v[2] = t.axis_v.z;
+		b.MinV = glm::dot(t.axis_v, toMin);
+	}
+}
 
-	for (int longitudeIndex = Tiles.size() - 1; longitudeIndex >= 0; longitudeIndex--)
+int SphereMgr::GetQueryTileIndex(int Row, float Longitude) const
+{
+	int N = int(RowBeginIndex.size()) - 2;
+	Row = std::clamp(Row, 0, N);
+	int RowTileNum = RowBeginIndex[Row + 1] - RowBeginIndex[Row];
+	if (Row == 0 || Row == N || RowTileNum == 1)
 	{
-		if (Tiles[longitudeIndex][0].TileIndex <= index)
+		return RowBeginIndex[Row];
+	}
+	int Col = int(Longitude * (float(RowTileNum) / (2.0f * QueryPi)) + 0.5f);
+	return RowBeginIndex[Row] + (Col >= RowTileNum ? 0 : Col);
+}
+
+int SphereMgr::QuerySpanListIndex(float x, float y, float z) const
+{
+	x -= CenterPos.x;
+	y -= CenterPos.y;
+	z -= CenterPos.z;
+	float InvLength = 1.0f / std::sqrt(x * x + y * y + z * z);
+	float InvRowStride = float(RowBeginIndex.size() - 2) / QueryPi;
+	//与南极方向的夹角决定行号
+	int Row = int(FastAcos(-y * InvLength) * InvRowStride + 0.5f);
+	int TileIndex = GetQueryTileIndex(Row, FastAtan2Positive(z, x));
+
+	const TileQueryBasis& b = QueryBasis[TileIndex];
+	float Scale = InvLength * Radius;
+	float pu = (b.u[0] * x + b.u[1] * y + b.u[2] * z) * Scale;
+	float pv = (b.v[0] * x + b.v[1] * y + b.v[2] * z) * Scale;
+	float MaxIndex = float(TileSize - 1);
+	int xIndex = int(std::clamp((pu - b.MinU) / Stride, 0.0f, MaxIndex));
+	int zIndex = int(std::clamp((pv - b.MinV) / Stride, 0.0f, MaxIndex));
+	return TileIndex * TileSize * TileSize + xIndex * TileSize + zIndex;
+}
+
+void SphereMgr::getSpanListIndicesFromWorldPos(const glm::vec3* Positions, int Num, int* OutIndices) const
+{
+	int i = 0;
+#ifdef SPHERE_QUERY_SSE
+	const __m128 Center[3] = { _mm_set1_ps(CenterPos.x), _mm_set1_ps(CenterPos.y), _mm_set1_ps(CenterPos.z) };
+	const __m128 InvRowStride = _mm_set1_ps(float(RowBeginIndex.size() - 2) / QueryPi);
+	const __m128 Half = _mm_set1_ps(0.5f);
+	const __m128 MaxIndex = _mm_set1_ps(float(TileSize - 1));
+	const __m128 StrideVec = _mm_set1_ps(Stride);
+	for (; i + 4 <= Num; i += 4)
+	{
+		const glm::vec3* p = Positions + i;
+		__m128 x = _mm_sub_ps(_mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x), Center[0]);
+		__m128 y = _mm_sub_ps(_mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y), Center[1]);
+		__m128 z = _mm_sub_ps(_mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z), Center[2]);
+		__m128 InvLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+		__m128 SouthAngle = FastAcos4(_mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), y), InvLength));
+		alignas(16) int Rows[4];
+		alignas(16) float Longitudes[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(Rows), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(SouthAngle, InvRowStride), Half)));
+		_mm_store_ps(Longitudes, FastAtan2Positive4(z, x));
+
+		//每个点所在的Tile不同，取出各自的轴再转置成按分量排列
+		int TileIndices[4];
+		__m128 Bu[4], Bv[4];
+		for (int k = 0; k < 4; k++)
 		{
-			for (int i = 0; i < Tiles[longitudeIndex].size(); i++)
-			{
-				if (Tiles[longitudeIndex][i].TileIndex == index)
-					return Tiles[longitudeIndex][i];
-			}
+			TileIndices[k] = GetQueryTileIndex(Rows[k], Longitudes[k]);
+			const TileQueryBasis& b = QueryBasis[TileIndices[k]];
+			Bu[k] = _mm_loadu_ps(b.u);
+			Bv[k] = _mm_loadu_ps(b.v);
+		}
+		_MM_TRANSPOSE4_PS(Bu[0], Bu[1], Bu[2], Bu[3]);
+		_MM_TRANSPOSE4_PS(Bv[0], Bv[1], Bv[2], Bv[3]);
+
+		__m128 Scale = _mm_mul_ps(InvLength, _mm_set1_ps(Radius));
+		__m128 pu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Bu[0], x), _mm_mul_ps(Bu[1], y)), _mm_mul_ps(Bu[2], z)), Scale);
+		__m128 pv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Bv[0], x), _mm_mul_ps(Bv[1], y)), _mm_mul_ps(Bv[2], z)), Scale);
+		__m128 fx = _mm_min_ps(_mm_max_ps(_mm_div_ps(_mm_sub_ps(pu, Bu[3]), StrideVec), _mm_setzero_ps()), MaxIndex);
+		__m128 fz = _mm_min_ps(_mm_max_ps(_mm_div_ps(_mm_sub_ps(pv, Bv[3]), StrideVec), _mm_setzero_ps()), MaxIndex);
+		alignas(16) int xIndex[4];
+		alignas(16) int zIndex[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(xIndex), _mm_cvttps_epi32(fx));
+		_mm_store_si128(reinterpret_cast<__m128i*>(zIndex), _mm_cvttps_epi32(fz));
+		for (int k = 0; k < 4; k++)
+		{
+			OutIndices[i + k] = TileIndices[k] * TileSize * TileSize + xIndex[k] * TileSize + zIndex[k];
 		}
 	}
-	return Tiles[0][0];
+#endif
+	for (; i < Num; i++)
+	{
+		OutIndices[i] = QuerySpanListIndex(Positions[i].x, Positions[i].y, Positions[i].z);
+	}
 }
 
 int SphereMgr::getLongitudeIndex(float x, float y, float z)
@@ -239,47 +656,3 @@ int SphereMgr::getLongitudeIndex(float x, float y, float z)
 
 	return longitudeIndex;
 }
-
-int SphereMgr::offsetGetEdgeSpanListNeighborIndex(const SpanList& sl, edgeNeighborDirect e)
-{
-	glm::vec3 Center = sl.CenteralWorldPos;
-	glm::mat4 rotate(1.0f);
-	if (e == edgeNeighborDirect::NegX)
-	{
-
-		int longitudeIndex = getLongitudeIndex(Center.x, Center.y, Center.z);
-		float HorizontalRadiansStride = 360.0f / float(Tiles[longitudeIndex].size() * TileSize) / 180 * float(M_PI);
-		rotate = glm::rotate(rotate, HorizontalRadiansStride, glm::vec3(0, 1, 0));
-		glm::vec3 pos = rotate * glm::vec4(Center, 1.0f);
-		return getSpanListIndexFromWorldPos(pos.x, pos.y, pos.z);
-	}
-
-	if (e == edgeNeighborDirect::X)
-	{
-		int longitudeIndex = getLongitudeIndex(Center.x, Center.y, Center.z);
-		float HorizontalRadiansStride = 360.0f / float(Tiles[longitudeIndex].size() * TileSize) / 180 * float(M_PI);
-		rotate = glm::rotate(rotate, HorizontalRadiansStride, glm::vec3(0, -1, 0));
-		glm::vec3 pos = rotate * glm::vec4(Center, 1.0f);
-		return getSpanListIndexFromWorldPos(pos.x, pos.y, pos.z);
-	}
-
-
-	if (e == edgeNeighborDirect::NegZ)
-	{
-		float LongitudeAngleStride = float(M_PI) / (float(Tiles.size() - 1) * float(TileSize));
-		glm::vec3 rotateAxis = glm::normalize(glm::cross((Center - CenterPos), glm::vec3(0, 1, 0)));
-		rotate = glm::rotate(rotate, LongitudeAngleStride, rotateAxis);
-		glm::vec3 pos = rotate * glm::vec4(Center, 1.0f);
-		return getSpanListIndexFromWorldPos(pos.x, pos.y, pos.z);
-	}
-
-	if (e == edgeNeighborDirect::Z)
-	{
-
-		float LongitudeAngleStride = float(M_PI) / (float(Tiles.size() - 1) * float(TileSize));
-		glm::vec3 rotateAxis = glm::normalize(glm::cross((Center - CenterPos), glm::vec3(0, -1, 0)));
-		rotate = glm::rotate(rotate, LongitudeAngleStride, rotateAxis);
-		glm::vec3 pos = rotate * glm::vec4(Center, 1.0f);
-		return getSpanListIndexFromWorldPos(pos.x, pos.y, pos.z);
-	}
-}
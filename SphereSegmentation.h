@@ -1,6 +1,7 @@
 #pragma once
 #include<vector>
 #include <functional>
+#include <tuple>
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
@@ -31,6 +32,24 @@ public:
 	//两个基向量
 
 	int TileIndex; //在本球中，这个Tile是第几个
+
+	int RowIndex; //在Tiles二维数组中的行号（纬度）
+
+	int ColIndex; //在Tiles二维数组中的列号
+};
+
+/*
+* CheckNeighborSymmetry的结果
+* EdgeNum：检查的邻居边数，AsymmetricNum：A的邻居是B但B的邻居中没有A的边数
+* SelfNum：邻居是自己的边数，InvalidNum：邻居索引不在本球范围内的边数
+*/
+struct NeighborSymmetryReport
+{
+	int ListNum = 0;
+	int EdgeNum = 0;
+	int AsymmetricNum = 0;
+	int SelfNum = 0;
+	int InvalidNum = 0;
 };
 
 class SphereMgr
@@ -39,6 +58,8 @@ public:
 	glm::vec3 CenterPos = { 0,0,0 };
 	float Radius = 0.0f;
 	std::vector<std::vector<Tile>>Tiles;
+	std::vector<Tile> FlatTiles;//按TileIndex连续存放的所有Tile，FlatTiles[i].TileIndex == i
+	std::vector<int> RowBeginIndex;//每一行第一个Tile的TileIndex，多存一个结尾，大小为Tiles.size() + 1
 	int total_tiles_num = 0;
 	int TileSize = 0;
 	float Stride = 0.0f;//每个SpanList的边长；
@@ -46,8 +67,14 @@ public:
 public:
 	/*
 	* 初始化一个球，生成Tile盒SpanList，并将空的SpanList数据加入SpanData单例中
+	* ThreadNum：填写SpanList使用的线程数，<= 0 时使用硬件线程数，结果与线程数无关
+	* SpanData::ReadOnly（加载了烘焙文件）时不做任何事，需要先调用SpanData::Clear
 	*/
-	void Build(glm::vec3& Center, float radius, int Size, float Stride,int SphereIndex);
+	void Build(glm::vec3& Center, float radius, int Size, float Stride, int SphereIndex, int ThreadNum = 1);
+	/*
+	* 用烘焙文件中保存的Tile恢复一个球，不会向SpanData中添加SpanList
+	*/
+	void Restore(const glm::vec3& Center, float radius, int Size, float Stride, int SphereIndex, std::vector<Tile>&& Flat, std::vector<int>&& RowBegin);
 	/*
 	* 给予世界空间下的x,y,z点，获取Tile的索引(本球中)
 	*/
@@ -57,12 +84,67 @@ public:
 	*/
 	std::tuple<int,int> get2TileIndexFromWorldPos(float x, float y, float z);
 	int getSpanListIndexFromWorldPos(float x, float y, float z);
-	const Tile& GetTileByIndex(int index);
+	/*
+	* 批量查询Positions所在的SpanList（本球中的索引），写入OutIndices
+	* 规则与getSpanListIndexFromWorldPos相同，acos与atan2换成多项式近似（误差不超过2e-8弧度），Tile的轴预先算好，有SSE时一次处理4个点
+	* 只有离Tile或SpanList边界非常近（约1e-6弧度以内）的点可能分到相邻的一格
+	*/
+	void getSpanListIndicesFromWorldPos(const glm::vec3* Positions, int Num, int* OutIndices) const;
+	const Tile& GetTileByIndex(int index) const { return FlatTiles[index]; }
+	/*
+	* Tiles[row][col] 与 TileIndex 之间的转换，都是常数时间
+	*/
+	int GetTileIndex(int row, int col) const { return RowBeginIndex[row] + col; }
+	std::tuple<int, int> GetTileRowCol(int index) const { return std::make_tuple(FlatTiles[index].RowIndex, FlatTiles[index].ColIndex); }
+	/*
+	* 检查SpanData::Data中本球的邻居关系是否对称，需要在Compaction之前调用
+	* Build会为跨行不能一一对应的邻居补上反向的额外邻居，AsymmetricNum应当为0
+	*/
+	NeighborSymmetryReport CheckNeighborSymmetry() const;
+private:
+	/*
+	* Tile南北两边上的SpanList沿经线向外移动一格后的位置，只与行号、方向和在边上的位置有关
+	* Row：移动后所在的行，Longitude：相对于所在Tile经度的偏移
+	* SinLatitude，CosLatitude：移动后的纬度，Direction：所在Tile经度为0时移动后的方向，落在两极的Tile时使用
+	*/
+	struct SeamTarget
+	{
+		int Row;
+		double Longitude;
+		double SinLatitude;
+		double CosLatitude;
+		double Direction[3];
+	};
+	/*
+	* 计算一行的接缝表，按 (方向 - NegZ) * TileSize + x 索引
+	*/
+	void BuildSeamTable(int Row, std::vector<SeamTarget>& Table) const;
+	/*
+	* 经度为TileLongitude的Tile上，按接缝表移动后所在的SpanList（本球中的索引）
+	*/
+	int ResolveSeamTarget(const SeamTarget& Target, double TileLongitude);
+	int GetNearestRow(double SinLatitude) const;
+	/*
+	* 批量查询用的Tile数据：u，v轴与左下角在u，v轴上的坐标，按TileIndex索引
+	*/
+	struct TileQueryBasis
+	{
+		float u[3];
+		float MinU;
+		float v[3];
+		float MinV;
+	};
+	void BuildQueryBasis();
+	/*
+	* 已知行号与经度（[0, 2π)）时选出Tile
+	*/
+	int GetQueryTileIndex(int Row, float Longitude) const;
+	int QuerySpanListIndex(float x, float y, float z) const;
 private:
+	std::vector<TileQueryBasis> QueryBasis;
 	float unitRadianSize = 0.05f;
 private:
 	int getLongitudeIndex(float x, float y,float z);
-	int offsetGetEdgeSpanListNeighborIndex(const struct SpanList& sl, edgeNeighborDirect);
 };
 
 
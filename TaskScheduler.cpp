@@ -0,0 +1,105 @@
+#include "TaskScheduler.h"
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+
+WorkStealingScheduler::WorkStealingScheduler(int Num)
+	:ThreadNum(ResolveThreadNum(Num))
+{
+	Queues.reserve(ThreadNum);
+	for (int i = 0; i < ThreadNum; i++)
+	{
+		Queues.emplace_back(std::make_unique<TaskQueue>());
+	}
+}
+
+int WorkStealingScheduler::ResolveThreadNum(int Num)
+{
+	if (Num > 0)
+	{
+		return Num;
+	}
+	int HardwareNum = int(std::thread::hardware_concurrency());
+	return std::max(HardwareNum, 1);
+}
+
+void WorkStealingScheduler::ParallelFor(int TaskNum, const std::function<void(int, int)>& Func)
+{
+	if (TaskNum <= 0)
+	{
+		return;
+	}
+	int WorkerNum = std::min(ThreadNum, TaskNum);
+	if (WorkerNum == 1)
+	{
+		for (int i = 0; i < TaskNum; i++)
+		{
+			Func(i, 0);
+		}
+		return;
+	}
+
+	//按连续块分配，相邻的任务尽量由同一个线程执行
+	for (int t = 0; t < WorkerNum; t++)
+	{
+		int Begin = int(int64_t(TaskNum) * t / WorkerNum);
+		int End = int(int64_t(TaskNum) * (t + 1) / WorkerNum);
+		std::lock_guard<std::mutex> Guard(Queues[t]->Lock);
+		Queues[t]->Tasks.clear();
+		for (int i = Begin; i < End; i++)
+		{
+			Queues[t]->Tasks.push_back(i);
+		}
+	}
+
+	std::vector<std::thread> Workers;
+	Workers.reserve(WorkerNum - 1);
+	for (int t = 1; t < WorkerNum; t++)
+	{
+		Workers.emplace_back(&WorkStealingScheduler::WorkerLoop, this, t, std::cref(Func));
+	}
+	WorkerLoop(0, Func);
+	for (auto&& w : Workers)
+	{
+		w.join();
+	}
+}
+
+void WorkStealingScheduler::WorkerLoop(int ThreadIndex, const std::function<void(int, int)>& Func)
+{
+	int TaskIndex = 0;
+	while (PopTask(ThreadIndex, TaskIndex) || StealTask(ThreadIndex, TaskIndex))
+	{
+		Func(TaskIndex, ThreadIndex);
+	}
+}
+
+bool WorkStealingScheduler::PopTask(int ThreadIndex, int& TaskIndex)
+{
+	TaskQueue& Queue = *Queues[ThreadIndex];
+	std::lock_guard<std::mutex> Guard(Queue.Lock);
+	if (Queue.Tasks.empty())
+	{
+		return false;
+	}
+	TaskIndex = Queue.Tasks.front();
+	Queue.Tasks.pop_front();
+	return true;
+}
+
+bool WorkStealingScheduler::StealTask(int ThreadIndex, int& TaskIndex)
+{
+	//任务只会减少不会增加，所以一轮找不到就说明全部任务都已经被领走了
+	for (int i = 1; i < ThreadNum; i++)
+	{
+		TaskQueue& Victim = *Queues[(ThreadIndex + i) % ThreadNum];
+		std::lock_guard<std::mutex> Guard(Victim.Lock);
+		if (!Victim.Tasks.empty())
+		{
+			TaskIndex = Victim.Tasks.back();
+			Victim.Tasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <functional>
+
+/*
+* 工作窃取的任务调度器
+* 任务用 [0, TaskNum) 的整数编号表示，开始时按连续的块平均分给每个线程的队列
+* 线程从自己队列的头部取任务，自己的队列空了以后从其它线程队列的尾部窃取
+* 不同编号的任务之间不能有数据竞争，由调用者保证
+*/
+class WorkStealingScheduler
+{
+public:
+	/*
+	* ThreadNum <= 0 时使用硬件线程数
+	*/
+	explicit WorkStealingScheduler(int ThreadNum);
+	/*
+	* 执行全部任务，Func(TaskIndex, ThreadIndex)，调用线程作为0号线程参与执行，返回时所有任务都已完成
+	*/
+	void ParallelFor(int TaskNum, const std::function<void(int, int)>& Func);
+	int GetThreadNum() const { return ThreadNum; }
+	/*
+	* 把配置的线程数转换为实际使用的线程数
+	*/
+	static int ResolveThreadNum(int ThreadNum);
+private:
+	struct TaskQueue
+	{
+		std::mutex Lock;
+		std::deque<int> Tasks;
+	};
+	bool PopTask(int ThreadIndex, int& TaskIndex);
+	bool StealTask(int ThreadIndex, int& TaskIndex);
+	void WorkerLoop(int ThreadIndex, const std::function<void(int, int)>& Func);
+private:
+	int ThreadNum = 1;
+	std::vector<std::unique_ptr<TaskQueue>> Queues;
+};
@@ -0,0 +1,95 @@
+#include "VertexCache.h"
+#include "VertexTransform.h"
+#include "SceneMgr.h"
+
+WorldVertexCache::VertexBuffer WorldVertexCache::Get(int ObjectIndex, const MeshObject& Object, const MeshData& Mesh)
+{
+	{
+		std::lock_guard<std::mutex> Guard(Lock);
+		if (Budget == 0)
+		{
+			return nullptr;
+		}
+		auto it = Entries.find(ObjectIndex);
+		if (it != Entries.end())
+		{
+			HitNum++;
+			LRU.splice(LRU.begin(), LRU, it->second.LRUIterator);
+			return it->second.Vertices;
+		}
+		MissNum++;
+	}
+
+	//在锁外计算，两个线程同时计算同一个模型时只保留先放入的
+	glm::mat4 m = glm::translate(glm::mat4(1.0f), Object.WorldPos) * glm::toMat4(Object.rotation) * glm::scale(glm::mat4(1.0f), Object.scale);
+	auto Vertices = std::make_shared<std::vector<float>>(Mesh.worldVertices.size() * 3);
+	if (!Mesh.worldVertices.empty())
+	{
+		vertexTransform::TransformPoints(m, &Mesh.worldVertices[0].x, int(Mesh.worldVertices.size()), Vertices->data());
+	}
+	size_t Size = Vertices->size() * sizeof(float);
+
+	std::lock_guard<std::mutex> Guard(Lock);
+	if (Size > Budget)
+	{
+		return Vertices;
+	}
+	auto&& Result = Entries.emplace(ObjectIndex, Entry());
+	if (!Result.second)
+	{
+		LRU.splice(LRU.begin(), LRU, Result.first->second.LRUIterator);
+		return Result.first->second.Vertices;
+	}
+	LRU.emplace_front(ObjectIndex);
+	Result.first->second.Vertices = Vertices;
+	Result.first->second.LRUIterator = LRU.begin();
+	MemorySize += Size;
+	EvictToBudget();
+	return Vertices;
+}
+
+void WorldVertexCache::SetBudget(size_t BudgetBytes)
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	Budget = BudgetBytes;
+	EvictToBudget();
+}
+
+size_t WorldVertexCache::GetMemorySize() const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	return MemorySize;
+}
+
+size_t WorldVertexCache::GetHitNum() const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	return HitNum;
+}
+
+size_t WorldVertexCache::GetMissNum() const
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	return MissNum;
+}
+
+void WorldVertexCache::Clear()
+{
+	std::lock_guard<std::mutex> Guard(Lock);
+	Entries.clear();
+	LRU.clear();
+	MemorySize = 0;
+	HitNum = 0;
+	MissNum = 0;
+}
+
+void WorldVertexCache::EvictToBudget()
+{
+	while (MemorySize > Budget && !LRU.empty())
+	{
+		auto it = Entries.find(LRU.back());
+		MemorySize -= it->second.Vertices->size() * sizeof(float);
+		Entries.erase(it);
+		LRU.pop_back();
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstddef>
+
+struct MeshObject;
+struct MeshData;
+
+/*
+* MeshObject世界坐标顶点的缓存，体素化时一个模型跨越多个Tile，每个Tile只需要再做一次世界坐标到Tile坐标的变换
+* 按MeshObject的下标缓存，总大小超过Budget时淘汰最久没有使用的；Budget为0时不缓存
+* Get可以在多个线程中同时调用，返回的顶点被淘汰后仍然有效，直到最后一个shared_ptr释放
+* MeshObjects改变后需要调用Clear
+*/
+class WorldVertexCache
+{
+public:
+	using VertexBuffer = std::shared_ptr<const std::vector<float>>;
+	/*
+	* 返回Object的世界坐标顶点（连续的xyz），不在缓存中时计算并加入缓存
+	* Budget为0时返回空指针
+	*/
+	VertexBuffer Get(int ObjectIndex, const MeshObject& Object, const MeshData& Mesh);
+	void SetBudget(size_t BudgetBytes);
+	size_t GetBudget() const { return Budget; }
+	size_t GetMemorySize() const;
+	size_t GetHitNum() const;
+	size_t GetMissNum() const;
+	void Clear();
+private:
+	struct Entry
+	{
+		VertexBuffer Vertices;
+		std::list<int>::iterator LRUIterator;
+	};
+	void EvictToBudget();
+private:
+	mutable std::mutex Lock;
+	size_t Budget = 0;
+	size_t MemorySize = 0;
+	size_t HitNum = 0;
+	size_t MissNum = 0;
+	std::list<int> LRU;//最近使用的在前面
+	std::unordered_map<int, Entry> Entries;
+};
@@ -0,0 +1,218 @@
+#include "VertexTransform.h"
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define VERTEX_TRANSFORM_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_TRANSFORM_SSE 1
+#endif
+
+//GCC与Clang需要给使用AVX2的函数单独打开指令集，MSVC不需要
+//不打开FMA：乘加合并会改变舍入，结果就和glm不同了
+#if defined(__GNUC__)
+#define VERTEX_TRANSFORM_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define VERTEX_TRANSFORM_AVX2_TARGET
+#endif
+
+namespace
+{
+	using vertexTransform::TransformKernel;
+
+	void TransformScalar(const glm::mat4& m, const float* In, int Num, float* Out, const glm::vec3& Origin)
+	{
+		for (int i = 0; i < Num; i++)
+		{
+			const float* p = In + i * 3;
+			glm::vec3 r = m * glm::vec4(glm::vec3(p[0], p[1], p[2]) - Origin, 1.0f);
+			Out[i * 3] = r.x;
+			Out[i * 3 + 1] = r.y;
+			Out[i * 3 + 2] = r.z;
+		}
+	}
+
+#ifdef VERTEX_TRANSFORM_SSE
+	void TransformSSE(const glm::mat4& m, const float* In, int Num, float* Out, const glm::vec3& Origin)
+	{
+		const __m128 c0 = _mm_setr_ps(m[0][0], m[0][1], m[0][2], m[0][3]);
+		const __m128 c1 = _mm_setr_ps(m[1][0], m[1][1], m[1][2], m[1][3]);
+		const __m128 c2 = _mm_setr_ps(m[2][0], m[2][1], m[2][2], m[2][3]);
+		const __m128 c3 = _mm_setr_ps(m[3][0], m[3][1], m[3][2], m[3][3]);
+		for (int i = 0; i < Num; i++)
+		{
+			const float* p = In + i * 3;
+			//加法顺序与glm的mat4 * vec4相同：(c0*x + c1*y) + (c2*z + c3*w)
+			__m128 x = _mm_set1_ps(p[0] - Origin.x);
+			__m128 y = _mm_set1_ps(p[1] - Origin.y);
+			__m128 z = _mm_set1_ps(p[2] - Origin.z);
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, x), _mm_mul_ps(c1, y)), _mm_add_ps(_mm_mul_ps(c2, z), c3));
+			//只写xyz，不能越过当前顶点写到下一个顶点，In与Out相同时下一个顶点还没有读
+			float* q = Out + i * 3;
+			_mm_storel_pi(reinterpret_cast<__m64*>(q), r);
+			_mm_store_ss(q + 2, _mm_movehl_ps(r, r));
+		}
+	}
+#endif
+
+#if defined(VERTEX_TRANSFORM_X86) && defined(VERTEX_TRANSFORM_SSE)
+	/*
+	* 每次处理8个顶点：读入24个float，拆成x、y、z三组（SoA）计算，再交错写回
+	*/
+	VERTEX_TRANSFORM_AVX2_TARGET
+	void TransformAVX2(const glm::mat4& m, const float* In, int Num, float* Out, const glm::vec3& Origin)
+	{
+		const __m256i GatherX = _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5);
+		const __m256i GatherY = _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6);
+		const __m256i GatherZ = _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7);
+		const __m256i ScatterY = _mm256_setr_epi32(5, 0, 3, 6, 1, 4, 7, 2);
+		const __m256 ox = _mm256_set1_ps(Origin.x);
+		const __m256 oy = _mm256_set1_ps(Origin.y);
+		const __m256 oz = _mm256_set1_ps(Origin.z);
+		__m256 mc[4][3];
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 3; r++)
+			{
+				mc[c][r] = _mm256_set1_ps(m[c][r]);
+			}
+		}
+
+		int Batch = Num / 8 * 8;
+		for (int i = 0; i < Batch; i += 8)
+		{
+			const float* p = In + i * 3;
+			__m256 a = _mm256_loadu_ps(p);
+			__m256 b = _mm256_loadu_ps(p + 8);
+			__m256 c = _mm256_loadu_ps(p + 16);
+			//a中x在0,3,6，y在1,4,7，z在2,5；b中x在1,4,7，y在2,5，z在0,3,6；c中x在2,5，y在0,3,6，z在1,4,7
+			__m256 x = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x92), c, 0x24), GatherX);
+			__m256 y = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x24), c, 0x49), GatherY);
+			__m256 z = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x49), c, 0x92), GatherZ);
+			x = _mm256_sub_ps(x, ox);
+			y = _mm256_sub_ps(y, oy);
+			z = _mm256_sub_ps(z, oz);
+
+			__m256 Result[3];
+			for (int r = 0; r < 3; r++)
+			{
+				Result[r] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(mc[0][r], x), _mm256_mul_ps(mc[1][r], y)), _mm256_add_ps(_mm256_mul_ps(mc[2][r], z), mc[3][r]));
+			}
+
+			//GatherX与GatherZ正好也是x、z交错写回时需要的排列
+			__m256 px = _mm256_permutevar8x32_ps(Result[0], GatherX);
+			__m256 py = _mm256_permutevar8x32_ps(Result[1], ScatterY);
+			__m256 pz = _mm256_permutevar8x32_ps(Result[2], GatherZ);
+			float* q = Out + i * 3;
+			_mm256_storeu_ps(q, _mm256_blend_ps(_mm256_blend_ps(px, py, 0x92), pz, 0x24));
+			_mm256_storeu_ps(q + 8, _mm256_blend_ps(_mm256_blend_ps(px, py, 0x24), pz, 0x49));
+			_mm256_storeu_ps(q + 16, _mm256_blend_ps(_mm256_blend_ps(px, py, 0x49), pz, 0x92));
+		}
+		TransformSSE(m, In + Batch * 3, Num - Batch, Out + Batch * 3, Origin);
+	}
+
+	bool DetectAVX2()
+	{
+#if defined(__GNUC__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+		int Info[4];
+		__cpuid(Info, 0);
+		if (Info[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(Info, 1);
+		//OSXSAVE与AVX，并且操作系统保存了YMM寄存器
+		if ((Info[2] & (1 << 27)) == 0 || (Info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+		__cpuidex(Info, 7, 0);
+		return (Info[1] & (1 << 5)) != 0;
+#else
+		return false;
+#endif
+	}
+
+	bool CpuSupportsAVX2()
+	{
+		static const bool Supported = DetectAVX2();
+		return Supported;
+	}
+#endif
+}
+
+namespace vertexTransform
+{
+	TransformKernel GetBestKernel()
+	{
+		static const TransformKernel Best = IsKernelSupported(TransformKernel::AVX2) ? TransformKernel::AVX2
+			: IsKernelSupported(TransformKernel::SSE) ? TransformKernel::SSE : TransformKernel::Scalar;
+		return Best;
+	}
+
+	bool IsKernelSupported(TransformKernel Kernel)
+	{
+		switch (Kernel)
+		{
+#if defined(VERTEX_TRANSFORM_X86) && defined(VERTEX_TRANSFORM_SSE)
+		case TransformKernel::AVX2:
+			return CpuSupportsAVX2();
+#endif
+#ifdef VERTEX_TRANSFORM_SSE
+		case TransformKernel::SSE:
+			return true;
+#endif
+		case TransformKernel::Scalar:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	const char* GetKernelName(TransformKernel Kernel)
+	{
+		switch (Kernel)
+		{
+		case TransformKernel::AVX2:
+			return "avx2";
+		case TransformKernel::SSE:
+			return "sse";
+		default:
+			return "scalar";
+		}
+	}
+
+	void TransformPoints(const glm::mat4& m, const float* In, int Num, float* Out, const glm::vec3& Origin)
+	{
+		TransformPoints(GetBestKernel(), m, In, Num, Out, Origin);
+	}
+
+	void TransformPoints(TransformKernel Kernel, const glm::mat4& m, const float* In, int Num, float* Out, const glm::vec3& Origin)
+	{
+		if (!IsKernelSupported(Kernel))
+		{
+			Kernel = GetBestKernel();
+		}
+		switch (Kernel)
+		{
+#if defined(VERTEX_TRANSFORM_X86) && defined(VERTEX_TRANSFORM_SSE)
+		case TransformKernel::AVX2:
+			TransformAVX2(m, In, Num, Out, Origin);
+			return;
+#endif
+#ifdef VERTEX_TRANSFORM_SSE
+		case TransformKernel::SSE:
+			TransformSSE(m, In, Num, Out, Origin);
+			return;
+#endif
+		default:
+			TransformScalar(m, In, Num, Out, Origin);
+			return;
+		}
+	}
+}
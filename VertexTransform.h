@@ -0,0 +1,30 @@
+#pragma once
+#include "glm/glm.hpp"
+
+namespace vertexTransform
+{
+	/*
+	* 变换使用的指令集，不支持的指令集会退回到下一级
+	*/
+	enum class TransformKernel
+	{
+		Scalar,
+		SSE,
+		AVX2,
+	};
+	/*
+	* 当前CPU支持的最快的指令集，第一次调用时检测
+	*/
+	TransformKernel GetBestKernel();
+	bool IsKernelSupported(TransformKernel Kernel);
+	const char* GetKernelName(TransformKernel Kernel);
+	/*
+	* Out[i] = m * vec4(In[i] - Origin, 1)，In与Out都是连续存放的xyz（rcRasterizeTriangles使用的格式），可以是同一块内存
+	* 所有指令集的结果与逐个顶点用glm计算的结果完全相同，使用GetBestKernel()
+	*/
+	void TransformPoints(const glm::mat4& m, const float* In, int Num, float* Out, const glm::vec3& Origin = glm::vec3(0, 0, 0));
+	/*
+	* 指定指令集，用于性能测试
+	*/
+	void TransformPoints(TransformKernel Kernel, const glm::mat4& m, const float* In, int Num, float* Out, const glm::vec3& Origin = glm::vec3(0, 0, 0));
+}
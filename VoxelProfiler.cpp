@@ -0,0 +1,177 @@
+#include "VoxelProfiler.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+	const char* const LabelNames[VOXEL_MAX_TIMERS] =
+	{
+		"TOTAL",
+		"TEMP",
+		"RASTERIZE_TRIANGLES",
+		"BUILD_COMPACTHEIGHTFIELD",
+		"BUILD_CONTOURS",
+		"BUILD_CONTOURS_TRACE",
+		"BUILD_CONTOURS_SIMPLIFY",
+		"FILTER_BORDER",
+		"FILTER_WALKABLE",
+		"MEDIAN_AREA",
+		"FILTER_LOW_OBSTACLES",
+		"BUILD_POLYMESH",
+		"MERGE_POLYMESH",
+		"ERODE_AREA",
+		"MARK_BOX_AREA",
+		"MARK_CYLINDER_AREA",
+		"MARK_CONVEXPOLY_AREA",
+		"BUILD_DISTANCEFIELD",
+		"BUILD_DISTANCEFIELD_DIST",
+		"BUILD_DISTANCEFIELD_BLUR",
+		"BUILD_REGIONS",
+		"BUILD_REGIONS_WATERSHED",
+		"BUILD_REGIONS_EXPAND",
+		"BUILD_REGIONS_FLOOD",
+		"BUILD_REGIONS_FILTER",
+		"BUILD_LAYERS",
+		"BUILD_POLYMESHDETAIL",
+		"MERGE_POLYMESHDETAIL",
+		"VOXEL_TILE",
+		"VOXEL_QUERY_OBJECTS",
+		"VOXEL_TRANSFORM_VERTICES",
+		"VOXEL_WRITE_SPANS",
+	};
+	static_assert(RC_MAX_TIMERS == 28, "LabelNames must follow rcTimerLabel");
+}
+
+ProfilingContext::ProfilingContext()
+	:rcContext(true)
+{
+	enableLog(false);
+	doResetTimers();
+}
+
+void ProfilingContext::StartStage(int Label)
+{
+	StartTime[Label] = std::chrono::steady_clock::now();
+}
+
+void ProfilingContext::StopStage(int Label)
+{
+	Accumulated[Label] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - StartTime[Label]).count();
+	CallNum[Label]++;
+}
+
+void ProfilingContext::doResetTimers()
+{
+	for (int i = 0; i < VOXEL_MAX_TIMERS; i++)
+	{
+		Accumulated[i] = 0;
+		CallNum[i] = 0;
+	}
+}
+
+void VoxelProfiler::Prepare(int ThreadNum)
+{
+	while (Contexts.size() < ThreadNum)
+	{
+		Contexts.emplace_back(std::make_unique<ProfilingContext>());
+	}
+}
+
+double VoxelProfiler::GetTotalMilliseconds(int Label) const
+{
+	int64_t Total = 0;
+	for (auto&& c : Contexts)
+	{
+		Total += c->GetAccumulatedNanoseconds(Label);
+	}
+	return Total / 1e6;
+}
+
+int64_t VoxelProfiler::GetTotalCallNum(int Label) const
+{
+	int64_t Total = 0;
+	for (auto&& c : Contexts)
+	{
+		Total += c->GetCallNum(Label);
+	}
+	return Total;
+}
+
+std::string VoxelProfiler::GetTextReport() const
+{
+	std::vector<int> Labels;
+	for (int i = 0; i < VOXEL_MAX_TIMERS; i++)
+	{
+		if (GetTotalCallNum(i) > 0)
+		{
+			Labels.emplace_back(i);
+		}
+	}
+	std::stable_sort(Labels.begin(), Labels.end(), [this](int a, int b) { return GetTotalMilliseconds(a) > GetTotalMilliseconds(b); });
+
+	//百分比相对于所有线程VOXEL_TIMER_TILE的合计时间
+	double TileTime = GetTotalMilliseconds(VOXEL_TIMER_TILE);
+	std::string Report;
+	char Line[256];
+	snprintf(Line, sizeof(Line), "voxelization: wall %.1f ms, threads %d\n", WallSeconds * 1e3, GetThreadNum());
+	Report += Line;
+	snprintf(Line, sizeof(Line), "%-28s %12s %10s %10s %7s   per thread ms\n", "label", "total ms", "calls", "avg us", "tile%");
+	Report += Line;
+	for (int Label : Labels)
+	{
+		double Total = GetTotalMilliseconds(Label);
+		int64_t Calls = GetTotalCallNum(Label);
+		snprintf(Line, sizeof(Line), "%-28s %12.2f %10lld %10.2f %6.1f%%  ", GetLabelName(Label), Total, (long long)Calls,
+			Total * 1e3 / Calls, TileTime > 0 ? Total * 100.0 / TileTime : 0.0);
+		Report += Line;
+		for (auto&& c : Contexts)
+		{
+			snprintf(Line, sizeof(Line), " %.1f", c->GetAccumulatedNanoseconds(Label) / 1e6);
+			Report += Line;
+		}
+		Report += "\n";
+	}
+	return Report;
+}
+
+std::string VoxelProfiler::GetJsonReport() const
+{
+	using json = nlohmann::json;
+	json Report;
+	Report["wall_ms"] = WallSeconds * 1e3;
+	Report["threads"] = GetThreadNum();
+	json Labels = json::array();
+	for (int i = 0; i < VOXEL_MAX_TIMERS; i++)
+	{
+		if (GetTotalCallNum(i) == 0)
+		{
+			continue;
+		}
+		json PerThreadTime = json::array();
+		json PerThreadCalls = json::array();
+		for (auto&& c : Contexts)
+		{
+			PerThreadTime.push_back(c->GetAccumulatedNanoseconds(i) / 1e6);
+			PerThreadCalls.push_back(c->GetCallNum(i));
+		}
+		Labels.push_back({ { "name", GetLabelName(i) }, { "total_ms", GetTotalMilliseconds(i) }, { "calls", GetTotalCallNum(i) },
+			{ "per_thread_ms", PerThreadTime }, { "per_thread_calls", PerThreadCalls } });
+	}
+	Report["labels"] = Labels;
+	return Report.dump(2);
+}
+
+void VoxelProfiler::Reset()
+{
+	for (auto&& c : Contexts)
+	{
+		c->resetTimers();
+	}
+	WallSeconds = 0;
+}
+
+const char* VoxelProfiler::GetLabelName(int Label)
+{
+	return Label >= 0 && Label < VOXEL_MAX_TIMERS ? LabelNames[Label] : "UNKNOWN";
+}
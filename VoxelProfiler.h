@@ -0,0 +1,101 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include "ReCast/Recast.h"
+
+/*
+* 体素化自己的计时标签，接在rcTimerLabel后面
+*/
+enum VoxelTimerLabel
+{
+	VOXEL_TIMER_TILE = RC_MAX_TIMERS,//整个Tile
+	VOXEL_TIMER_QUERY_OBJECTS,//找出与Tile相交的模型
+	VOXEL_TIMER_TRANSFORM_VERTICES,//把顶点变换到Tile坐标系
+	VOXEL_TIMER_WRITE_SPANS,//把高度场写入SpanData
+	VOXEL_MAX_TIMERS
+};
+
+/*
+* 记录每个标签累计时间与调用次数的rcContext，一个线程使用一个，不能在多个线程中同时使用
+* Recast内部的计时（如RC_TIMER_RASTERIZE_TRIANGLES）通过rcContext的虚函数记录，体素化的计时用StartStage/StopStage
+*/
+class ProfilingContext : public rcContext
+{
+public:
+	ProfilingContext();
+	void StartStage(int Label);
+	void StopStage(int Label);
+	int64_t GetAccumulatedNanoseconds(int Label) const { return Accumulated[Label]; }
+	int64_t GetCallNum(int Label) const { return CallNum[Label]; }
+protected:
+	void doResetTimers() override;
+	void doStartTimer(const rcTimerLabel label) override { StartStage(label); }
+	void doStopTimer(const rcTimerLabel label) override { StopStage(label); }
+	int doGetAccumulatedTime(const rcTimerLabel label) const override { return int(Accumulated[label] / 1000); }
+private:
+	std::chrono::steady_clock::time_point StartTime[VOXEL_MAX_TIMERS];
+	int64_t Accumulated[VOXEL_MAX_TIMERS];
+	int64_t CallNum[VOXEL_MAX_TIMERS];
+};
+
+/*
+* 整个球体素化的性能统计：每个工作线程（按ParallelFor的ThreadIndex）一个ProfilingContext，报告时合并
+* 传给ReCastSphereVoxelization后，可以输出文本或JSON格式的报告
+*/
+class VoxelProfiler
+{
+public:
+	/*
+	* 保证至少有ThreadNum个线程的ProfilingContext，不清空已有的数据
+	*/
+	void Prepare(int ThreadNum);
+	ProfilingContext* GetContext(int ThreadIndex) { return Contexts[ThreadIndex].get(); }
+	int GetThreadNum() const { return int(Contexts.size()); }
+	/*
+	* 所有线程合计的时间（毫秒）与调用次数
+	*/
+	double GetTotalMilliseconds(int Label) const;
+	int64_t GetTotalCallNum(int Label) const;
+	void AddWallTime(double Seconds) { WallSeconds += Seconds; }
+	/*
+	* 按总时间从大到小列出调用过的标签，包括每个线程的时间
+	*/
+	std::string GetTextReport() const;
+	std::string GetJsonReport() const;
+	void Reset();
+	static const char* GetLabelName(int Label);
+private:
+	std::vector<std::unique_ptr<ProfilingContext>> Contexts;
+	double WallSeconds = 0;
+};
+
+/*
+* Profile为空时不计时
+*/
+class ScopedStage
+{
+public:
+	ScopedStage(ProfilingContext* Profile, int Label)
+		:Profile(Profile), Label(Label)
+	{
+		if (Profile)
+		{
+			Profile->StartStage(Label);
+		}
+	}
+	~ScopedStage()
+	{
+		if (Profile)
+		{
+			Profile->StopStage(Label);
+		}
+	}
+	ScopedStage(const ScopedStage&) = delete;
+	ScopedStage& operator=(const ScopedStage&) = delete;
+private:
+	ProfilingContext* Profile;
+	int Label;
+};
@@ -1,20 +1,46 @@
 #include"Voxelization.h"
 
 #include <array>
+#include <algorithm>
+#include <functional>
 #include"SpanData.h"
 #include "SceneMgr.h"
+#include "TaskScheduler.h"
+#include "VertexTransform.h"
+#include "VoxelProfiler.h"
+#include <chrono>
+#include <atomic>
 #define MaxDepth 20000
 
 namespace voxelFuncs
 {
+	namespace
+	{
+		/*
+		* Span在SpanData::Compact中的编号，sp可以是Compact中的Span，也可以是Data中（没有释放时）的Span
+		*/
+		int getCompactSpanIndex(const Span& sp)
+		{
+			auto&& instance = SpanData::getInstance();
+			const Span* CompactBegin = instance.Compact.GetSpans();
+			std::less<const Span*> Less;
+			if (CompactBegin && !Less(&sp, CompactBegin) && Less(&sp, CompactBegin + instance.Compact.GetSpanNum()))
+			{
+				return int(&sp - CompactBegin);
+			}
+			return instance.Compact.GetListSpanBegin(sp.ListIndex) + int(&sp - instance.Data[sp.ListIndex].Spans.data());
+		}
+	}
 
 	std::vector<std::shared_ptr<wayNode>> findWays(const Span& sp1, const Span& sp2, SphereMgr& sphere)
 	{
+		//Compaction(true)之后Data中的Span已经释放，统一使用Compact中的Span
+		auto&& Compact = SpanData::getInstance().Compact;
 		std::shared_ptr<wayNode> start = std::make_shared<wayNode>(0, 0, 0);
-		start->sp = &sp1;
+		start->sp = &Compact.GetSpan(getCompactSpanIndex(sp1));
 
 		std::shared_ptr<wayNode> end = std::make_shared<wayNode>(0, 0, 0);
-		end->sp = &sp2;
+		end->sp = &Compact.GetSpan(getCompactSpanIndex(sp2));
 
 		int SearchCount = 0;
 		std::vector<std::shared_ptr<wayNode>> open_list;
@@ -58,14 +84,11 @@ namespace voxelFuncs
 			}
 
 			std::vector<std::shared_ptr<wayNode>> neighbors;
-			auto&& instance = SpanData::getInstance();
-			for (int i = 0; i < instance.Data[current_node->sp->ListIndex].neighborsIndex.size(); i++)
+			Compact.ForEachNeighbor(current_node->sp->ListIndex, [&](int NeighborListIndex)
 			{
-				const SpanList& List = instance.Data[current_node->sp->ListIndex];
-				const SpanList& neighborsList = instance.Data[List.neighborsIndex[i]];
-				for (int j = 0; j < neighborsList.Spans.size(); j++)
+				for (int j = Compact.GetListSpanBegin(NeighborListIndex); j < Compact.GetListSpanEnd(NeighborListIndex); j++)
 				{
-					auto&& searchSpan = neighborsList.Spans[j];
+					auto&& searchSpan = Compact.GetSpan(j);
 					if (std::abs(searchSpan.top - current_node->sp->top) > 2* sphere.Stride)
 					{
 						continue;
@@ -74,7 +97,7 @@ namespace voxelFuncs
 					newNode->sp = &searchSpan;
 					neighbors.emplace_back(newNode);
 				}
-			}
+			});
 
 			for (std::shared_ptr<wayNode> n : neighbors)
 			{
@@ -104,97 +127,244 @@ namespace voxelFuncs
 
 	const Span& getRandomSpan(SphereMgr& Sphere)
 	{
+		return SpanData::getInstance().Compact.GetSpan(getRandomSpanIndex(Sphere));
+	}
+
+	int getRandomSpanIndex(const SphereMgr& Sphere)
+	{
+		auto&& Compact = SpanData::getInstance().Compact;
 		int beginIndex = SpanData::getInstance().Dictionary[Sphere.SphereId].first;
 		int endIndex = SpanData::getInstance().Dictionary[Sphere.SphereId].second;
 		int range = endIndex - beginIndex + 1;
-		int RandomListIndex;
-		int RandomSpanIndex;
+		if (range <= 0 || Compact.GetListSpanBegin(beginIndex) == Compact.GetListSpanEnd(endIndex))
+		{
+			return -1;
+		}
 		while (true)
 		{
-			RandomListIndex = rand() % range + beginIndex;
-			
-			if (SpanData::getInstance().Data[RandomListIndex].Spans.size() > 0)
+			int RandomListIndex = rand() % range + beginIndex;
+			int SpanNum = Compact.GetListSpanNum(RandomListIndex);
+			if (SpanNum > 0)
 			{
-				RandomSpanIndex = rand() % (SpanData::getInstance().Data[RandomListIndex].Spans.size());
-				break;
+				return Compact.GetListSpanBegin(RandomListIndex) + rand() % SpanNum;
 			}
 		}
-		return  SpanData::getInstance().Data[RandomListIndex].Spans[RandomSpanIndex];
 	}
 
-	void ReCastSphereVoxelization(const std::unique_ptr<SceneMgr>& dataPtr, const SphereMgr& Sphere, int TileSize, float cellStride, float cellHeight, float minHeight, float maxHeight)
+	int getRandomSpanIndex(const SphereMgr& Sphere, int Component)
+	{
+		auto&& Compact = SpanData::getInstance().Compact;
+		if (!Compact.HasComponents() || Component < 0 || Component >= Compact.GetComponentNum())
+		{
+			return -1;
+		}
+		//大的分量直接随机取Span，一般几次就能取到
+		const int MaxTries = 64;
+		for (int i = 0; i < MaxTries; i++)
+		{
+			int SpanIndex = getRandomSpanIndex(Sphere);
+			if (SpanIndex < 0)
+			{
+				return -1;
+			}
+			if (Compact.GetSpanComponent(SpanIndex) == Component)
+			{
+				return SpanIndex;
+			}
+		}
+		//小的分量（或者不在本球上的分量）：在本球的Span中找分量中随机的第几个，一个分量的Span都在同一个球上
+		int SpanBegin = Compact.GetListSpanBegin(SpanData::getInstance().Dictionary[Sphere.SphereId].first);
+		int SpanEnd = Compact.GetListSpanEnd(SpanData::getInstance().Dictionary[Sphere.SphereId].second);
+		int Remain = rand() % Compact.GetComponentSize(Component);
+		for (int i = SpanBegin; i < SpanEnd; i++)
+		{
+			if (Compact.GetSpanComponent(i) == Component && Remain-- == 0)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	int getLargestComponent(const SphereMgr& Sphere)
+	{
+		auto&& Compact = SpanData::getInstance().Compact;
+		if (!Compact.HasComponents())
+		{
+			return -1;
+		}
+		//分量按Span数从大到小编号，本球中编号最小的分量就是最大的
+		int SpanBegin = Compact.GetListSpanBegin(SpanData::getInstance().Dictionary[Sphere.SphereId].first);
+		int SpanEnd = Compact.GetListSpanEnd(SpanData::getInstance().Dictionary[Sphere.SphereId].second);
+		int Largest = -1;
+		for (int i = SpanBegin; i < SpanEnd; i++)
+		{
+			int Component = Compact.GetSpanComponent(i);
+			Largest = Largest < 0 ? Component : std::min(Largest, Component);
+		}
+		return Largest;
+	}
+
+	int ReCastSphereVoxelization(const std::unique_ptr<SceneMgr>& dataPtr, const SphereMgr& Sphere, int TileSize, float cellStride, float cellHeight, float minHeight, float maxHeight, int ThreadNum, VoxelProfiler* Profiler)
 	{
-		for (int i = 0; i < Sphere.Tiles.size(); i++)
+		if (SpanData::getInstance().ReadOnly)
 		{
-			for (int j = 0; j < Sphere.Tiles[i].size(); j++)
+			return 0;
+		}
+		//MeshObjects在上次构建BVH之后被修改过时重新构建，否则BVH会漏掉移动过的模型
+		dataPtr->UpdateObjectBVH();
+		WorkStealingScheduler Scheduler(ThreadNum);
+		auto Begin = std::chrono::steady_clock::now();
+		if (Profiler)
+		{
+			Profiler->Prepare(Scheduler.GetThreadNum());
+		}
+		std::atomic<int> DroppedNum(0);
+		if (Scheduler.GetThreadNum() == 1)
+		{
+			ProfilingContext* Profile = Profiler ? Profiler->GetContext(0) : nullptr;
+			for (int i = 0; i < Sphere.Tiles.size(); i++)
 			{
-				ReCastSingleTileReCast(Sphere.Tiles[i][j], dataPtr, Sphere,TileSize, cellStride, cellHeight, minHeight, maxHeight);
+				for (int j = 0; j < Sphere.Tiles[i].size(); j++)
+				{
+					DroppedNum += !ReCastSingleTileReCast(Sphere.Tiles[i][j], dataPtr, Sphere, TileSize, cellStride, cellHeight, minHeight, maxHeight, Profile);
+				}
 			}
 		}
+		else
+		{
+			//展开成一维的任务列表，任务编号与单线程的遍历顺序相同
+			std::vector<const Tile*> TileTasks;
+			TileTasks.reserve(Sphere.total_tiles_num);
+			for (auto&& Row : Sphere.Tiles)
+			{
+				for (auto&& t : Row)
+				{
+					TileTasks.emplace_back(&t);
+				}
+			}
+			Scheduler.ParallelFor(int(TileTasks.size()), [&](int TaskIndex, int ThreadIndex)
+			{
+				ProfilingContext* Profile = Profiler ? Profiler->GetContext(ThreadIndex) : nullptr;
+				DroppedNum += !ReCastSingleTileReCast(*TileTasks[TaskIndex], dataPtr, Sphere, TileSize, cellStride, cellHeight, minHeight, maxHeight, Profile);
+			});
+		}
+		if (Profiler)
+		{
+			Profiler->AddWallTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - Begin).count());
+		}
+		return DroppedNum;
 	}
 	
-	void ReCastSingleTileReCast(const Tile& tile, const std::unique_ptr<SceneMgr>& dataPtr, const SphereMgr& Sphere, int TileSize, float cellStride, float cellHeight, float minHeight, float maxHeight)
+	bool ReCastSingleTileReCast(const Tile& tile, const std::unique_ptr<SceneMgr>& dataPtr, const SphereMgr& Sphere, int TileSize, float cellStride, float cellHeight, float minHeight, float maxHeight, ProfilingContext* Profile)
 	{
+		ScopedStage TileStage(Profile, VOXEL_TIMER_TILE);
 		auto&& [MinPoint, MaxPoint] = GetTileWorldAABB(tile, float(maxHeight),TileSize,cellStride);
-		std::vector<MeshObject> GeosInthisTile;
-		rcHeightfield* HeightField = nullptr;
-		HeightField = rcAllocHeightfield();
-		
+		//每个线程一个高度场，Tile之间只重置不释放，Span池的大小稳定后不再分配内存
+		static thread_local rcHeightfield HeightField;
 		float HeightFiledMin[3] = { -TileSize * cellStride / 2.0f, minHeight,-TileSize * cellStride / 2.0f };
 		float HeightFiledMax[3] = { TileSize * cellStride / 2.0f, maxHeight ,TileSize * cellStride / 2.0f };
-		rcCreateHeightfield(nullptr, *HeightField, TileSize, TileSize, HeightFiledMin, HeightFiledMax, cellStride, cellHeight);
+		if (!rcResetHeightfield(nullptr, HeightField, TileSize, TileSize, HeightFiledMin, HeightFiledMax, cellStride, cellHeight))
+		{
+			return false;
+		}
 
-		for (int i = 0; i < dataPtr->MeshObjects.size(); i++)
+		//有BVH时用BVH找出与Tile相交的模型，按下标排序保证光栅化顺序与逐个判断时相同
+		static thread_local std::vector<int> Candidates;
+		Candidates.clear();
+		if (Profile)
+		{
+			Profile->StartStage(VOXEL_TIMER_QUERY_OBJECTS);
+		}
+		if (dataPtr->ObjectBVH.GetObjectNum() == dataPtr->MeshObjects.size())
 		{
-			const MeshObject& GD = dataPtr->MeshObjects[i];
-			if (wetherAABBIntersect(GD.WorldMin, GD.WorldMax, MinPoint, MaxPoint))
+			dataPtr->ObjectBVH.Query(MinPoint, MaxPoint, Candidates);
+			std::sort(Candidates.begin(), Candidates.end());
+		}
+		else
+		{
+			for (int i = 0; i < dataPtr->MeshObjects.size(); i++)
 			{
-				GeosInthisTile.emplace_back(GD);
+				const MeshObject& GD = dataPtr->MeshObjects[i];
+				if (wetherAABBIntersect(GD.WorldMin, GD.WorldMax, MinPoint, MaxPoint))
+				{
+					Candidates.emplace_back(i);
+				}
 			}
 		}
-
-		for (int i = 0; i < GeosInthisTile.size(); i++)
+		if (Profile)
 		{
-			glm::vec3 axis_y = glm::normalize(tile.CenterPos);
-			glm::mat4 matrix = glm::mat4(glm::vec4(tile.axis_u, 0), glm::vec4(axis_y, 0), glm::vec4(tile.axis_v, 0), glm::vec4(0, 0, 0, 1));
-			matrix = glm::transpose(matrix);
-			glm::mat4 m;
-			m = glm::translate(glm::mat4(1.0f), GeosInthisTile[i].WorldPos) * glm::toMat4(GeosInthisTile[i].rotation) * glm::scale(glm::mat4(1.0f), GeosInthisTile[i].scale);
-			std::shared_ptr<MeshData> MeshD = dataPtr->MeshMap[GeosInthisTile[i].MeshPathName];
-			std::vector<float> vecs;
-			vecs.reserve(MeshD->worldVertices.size() * 3);
-			for (int index = 0; index < MeshD->worldVertices.size(); index++)
+			Profile->StopStage(VOXEL_TIMER_QUERY_OBJECTS);
+		}
+		glm::vec3 axis_y = glm::normalize(tile.CenterPos);
+		glm::mat4 matrix = glm::mat4(glm::vec4(tile.axis_u, 0), glm::vec4(axis_y, 0), glm::vec4(tile.axis_v, 0), glm::vec4(0, 0, 0, 1));
+		matrix = glm::transpose(matrix);
+		//顶点与三角形区域的缓冲在同一线程的所有Tile之间复用
+		static thread_local std::vector<float> vecs;
+		static thread_local std::vector<unsigned char> triareas;
+		static thread_local rcContext ctx(false);
+		for (int i : Candidates)
+		{
+			const MeshObject& Object = dataPtr->MeshObjects[i];
+			//按MeshId直接取模型，手动填写、没有MeshId的MeshObject才按路径查找（多线程时不能用operator[]，它会修改MeshMap）
+			const MeshData& MeshD = Object.MeshId >= 0 ? dataPtr->GetMesh(Object.MeshId) : *dataPtr->MeshMap.at(Object.MeshPathName);
+			int VertexNum = int(MeshD.worldVertices.size());
+			if (VertexNum == 0)
+			{
+				continue;
+			}
 			{
-				glm::vec3 worldPos = m * glm::vec4(MeshD->worldVertices[index], 1.0f);
-				glm::vec3 newPos = matrix * glm::vec4(worldPos - tile.CenterPos, 1.0f);
-				vecs.emplace_back(newPos.x);
-				vecs.emplace_back(newPos.y);
-				vecs.emplace_back(newPos.z);
+				ScopedStage TransformStage(Profile, VOXEL_TIMER_TRANSFORM_VERTICES);
+				vecs.resize(size_t(VertexNum) * 3);
+				//世界坐标顶点在缓存中时只需要变换到Tile坐标系，否则先变换到世界坐标再原地变换到Tile坐标系
+				auto WorldVertices = dataPtr->VertexCache.Get(i, Object, MeshD);
+				const float* WorldPos = WorldVertices ? WorldVertices->data() : vecs.data();
+				if (!WorldVertices)
+				{
+					glm::mat4 m;
+					m = glm::translate(glm::mat4(1.0f), Object.WorldPos) * glm::toMat4(Object.rotation) * glm::scale(glm::mat4(1.0f), Object.scale);
+					vertexTransform::TransformPoints(m, &MeshD.worldVertices[0].x, VertexNum, vecs.data());
+				}
+				vertexTransform::TransformPoints(matrix, WorldPos, VertexNum, vecs.data(), tile.CenterPos);
 			}
-			static thread_local rcContext ctx;
-			auto triareas = std::make_unique<unsigned char[]>(MeshD->indices.size() / 3);
-			memset(triareas.get(), RC_WALKABLE_AREA, MeshD->indices.size() / 3 * sizeof(unsigned char));
-			rcRasterizeTriangles(&ctx, vecs.data(), MeshD->worldVertices.size(), MeshD->indices.data(), triareas.get(), MeshD->indices.size() / 3, *HeightField, 10000);
-			vecs.swap(std::vector<float>());
+			int TriangleNum = int(MeshD.indices.size() / 3);
+			triareas.assign(TriangleNum, RC_WALKABLE_AREA);
+			//有Profile时Recast内部的计时（RC_TIMER_RASTERIZE_TRIANGLES）也记录到Profile中
+			rcRasterizeTriangles(Profile ? static_cast<rcContext*>(Profile) : &ctx, vecs.data(), MeshD.worldVertices.size(), MeshD.indices.data(), triareas.data(), TriangleNum, HeightField, 10000);
 		}
 
-		ReCastHeightFieldToSpanData(tile, *HeightField, Sphere, cellHeight, minHeight);
-		rcFreeHeightField(HeightField);
-		HeightField = nullptr;
+		ScopedStage WriteStage(Profile, VOXEL_TIMER_WRITE_SPANS);
+		return ReCastHeightFieldToSpanData(tile, HeightField, Sphere, cellHeight, minHeight);
 	}
 	
-	void ReCastHeightFieldToSpanData(const Tile& t, rcHeightfield& hf, const SphereMgr& Sphere,float cellHeight,float minHeight)
+	bool ReCastHeightFieldToSpanData(const Tile& t, rcHeightfield& hf, const SphereMgr& Sphere,float cellHeight,float minHeight)
 	{
+		//多个线程同时写入时，每个Tile只访问Data中属于自己的[TileSpanListBeginIndex, TileSpanListBeginIndex + TileSize * TileSize)
+		//这里只读Dictionary，不改变Data的大小，所以不需要加锁
 		auto&& instance = SpanData::getInstance();
+		if (instance.ReadOnly)
+		{
+			return false;
+		}
+		//高度场的大小与球的TileSize不同，或者Tile的SpanList不在本球的范围内（TileSize或者球不匹配）时丢弃这个Tile
+		if (hf.width != Sphere.TileSize || hf.height != Sphere.TileSize)
+		{
+			return false;
+		}
 		int beginIndex = instance.Dictionary[Sphere.SphereId].first;
 		int TileSpanListBeginIndex = beginIndex + t.TileIndex * Sphere.TileSize * Sphere.TileSize;
+		if (TileSpanListBeginIndex + Sphere.TileSize * Sphere.TileSize - 1 > instance.Dictionary[Sphere.SphereId].second)
+		{
+			return false;
+		}
+		SpanList* TileLists = instance.Data.data() + TileSpanListBeginIndex;
 
 		for (int x = 0; x < Sphere.TileSize; x++)
 		{
 			for (int z = 0; z < Sphere.TileSize; z++)
 			{
 				int Index = x + (uint64_t)z * hf.width;
-				auto&& List = instance.Data[TileSpanListBeginIndex + Index];
+				auto&& List = TileLists[Index];
 				rcSpan* s = hf.spans[Index];
 				if (s)
 				{
@@ -206,19 +376,20 @@ namespace voxelFuncs
 				}
 			}
 		}
+		return true;
 	}
 
 	float getSpanDistance(const Span& s1, const Span& s2, SphereMgr& sphere)
 	{
-		auto&& instance = SpanData::getInstance();
-		auto&& Tile1 = sphere.GetTileByIndex(instance.Data[s1.ListIndex].TileIndex);
-		auto&& Tile2 = sphere.GetTileByIndex(instance.Data[s2.ListIndex].TileIndex);
+		auto&& Compact = SpanData::getInstance().Compact;
+		auto&& Tile1 = sphere.GetTileByIndex(Compact.GetList(s1.ListIndex).TileIndex);
+		auto&& Tile2 = sphere.GetTileByIndex(Compact.GetList(s2.ListIndex).TileIndex);
 
 		glm::vec3 axis_y1 = glm::normalize(glm::cross(Tile1.axis_u, Tile1.axis_v));
 		glm::vec3 axis_y2 = glm::normalize(glm::cross(Tile2.axis_u, Tile2.axis_v));
 
-		glm::vec3 p1 = instance.Data[s1.ListIndex].CenteralWorldPos + (axis_y1 * s1.top);
-		glm::vec3 p2 = instance.Data[s2.ListIndex].CenteralWorldPos + (axis_y2 * s2.top);
+		glm::vec3 p1 = Compact.GetList(s1.ListIndex).CenteralWorldPos + (axis_y1 * s1.top);
+		glm::vec3 p2 = Compact.GetList(s2.ListIndex).CenteralWorldPos + (axis_y2 * s2.top);
 		return glm::distance(p1, p2);
 	}
 
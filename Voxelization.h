@@ -5,6 +5,8 @@
 
 class SceneMgr;
 struct Span;
+class VoxelProfiler;
+class ProfilingContext;
 
 namespace voxelFuncs
 {
@@ -62,13 +64,44 @@ namespace voxelFuncs
 		return std::make_tuple(MinPoint, MaxPoint);
 	}
 	
-	void ReCastSphereVoxelization(const std::unique_ptr<SceneMgr>& dataPtr, const SphereMgr& Sphere, int TileSize, float cellStride, float cellHeight, float minHeight, float maxHeight);
-	void ReCastSingleTileReCast(const Tile& tile, const std::unique_ptr<SceneMgr>& dataPtr, const SphereMgr& Sphere, int TileSize, float cellStride, float cellHeight, float minHeight, float maxHeight);
-	void ReCastHeightFieldToSpanData(const Tile& t, rcHeightfield& hf, const SphereMgr& Sphere, float cellHeight, float minHeight);
+	/*
+	* 对一个球的所有Tile进行体素化
+	* ThreadNum：体素化使用的线程数，1为单线程，<= 0时使用硬件线程数
+	* 每个Tile只写入自己在SpanData中的那一段SpanList，所以多线程的结果与单线程完全一致
+	* Profiler不为空时记录每个线程各阶段的时间，数据累加到Profiler中已有的数据上
+	* SpanData::ReadOnly（加载了烘焙文件）时不做任何事
+	* 开始前调用SceneMgr::UpdateObjectBVH，MeshObjects改变后不需要手动重新构建BVH
+	* 返回没有写入SpanData的Tile数（TileSize与球不匹配、高度场创建失败等），正常时为0
+	*/
+	int ReCastSphereVoxelization(const std::unique_ptr<SceneMgr>& dataPtr, const SphereMgr& Sphere, int TileSize, float cellStride, float cellHeight, float minHeight, float maxHeight, int ThreadNum = 1, VoxelProfiler* Profiler = nullptr);
+	/*
+	* Profile为空时不计时，返回结果是否写入了SpanData
+	*/
+	bool ReCastSingleTileReCast(const Tile& tile, const std::unique_ptr<SceneMgr>& dataPtr, const SphereMgr& Sphere, int TileSize, float cellStride, float cellHeight, float minHeight, float maxHeight, ProfilingContext* Profile = nullptr);
+	/*
+	* 把高度场写入Tile的SpanList，高度场大小与Sphere.TileSize不同、Tile不在本球的范围内或者ReadOnly时不写入，返回false
+	*/
+	bool ReCastHeightFieldToSpanData(const Tile& t, rcHeightfield& hf, const SphereMgr& Sphere, float cellHeight, float minHeight);
 
 	//Test Func
+	//都读取SpanData::Compact，需要先调用SpanData::Compaction，Compaction(true)释放Data之后与加载烘焙文件之后也可以使用
+	//findWays的参数可以是Data或者Compact中的Span，返回的路径中都是Compact中的Span
 	float getSpanDistance(const Span& s1, const Span& s2, SphereMgr& sphere);
 	std::vector<std::shared_ptr<wayNode>> findWays(const Span& sp1, const Span& sp2, SphereMgr& sphere);
-	const Span& getRandomSpan(SphereMgr& Sphere);
+	const Span& getRandomSpan(SphereMgr& Sphere);//本球必须有Span
+	/*
+	* 在SpanData::Compact中随机取本球的一个Span，返回Span编号，本球没有Span时返回-1
+	*/
+	int getRandomSpanIndex(const SphereMgr& Sphere);
+	/*
+	* 在本球的Component号连通分量中随机取一个Span（需要SpanData::BuildLinks），返回Span编号
+	* 没有连通分量数据、Component无效或者不在本球上时返回-1
+	* 先直接随机取有限次，取不到时（分量很小）在本球的Span中按顺序找，不会无限循环
+	*/
+	int getRandomSpanIndex(const SphereMgr& Sphere, int Component);
+	/*
+	* 本球Span数最多的连通分量编号，没有连通分量数据或者没有Span时返回-1
+	*/
+	int getLargestComponent(const SphereMgr& Sphere);
 
 }
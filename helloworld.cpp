@@ -27,6 +27,10 @@
 #include"SphereSegmentation.h"
 #include"Voxelization.h"
 #include "SpanData.h"
+#include "PathQueryService.h"
+#include "NavBake.h"
+#include "VoxelProfiler.h"
+#include <fstream>
 
 
 namespace
@@ -226,10 +230,36 @@ namespace
 			{
 				Meshes[it->first] = std::make_shared<RenderMesh>(it->second->worldVertices, it->second->indices);
 			}
-			Spheres.emplace_back(SphereMgr());
-			Spheres[0].Build(glm::vec3(0,0,0), 2000.0f, 2, 16.0f, 0);
 
-			voxelFuncs::ReCastSphereVoxelization(SceneMgrPtr, Spheres[0], Spheres[0].TileSize, Spheres[0].Stride, Spheres[0].Stride, 0, 1000.0f);
+			//烘焙文件的参数与场景都没有变化时直接加载，否则重新烘焙并保存
+			NavBakeParams BakeParams;
+			BakeParams.Radius = 2000.0f;
+			BakeParams.TileSize = 2;
+			BakeParams.Stride = 16.0f;
+			BakeParams.CellHeight = 16.0f;
+			BakeParams.MinHeight = 0.0f;
+			BakeParams.MaxHeight = 1000.0f;
+			BakeParams.ClimbHeight = 2 * BakeParams.Stride;
+			uint64_t SceneHash = navBake::HashScene(*SceneMgrPtr);
+			if (!navBake::LoadNavBake(NavBakePath, Spheres, { BakeParams }, SceneHash))
+			{
+				Spheres.emplace_back(SphereMgr());
+				Spheres[0].Build(BakeParams.Center, BakeParams.Radius, BakeParams.TileSize, BakeParams.Stride, 0, VoxelizationThreadNum);
+
+				SceneMgrPtr->VertexCache.SetBudget(VertexCacheBudget);
+				VoxelProfiler Profiler;
+				voxelFuncs::ReCastSphereVoxelization(SceneMgrPtr, Spheres[0], Spheres[0].TileSize, Spheres[0].Stride, BakeParams.CellHeight, BakeParams.MinHeight, BakeParams.MaxHeight, VoxelizationThreadNum, ProfileVoxelization ? &Profiler : nullptr);
+				if (ProfileVoxelization)
+				{
+					printf("%s", Profiler.GetTextReport().c_str());
+					std::ofstream(NavBakePath + ".profile.json") << Profiler.GetJsonReport();
+				}
+				SpanData::getInstance().Compaction(true);
+				SpanData::getInstance().BuildLinks(BakeParams.ClimbHeight);
+				navBake::SaveNavBake(NavBakePath, Spheres, { BakeParams }, SceneHash);
+			}
+			PathService = std::make_unique<PathQueryService>(Spheres[0], PathQueryThreadNum);
+			WalkableComponent = voxelFuncs::getLargestComponent(Spheres[0]);
 
 			// Create program from shaders.
 			m_program = loadProgram("vs_cubes", "fs_cubes");
@@ -295,18 +325,22 @@ namespace
 
 				if (ImGui::Button("Gen Random Point"))
 				{
-					const Span& from = voxelFuncs::getRandomSpan(Spheres[0]);
-					const Span& to = voxelFuncs::getRandomSpan(Spheres[0]);
-					way = voxelFuncs::findWays(from, to, Spheres[0]);
-
-					const Tile& fromTile = Spheres[0].GetTileByIndex(SpanData::getInstance().Data[from.ListIndex].TileIndex);
-					const Tile& toTile = Spheres[0].GetTileByIndex(SpanData::getInstance().Data[to.ListIndex].TileIndex);
-					glm::vec3 axis_y1 = glm::normalize(glm::cross(fromTile.axis_u, fromTile.axis_v));
-					glm::vec3 axis_y2 = glm::normalize(glm::cross(toTile.axis_u, toTile.axis_v));
-
-					fromPos = SpanData::getInstance().Data[from.ListIndex].CenteralWorldPos + (axis_y1 * from.top);
-					toPos	= SpanData::getInstance().Data[to.ListIndex].CenteralWorldPos + (axis_y2 * to.top);
+					//只在最大的连通分量中取点，避免大部分随机请求都没有路径
+					int from = WalkableComponent >= 0 ? voxelFuncs::getRandomSpanIndex(Spheres[0], WalkableComponent) : voxelFuncs::getRandomSpanIndex(Spheres[0]);
+					int to = WalkableComponent >= 0 ? voxelFuncs::getRandomSpanIndex(Spheres[0], WalkableComponent) : voxelFuncs::getRandomSpanIndex(Spheres[0]);
+					//球上没有Span时取不到点
+					if (from >= 0 && to >= 0)
+					{
+						PathService->Submit(from, to, [this](const PathQueryResult& Result)
+						{
+							way = Result.Path;
+							fromPos = PathService->GetSpanTopPos(Result.FromSpan);
+							toPos = PathService->GetSpanTopPos(Result.ToSpan);
+						});
+					}
 				}
+				//寻路在后台线程中进行，这里只执行已经完成的回调，不会等待
+				PathService->DispatchCompleted(PathDispatchBudgetMs);
 
 				ImGui::End();
 				imguiEndFrame();
@@ -386,27 +420,29 @@ namespace
 		void DrawAllVoxel(const uint64_t& state)
 		{
 			auto&& instance = SpanData::getInstance();
-			for (int i = 0; i < instance.Data.size(); i++)
+			auto&& Compact = instance.Compact;
+			for (int i = 0; i < Compact.GetListNum(); i++)
 			{
-				SpanList& List = instance.Data[i];
+				const CompactSpanList& List = Compact.GetList(i);
 				int sphereIndex = 0;
 				for (; sphereIndex < instance.Dictionary.size(); sphereIndex++)
 				{
-					if (instance.Dictionary[sphereIndex].first <= List.SphereIndex && instance.Dictionary[sphereIndex].second >= List.SphereIndex)
+					if (instance.Dictionary[sphereIndex].first <= i && instance.Dictionary[sphereIndex].second >= i)
 					{
 						break;
 					}
 						
 				}
 				const Tile& tile = Spheres[sphereIndex].GetTileByIndex(List.TileIndex);
-				for (int j = 0; j < List.Spans.size(); j++)
+				for (int j = Compact.GetListSpanBegin(i); j < Compact.GetListSpanEnd(i); j++)
 				{
+					const Span& sp = Compact.GetSpan(j);
 					glm::vec3 axis_y = glm::normalize(tile.CenterPos);// (1,0,0)
 
 					glm::mat4 rotationMatrix = glm::mat4(glm::vec4(tile.axis_u, 0), glm::vec4(axis_y, 0), glm::vec4(tile.axis_v, 0), glm::vec4(0, 0, 0, 1));
 
-					glm::vec3 SpanworldPos = List.CenteralWorldPos + (axis_y * (List.Spans[j].bottom + List.Spans[j].top) / 2.0f);
-					float y_scale = (std::abs(List.Spans[j].top - List.Spans[j].bottom));
+					glm::vec3 SpanworldPos = List.CenteralWorldPos + (axis_y * (sp.bottom + sp.top) / 2.0f);
+					float y_scale = (std::abs(sp.top - sp.bottom));
 
 					glm::mat4 matrix = glm::translate(glm::mat4(1.0f), SpanworldPos) *
 						rotationMatrix * glm::scale(glm::mat4(1.0f), glm::vec3(0.5 * 16.0f, 0.5 * y_scale, 0.5 * 16.0f));
@@ -424,7 +460,6 @@ namespace
 		{
 			DebugDrawEncoder dde;
 			dde.begin(0);
-			auto&& instance = SpanData::getInstance();
 			if (way.size() < 1)
 				return;
 
@@ -432,13 +467,8 @@ namespace
 			{
 				dde.push();
 				{
-					const Tile& fromTile = Spheres[0].GetTileByIndex(instance.Data[way[i]->sp->ListIndex].TileIndex);
-					const Tile& toTile =   Spheres[0].GetTileByIndex(instance.Data[way[i + 1]->sp->ListIndex].TileIndex);
-					glm::vec3 axis_y1 = glm::normalize(glm::cross(fromTile.axis_u, fromTile.axis_v));
-					glm::vec3 axis_y2 = glm::normalize(glm::cross(toTile.axis_u, toTile.axis_v));
-
-					glm::vec3 from = instance.Data[way[i]->sp->ListIndex].CenteralWorldPos + (axis_y1 * way[i]->sp->top);
-					glm::vec3 to = instance.Data[way[i+1]->sp->ListIndex].CenteralWorldPos + (axis_y2 * way[i+1]->sp->top);
+					glm::vec3 from = PathService->GetSpanTopPos(way[i]);
+					glm::vec3 to = PathService->GetSpanTopPos(way[i + 1]);
 					float radius = 2.0f;
 					dde.drawCylinder({ from.x,from.y,from.z }, { to.x,to.y,to.z }, radius);
 				}
@@ -467,14 +497,23 @@ namespace
 		uint32_t m_reading;
 		uint32_t m_currFrame;
 
+		int VoxelizationThreadNum = 0;//体素化的线程数，0为使用全部硬件线程
+		size_t VertexCacheBudget = size_t(256) << 20;//体素化时世界坐标顶点缓存的大小（字节）
+		bool ProfileVoxelization = false;//烘焙时输出各阶段的耗时，JSON格式的报告保存在烘焙文件旁边
+		int PathQueryThreadNum = 2;//后台寻路的线程数
+		double PathDispatchBudgetMs = 1.0;//每帧执行寻路回调的时间预算（毫秒）
+		std::string NavBakePath = "D:\\master\\bin\\asset\\Test2\\JsonData2\\scene_596.navbake";
+
 		glm::vec3 fromPos = {0,0,0};
 		glm::vec3 toPos = {0,0,0};
 
-		std::vector<std::shared_ptr<voxelFuncs::wayNode>> way;
+		std::vector<int> way;//路径上每个Span的编号
 
 	private:
 		std::unique_ptr<SceneMgr> SceneMgrPtr;
 		std::vector<SphereMgr> Spheres;
+		std::unique_ptr<PathQueryService> PathService;
+		int WalkableComponent = -1;//随机寻路的起终点所在的连通分量
 	};
 
 
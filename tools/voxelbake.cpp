@@ -0,0 +1,343 @@
+/*
+* 不依赖bgfx与窗口的烘焙工具：加载场景，切分球面，体素化，保存烘焙文件
+* 由CMakeLists.txt中的voxelbake目标构建，链接voxelcore静态库
+* 用法：voxelbake <场景目录> [选项]
+*   --scene-file <文件名>   场景清单，默认scene_596.json
+*   --out <路径>            烘焙文件，默认<场景目录>/<场景清单>.navbake
+*   --center <x,y,z>        球心，默认0,0,0
+*   --radius <R>            默认2000
+*   --tile-size <N>         每个Tile的格子数，默认2
+*   --stride <S>            格子的边长，默认16
+*   --cell-height <H>       默认16
+*   --min-height <H>        默认0
+*   --max-height <H>        默认1000
+*   --climb <H>             相邻Span可以走过去的最大高度差，默认为格子边长的2倍
+*   --hierarchy <N>         N > 0时用N*N个Tile的簇构造抽象图与收缩层次，保存为<烘焙文件>.ch，默认0（不保存）
+*   --threads <N>           加载、生成球与体素化使用的线程数，<= 0时使用硬件线程数，默认0
+*   --vertex-cache <MB>     世界坐标顶点缓存的大小，默认256
+*   --no-mesh-cache         不使用模型的二进制缓存
+*   --pooled-alloc          给Recast安装线性内存与内存池分配器（见ReCastAllocator.h），并在体素化后打印分配统计
+*   --profile <路径>        把体素化各阶段的耗时写入JSON文件，并打印文本报告
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <exception>
+#include <fstream>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "../SceneMgr.h"
+#include "../SphereSegmentation.h"
+#include "../SpanData.h"
+#include "../Voxelization.h"
+#include "../VoxelProfiler.h"
+#include "../NavBake.h"
+#include "../HierarchicalPathFinding.h"
+#include "../PortalHierarchy.h"
+#include "../ReCastAllocator.h"
+
+namespace
+{
+	struct BakeOptions
+	{
+		std::string SceneDirectory;
+		std::string SceneFile = "scene_596.json";
+		std::string OutPath;
+		std::string ProfilePath;
+		NavBakeParams Params;
+		int ThreadNum = 0;
+		int HierarchyClusterTileNum = 0;
+		size_t VertexCacheMB = 256;
+		bool UseMeshCache = true;
+		bool PooledAlloc = false;
+	};
+
+	void PrintUsage()
+	{
+		printf("usage: voxelbake <scene dir> [--scene-file name] [--out path] [--center x,y,z] [--radius R] [--tile-size N]\n"
+			"                 [--stride S] [--cell-height H] [--min-height H] [--max-height H] [--climb H] [--hierarchy N]\n"
+			"                 [--threads N] [--vertex-cache MB] [--no-mesh-cache] [--pooled-alloc] [--profile json]\n");
+	}
+
+	bool ParseOptions(int argc, char** argv, BakeOptions& Options)
+	{
+		Options.Params.Radius = 2000.0f;
+		Options.Params.TileSize = 2;
+		Options.Params.Stride = 16.0f;
+		Options.Params.CellHeight = 16.0f;
+		Options.Params.MinHeight = 0.0f;
+		Options.Params.MaxHeight = 1000.0f;
+		for (int i = 1; i < argc; i++)
+		{
+			std::string Arg = argv[i];
+			bool HasValue = i + 1 < argc;
+			if (Arg == "--no-mesh-cache")
+			{
+				Options.UseMeshCache = false;
+			}
+			else if (Arg == "--pooled-alloc")
+			{
+				Options.PooledAlloc = true;
+			}
+			else if (Arg.compare(0, 2, "--") != 0)
+			{
+				if (!Options.SceneDirectory.empty())
+				{
+					return false;
+				}
+				Options.SceneDirectory = Arg;
+			}
+			else if (!HasValue)
+			{
+				return false;
+			}
+			else if (Arg == "--scene-file")
+			{
+				Options.SceneFile = argv[++i];
+			}
+			else if (Arg == "--out")
+			{
+				Options.OutPath = argv[++i];
+			}
+			else if (Arg == "--profile")
+			{
+				Options.ProfilePath = argv[++i];
+			}
+			else if (Arg == "--center")
+			{
+				glm::vec3& c = Options.Params.Center;
+				if (sscanf(argv[++i], "%f,%f,%f", &c.x, &c.y, &c.z) != 3)
+				{
+					return false;
+				}
+			}
+			else if (Arg == "--radius")
+			{
+				Options.Params.Radius = float(atof(argv[++i]));
+			}
+			else if (Arg == "--tile-size")
+			{
+				Options.Params.TileSize = atoi(argv[++i]);
+			}
+			else if (Arg == "--stride")
+			{
+				Options.Params.Stride = float(atof(argv[++i]));
+			}
+			else if (Arg == "--cell-height")
+			{
+				Options.Params.CellHeight = float(atof(argv[++i]));
+			}
+			else if (Arg == "--min-height")
+			{
+				Options.Params.MinHeight = float(atof(argv[++i]));
+			}
+			else if (Arg == "--max-height")
+			{
+				Options.Params.MaxHeight = float(atof(argv[++i]));
+			}
+			else if (Arg == "--climb")
+			{
+				Options.Params.ClimbHeight = float(atof(argv[++i]));
+			}
+			else if (Arg == "--hierarchy")
+			{
+				Options.HierarchyClusterTileNum = atoi(argv[++i]);
+			}
+			else if (Arg == "--threads")
+			{
+				Options.ThreadNum = atoi(argv[++i]);
+			}
+			else if (Arg == "--vertex-cache")
+			{
+				Options.VertexCacheMB = size_t(atoll(argv[++i]));
+			}
+			else
+			{
+				return false;
+			}
+		}
+		if (Options.SceneDirectory.empty() || Options.Params.Radius <= 0 || Options.Params.TileSize <= 0 || Options.Params.Stride <= 0 || Options.Params.CellHeight <= 0)
+		{
+			return false;
+		}
+		if (Options.Params.ClimbHeight <= 0)
+		{
+			Options.Params.ClimbHeight = 2 * Options.Params.Stride;
+		}
+		if (Options.OutPath.empty())
+		{
+			Options.OutPath = Options.SceneDirectory + PathSeparator + Options.SceneFile + ".navbake";
+		}
+		return true;
+	}
+
+	/*
+	* 进程的峰值常驻内存（MB）
+	*/
+	double GetPeakMemoryMB()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS Counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+		{
+			return Counters.PeakWorkingSetSize / 1048576.0;
+		}
+		return 0;
+#else
+		rusage Usage;
+		if (getrusage(RUSAGE_SELF, &Usage) != 0)
+		{
+			return 0;
+		}
+#ifdef __APPLE__
+		return Usage.ru_maxrss / 1048576.0;//macOS为字节
+#else
+		return Usage.ru_maxrss / 1024.0;//Linux为KB
+#endif
+#endif
+	}
+
+	/*
+	* 计时并打印一个阶段
+	*/
+	class StageTimer
+	{
+	public:
+		explicit StageTimer(const char* Name)
+			:Name(Name), Begin(std::chrono::steady_clock::now())
+		{
+		}
+		~StageTimer()
+		{
+			double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Begin).count();
+			printf("%-12s %10.1f ms   peak memory %.1f MB\n", Name, Seconds * 1e3, GetPeakMemoryMB());
+		}
+	private:
+		const char* Name;
+		std::chrono::steady_clock::time_point Begin;
+	};
+}
+
+int main(int argc, char** argv)
+{
+	BakeOptions Options;
+	if (!ParseOptions(argc, argv, Options))
+	{
+		PrintUsage();
+		return 2;
+	}
+	if (Options.PooledAlloc)
+	{
+		//体素化线程的高度场是thread_local的，线程结束时才释放，所以在第一次调用Recast之前安装并且不再卸载
+		recastAllocator::InstallPooled();
+	}
+	const NavBakeParams& Params = Options.Params;
+	auto TotalBegin = std::chrono::steady_clock::now();
+
+	auto Scene = std::make_unique<SceneMgr>();
+	Scene->UseMeshCache = Options.UseMeshCache;
+	Scene->LoadThreadNum = Options.ThreadNum;
+	try
+	{
+		StageTimer Timer("load scene");
+		Scene->LoadJsonData(Options.SceneDirectory, Options.SceneFile);
+	}
+	catch (const std::exception& e)
+	{
+		fprintf(stderr, "failed to load scene %s%c%s: %s\n", Options.SceneDirectory.c_str(), PathSeparator, Options.SceneFile.c_str(), e.what());
+		return 1;
+	}
+	printf("scene: %zu objects, %zu meshes, %d triangles\n", Scene->MeshObjects.size(), Scene->Meshes.size(), Scene->TriangleNum);
+
+	std::vector<SphereMgr> Spheres(1);
+	{
+		StageTimer Timer("build sphere");
+		glm::vec3 Center = Params.Center;
+		Spheres[0].Build(Center, Params.Radius, Params.TileSize, Params.Stride, int(SpanData::getInstance().Dictionary.size()), Options.ThreadNum);
+	}
+	printf("sphere: %d tiles, %zu span lists\n", Spheres[0].total_tiles_num, SpanData::getInstance().Data.size());
+
+	VoxelProfiler Profiler;
+	int DroppedTileNum = 0;
+	{
+		StageTimer Timer("voxelize");
+		Scene->VertexCache.SetBudget(Options.VertexCacheMB << 20);
+		DroppedTileNum = voxelFuncs::ReCastSphereVoxelization(Scene, Spheres[0], Params.TileSize, Params.Stride, Params.CellHeight, Params.MinHeight, Params.MaxHeight,
+			Options.ThreadNum, Options.ProfilePath.empty() ? nullptr : &Profiler);
+		Scene->VertexCache.SetBudget(0);
+	}
+	if (DroppedTileNum > 0)
+	{
+		fprintf(stderr, "voxelization dropped %d tiles\n", DroppedTileNum);
+		return 1;
+	}
+	if (Options.PooledAlloc)
+	{
+		auto Temp = recastAllocator::GetStats(RC_ALLOC_TEMP);
+		auto Perm = recastAllocator::GetStats(RC_ALLOC_PERM);
+		printf("recast alloc: temp %llu allocs %.1f MB, perm %llu allocs %.1f MB\n", (unsigned long long)Temp.AllocNum, Temp.AllocBytes / 1048576.0,
+			(unsigned long long)Perm.AllocNum, Perm.AllocBytes / 1048576.0);
+	}
+	{
+		StageTimer Timer("compaction");
+		SpanData::getInstance().Compaction(true);
+	}
+	{
+		StageTimer Timer("link spans");
+		SpanData::getInstance().BuildLinks(Params.ClimbHeight);
+	}
+	auto&& Compact = SpanData::getInstance().Compact;
+	printf("spans: %d in %d lists, %.1f MB\n", Compact.GetSpanNum(), Compact.GetListNum(), SpanData::getInstance().GetMemorySize() / 1048576.0);
+	printf("components: %d, largest %d spans\n", Compact.GetComponentNum(), Compact.GetComponentNum() > 0 ? Compact.GetComponentSize(0) : 0);
+
+	{
+		StageTimer Timer("save bake");
+		if (!navBake::SaveNavBake(Options.OutPath, Spheres, { Params }, navBake::HashScene(*Scene)))
+		{
+			fprintf(stderr, "failed to write %s\n", Options.OutPath.c_str());
+			return 1;
+		}
+	}
+	printf("wrote %s\n", Options.OutPath.c_str());
+
+	if (Options.HierarchyClusterTileNum > 0)
+	{
+		//收缩层次以刚写入的烘焙文件的校验和为键，烘焙文件改变后旧的.ch不会被加载
+		uint64_t BakeChecksum = 0;
+		std::string HierarchyPath = Options.OutPath + ".ch";
+		PortalHierarchy Hierarchy;
+		{
+			StageTimer Timer("portal hierarchy");
+			TilePortalGraph Graph(Spheres[0], Options.HierarchyClusterTileNum, Options.ThreadNum);
+			Hierarchy.Build(Graph);
+			printf("portal graph: %d clusters, %d portals, %d edges, %d shortcuts\n", Graph.GetClusterNum(), Graph.GetPortalNum(), Graph.GetEdgeNum(), Hierarchy.GetShortcutNum());
+		}
+		if (!navBake::ReadNavBakeChecksum(Options.OutPath, BakeChecksum) || !Hierarchy.Save(HierarchyPath, BakeChecksum))
+		{
+			fprintf(stderr, "failed to write %s\n", HierarchyPath.c_str());
+			return 1;
+		}
+		printf("wrote %s\n", HierarchyPath.c_str());
+	}
+
+	if (!Options.ProfilePath.empty())
+	{
+		printf("%s", Profiler.GetTextReport().c_str());
+		std::ofstream ProfileFile(Options.ProfilePath);
+		ProfileFile << Profiler.GetJsonReport();
+		if (!ProfileFile)
+		{
+			fprintf(stderr, "failed to write %s\n", Options.ProfilePath.c_str());
+			return 1;
+		}
+	}
+	printf("total %.1f ms, peak memory %.1f MB\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - TotalBegin).count() * 1e3, GetPeakMemoryMB());
+	return 0;
+}
@@ -0,0 +1,1493 @@
+/*
+* 性能测试
+* 用法：voxelbench [--json 结果文件] [测试名...]，不带测试名时运行全部测试
+* 需要场景的测试使用固定随机种子生成的合成场景（写在系统临时目录下），不依赖外部资源
+* --json把每个测试的指标写成JSON，用于比较不同版本
+* 有正确性检查没有通过时在stderr列出并返回1
+*/
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include "nlohmann/json.hpp"
+#include "../SphereSegmentation.h"
+#include "../SpanData.h"
+#include "../SceneMgr.h"
+#include "../SceneBVH.h"
+#include "../Voxelization.h"
+#include "../VertexTransform.h"
+#include "../ReCastAllocator.h"
+#include "../ReCast/Recast.h"
+#include "../PathFinding.h"
+#include "../PathQueryService.h"
+#include "../HierarchicalPathFinding.h"
+#include "../SpanLandmarks.h"
+#include "../PortalHierarchy.h"
+#include "../NavBake.h"
+#include "../FileMapping.h"
+#include "../TaskScheduler.h"
+
+namespace
+{
+	nlohmann::json Results = nlohmann::json::object();
+
+	double SecondsSince(const std::chrono::steady_clock::time_point& begin)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	}
+
+	/*
+	* 记录一个指标，写入--json指定的文件
+	*/
+	void Record(const std::string& Bench, const std::string& Metric, double Value)
+	{
+		Results[Bench][Metric] = Value;
+	}
+
+	/*
+	* 没有通过的正确性检查，不为空时main返回1
+	*/
+	std::vector<std::string> Failures;
+
+	/*
+	* 记录一个正确性检查的结果，返回Passed
+	*/
+	bool Check(const std::string& Bench, const std::string& Name, bool Passed)
+	{
+		if (!Passed)
+		{
+			Failures.emplace_back(Bench + ": " + Name);
+		}
+		return Passed;
+	}
+
+	/*
+	* 旧版本的GetTileByIndex：从最后一行往前找到第一个TileIndex不大于index的行，再逐个比较
+	*/
+	const Tile& GetTileByIndexLinearScan(const SphereMgr& Sphere, int index)
+	{
+		for (int longitudeIndex = int(Sphere.Tiles.size()) - 1; longitudeIndex >= 0; longitudeIndex--)
+		{
+			if (Sphere.Tiles[longitudeIndex][0].TileIndex <= index)
+			{
+				for (int i = 0; i < Sphere.Tiles[longitudeIndex].size(); i++)
+				{
+					if (Sphere.Tiles[longitudeIndex][i].TileIndex == index)
+						return Sphere.Tiles[longitudeIndex][i];
+				}
+			}
+		}
+		return Sphere.Tiles[0][0];
+	}
+
+	/*
+	* 比较线性查找与FlatTiles查表的GetTileByIndex
+	*/
+	void BenchTileLookup()
+	{
+		SpanData::getInstance().Clear();
+		SphereMgr Sphere;
+		glm::vec3 Center(0, 0, 0);
+		Sphere.Build(Center, 2000.0f, 2, 16.0f, int(SpanData::getInstance().Dictionary.size()));
+
+		const int LookupNum = 200000;
+		std::mt19937 Random(1);
+		std::uniform_int_distribution<int> Dist(0, Sphere.total_tiles_num - 1);
+		std::vector<int> Indices(LookupNum);
+		for (auto&& i : Indices)
+		{
+			i = Dist(Random);
+		}
+
+		float Sum = 0;
+		auto Begin = std::chrono::steady_clock::now();
+		for (int i : Indices)
+		{
+			Sum += GetTileByIndexLinearScan(Sphere, i).CenterPos.x;
+		}
+		double LinearTime = SecondsSince(Begin);
+
+		Begin = std::chrono::steady_clock::now();
+		for (int i : Indices)
+		{
+			Sum -= Sphere.GetTileByIndex(i).CenterPos.x;
+		}
+		double FlatTime = SecondsSince(Begin);
+
+		printf("TileLookup: tiles %d, linear scan %.1f ns/lookup, flat table %.2f ns/lookup, speedup %.0fx (check %g)\n",
+			Sphere.total_tiles_num, LinearTime * 1e9 / LookupNum, FlatTime * 1e9 / LookupNum, LinearTime / FlatTime, Sum);
+		Record("TileLookup", "linear_ns_per_lookup", LinearTime * 1e9 / LookupNum);
+		Record("TileLookup", "flat_ns_per_lookup", FlatTime * 1e9 / LookupNum);
+	}
+
+	/*
+	* 在球面附近随机摆放ObjectNum个模型，只填写MeshObjects的世界AABB
+	*/
+	std::vector<MeshObject> MakeRandomObjects(int ObjectNum, float Radius, unsigned Seed)
+	{
+		std::vector<MeshObject> Objects(ObjectNum);
+		std::mt19937 Random(Seed);
+		std::uniform_real_distribution<float> Dist(-1.0f, 1.0f);
+		for (auto&& o : Objects)
+		{
+			glm::vec3 Dir;
+			do
+			{
+				Dir = glm::vec3(Dist(Random), Dist(Random), Dist(Random));
+			} while (glm::length(Dir) < 0.1f);
+			o.WorldPos = glm::normalize(Dir) * (Radius + 50.0f * Dist(Random));
+			o.scale = glm::vec3(10.0f + 5.0f * Dist(Random), 10.0f + 5.0f * Dist(Random), 10.0f + 5.0f * Dist(Random));
+			o.WorldMin = o.WorldPos - o.scale;
+			o.WorldMax = o.WorldPos + o.scale;
+		}
+		return Objects;
+	}
+
+	/*
+	* 比较逐个判断与BVH查询与每个Tile相交的模型
+	*/
+	void BenchBVHQuery()
+	{
+		const float Radius = 2000.0f;
+		const int TileSize = 2;
+		const float Stride = 16.0f;
+		const float MaxHeight = 1000.0f;
+		std::vector<MeshObject> Objects = MakeRandomObjects(100000, Radius, 1);
+
+		SpanData::getInstance().Clear();
+		SphereMgr Sphere;
+		glm::vec3 Center(0, 0, 0);
+		Sphere.Build(Center, Radius, TileSize, Stride, int(SpanData::getInstance().Dictionary.size()));
+		//逐个判断太慢，每隔TileStep个Tile取一个
+		const int TileStep = 10;
+		std::vector<glm::vec3> TileMin, TileMax;
+		for (int i = 0; i < Sphere.FlatTiles.size(); i += TileStep)
+		{
+			const Tile& t = Sphere.FlatTiles[i];
+			auto&& [Min, Max] = voxelFuncs::GetTileWorldAABB(t, MaxHeight, TileSize, Stride);
+			TileMin.emplace_back(Min);
+			TileMax.emplace_back(Max);
+		}
+
+		auto Begin = std::chrono::steady_clock::now();
+		MeshObjectBVH BVH;
+		BVH.Build(Objects);
+		double BuildTime = SecondsSince(Begin);
+
+		size_t LinearHits = 0;
+		Begin = std::chrono::steady_clock::now();
+		for (int t = 0; t < TileMin.size(); t++)
+		{
+			for (auto&& o : Objects)
+			{
+				LinearHits += voxelFuncs::wetherAABBIntersect(o.WorldMin, o.WorldMax, TileMin[t], TileMax[t]);
+			}
+		}
+		double LinearTime = SecondsSince(Begin);
+
+		size_t BVHHits = 0;
+		std::vector<int> Result;
+		Begin = std::chrono::steady_clock::now();
+		for (int t = 0; t < TileMin.size(); t++)
+		{
+			Result.clear();
+			BVH.Query(TileMin[t], TileMax[t], Result);
+			BVHHits += Result.size();
+		}
+		double BVHTime = SecondsSince(Begin);
+
+		printf("BVHQuery: objects %zu, tiles %zu, nodes %d, build %.1f ms, linear scan %.1f ms, bvh %.1f ms, speedup %.0fx, hits %zu/%zu\n",
+			Objects.size(), TileMin.size(), BVH.GetNodeNum(), BuildTime * 1e3, LinearTime * 1e3, BVHTime * 1e3, LinearTime / BVHTime, BVHHits, LinearHits);
+		Record("BVHQuery", "build_ms", BuildTime * 1e3);
+		Record("BVHQuery", "linear_us_per_tile", LinearTime * 1e6 / TileMin.size());
+		Record("BVHQuery", "bvh_us_per_tile", BVHTime * 1e6 / TileMin.size());
+	}
+
+	/*
+	* 比较原来逐个顶点用glm做两次变换并emplace_back的写法与各指令集的批量变换
+	*/
+	void BenchVertexTransform()
+	{
+		const int VertexNum = 1 << 20;
+		const int Repeat = 20;
+		std::mt19937 Random(1);
+		std::uniform_real_distribution<float> Dist(-100.0f, 100.0f);
+		std::vector<glm::vec3> Vertices(VertexNum);
+		for (auto&& v : Vertices)
+		{
+			v = glm::vec3(Dist(Random), Dist(Random), Dist(Random));
+		}
+		glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(1500, 800, -300)) * glm::toMat4(glm::quat(0.9f, 0.1f, 0.3f, 0.2f)) * glm::scale(glm::mat4(1.0f), glm::vec3(2, 3, 4));
+		glm::vec3 TileCenter(1490, 790, -310);
+		glm::vec3 axis_u(1, 0, 0), axis_y(0, 1, 0), axis_v(0, 0, 1);
+		glm::mat4 matrix = glm::transpose(glm::mat4(glm::vec4(axis_u, 0), glm::vec4(axis_y, 0), glm::vec4(axis_v, 0), glm::vec4(0, 0, 0, 1)));
+
+		std::vector<float> Reference;
+		auto Begin = std::chrono::steady_clock::now();
+		for (int r = 0; r < Repeat; r++)
+		{
+			std::vector<float> vecs;
+			vecs.reserve(Vertices.size() * 3);
+			for (int index = 0; index < Vertices.size(); index++)
+			{
+				glm::vec3 worldPos = m * glm::vec4(Vertices[index], 1.0f);
+				glm::vec3 newPos = matrix * glm::vec4(worldPos - TileCenter, 1.0f);
+				vecs.emplace_back(newPos.x);
+				vecs.emplace_back(newPos.y);
+				vecs.emplace_back(newPos.z);
+			}
+			Reference.swap(vecs);
+		}
+		double GlmTime = SecondsSince(Begin);
+		printf("VertexTransform: vertices %d, glm %.2f ns/vertex\n", VertexNum, GlmTime * 1e9 / VertexNum / Repeat);
+		Record("VertexTransform", "glm_ns_per_vertex", GlmTime * 1e9 / VertexNum / Repeat);
+
+		using vertexTransform::TransformKernel;
+		std::vector<float> vecs(Vertices.size() * 3);
+		for (TransformKernel Kernel : { TransformKernel::Scalar, TransformKernel::SSE, TransformKernel::AVX2 })
+		{
+			if (!vertexTransform::IsKernelSupported(Kernel))
+			{
+				printf("  %s: not supported\n", vertexTransform::GetKernelName(Kernel));
+				continue;
+			}
+			Begin = std::chrono::steady_clock::now();
+			for (int r = 0; r < Repeat; r++)
+			{
+				vertexTransform::TransformPoints(Kernel, m, &Vertices[0].x, VertexNum, vecs.data());
+				vertexTransform::TransformPoints(Kernel, matrix, vecs.data(), VertexNum, vecs.data(), TileCenter);
+			}
+			double Time = SecondsSince(Begin);
+			bool Same = Check("VertexTransform", vertexTransform::GetKernelName(Kernel), memcmp(vecs.data(), Reference.data(), vecs.size() * sizeof(float)) == 0);
+			printf("  %s: %.2f ns/vertex, speedup %.1fx, %s\n", vertexTransform::GetKernelName(Kernel), Time * 1e9 / VertexNum / Repeat, GlmTime / Time, Same ? "identical" : "MISMATCH");
+			Record("VertexTransform", std::string(vertexTransform::GetKernelName(Kernel)) + "_ns_per_vertex", Time * 1e9 / VertexNum / Repeat);
+		}
+	}
+
+	/*
+	* 在一块起伏的地形上执行一遍完整的Recast流程（区域、轮廓、多边形、细节网格），返回多边形数
+	*/
+	int BuildRecastTile(const std::vector<float>& Vertices, const std::vector<int>& Triangles, const std::vector<unsigned char>& Areas, float Extent)
+	{
+		rcContext Context(false);
+		const float cs = 0.3f;
+		const float ch = 0.2f;
+		const int WalkableHeight = 10;
+		const int WalkableClimb = 4;
+		float Min[3] = { 0, -10, 0 };
+		float Max[3] = { Extent, 10, Extent };
+		int Width = 0, Height = 0;
+		rcCalcGridSize(Min, Max, cs, &Width, &Height);
+
+		rcHeightfield* Solid = rcAllocHeightfield();
+		rcCreateHeightfield(&Context, *Solid, Width, Height, Min, Max, cs, ch);
+		rcRasterizeTriangles(&Context, Vertices.data(), int(Vertices.size() / 3), Triangles.data(), Areas.data(), int(Triangles.size() / 3), *Solid, WalkableClimb);
+		rcFilterLowHangingWalkableObstacles(&Context, WalkableClimb, *Solid);
+		rcFilterLedgeSpans(&Context, WalkableHeight, WalkableClimb, *Solid);
+		rcFilterWalkableLowHeightSpans(&Context, WalkableHeight, *Solid);
+
+		rcCompactHeightfield* Compact = rcAllocCompactHeightfield();
+		rcBuildCompactHeightfield(&Context, WalkableHeight, WalkableClimb, *Solid, *Compact);
+		rcFreeHeightField(Solid);
+		rcErodeWalkableArea(&Context, 2, *Compact);
+		rcBuildDistanceField(&Context, *Compact);
+		rcBuildRegions(&Context, *Compact, 0, 8, 20);
+
+		rcContourSet* Contours = rcAllocContourSet();
+		rcBuildContours(&Context, *Compact, 1.3f, 40, *Contours);
+		rcPolyMesh* PolyMesh = rcAllocPolyMesh();
+		rcBuildPolyMesh(&Context, *Contours, 6, *PolyMesh);
+		rcPolyMeshDetail* DetailMesh = rcAllocPolyMeshDetail();
+		rcBuildPolyMeshDetail(&Context, *PolyMesh, *Compact, 1.8f, 0.2f, *DetailMesh);
+		int PolyNum = PolyMesh->npolys;
+
+		rcFreePolyMeshDetail(DetailMesh);
+		rcFreePolyMesh(PolyMesh);
+		rcFreeContourSet(Contours);
+		rcFreeCompactHeightfield(Compact);
+		recastAllocator::ResetTempArena();
+		return PolyNum;
+	}
+
+	/*
+	* 比较malloc与线性内存+内存池分配器下完整Recast流程的耗时，并输出每种rcAllocHint的统计
+	*/
+	void BenchRecastAlloc()
+	{
+		const int GridNum = 128;
+		const float Extent = 64.0f;
+		const int Repeat = 10;
+		std::vector<float> Vertices;
+		std::vector<int> Triangles;
+		for (int z = 0; z <= GridNum; z++)
+		{
+			for (int x = 0; x <= GridNum; x++)
+			{
+				float px = Extent * x / GridNum;
+				float pz = Extent * z / GridNum;
+				Vertices.insert(Vertices.end(), { px, 2.0f * sinf(px * 0.3f) * cosf(pz * 0.2f) + (((x / 16 + z / 16) % 3 == 0) ? 3.0f : 0.0f), pz });
+			}
+		}
+		for (int z = 0; z < GridNum; z++)
+		{
+			for (int x = 0; x < GridNum; x++)
+			{
+				int v = z * (GridNum + 1) + x;
+				Triangles.insert(Triangles.end(), { v, v + GridNum + 1, v + 1, v + 1, v + GridNum + 1, v + GridNum + 2 });
+			}
+		}
+		std::vector<unsigned char> Areas(Triangles.size() / 3, RC_WALKABLE_AREA);
+
+		//两种分配器交替运行几轮，取每种最快的一轮，减少机器负载波动的影响
+		const char* Names[2] = { "malloc", "pooled" };
+		const int Rounds = 5;
+		double Times[2] = { 1e30, 1e30 };
+		for (int Round = 0; Round < Rounds; Round++)
+		{
+			for (int Mode = 0; Mode < 2; Mode++)
+			{
+				if (Mode == 0)
+				{
+					recastAllocator::InstallCountingMalloc();
+				}
+				else
+				{
+					recastAllocator::InstallPooled();
+				}
+				recastAllocator::ResetStats();
+				int PolyNum = 0;
+				auto Begin = std::chrono::steady_clock::now();
+				for (int r = 0; r < Repeat; r++)
+				{
+					PolyNum = BuildRecastTile(Vertices, Triangles, Areas, Extent);
+				}
+				Times[Mode] = std::min(Times[Mode], SecondsSince(Begin));
+				auto Temp = recastAllocator::GetStats(RC_ALLOC_TEMP);
+				auto Perm = recastAllocator::GetStats(RC_ALLOC_PERM);
+				recastAllocator::Uninstall();
+				if (Round == Rounds - 1)
+				{
+					printf("RecastAlloc %s: %.2f ms/tile, polys %d, per tile temp %llu allocs %.1f KB, perm %llu allocs %.1f KB, frees %llu/%llu\n",
+						Names[Mode], Times[Mode] * 1e3 / Repeat, PolyNum,
+						(unsigned long long)(Temp.AllocNum / Repeat), Temp.AllocBytes / 1024.0 / Repeat,
+						(unsigned long long)(Perm.AllocNum / Repeat), Perm.AllocBytes / 1024.0 / Repeat,
+						(unsigned long long)(Temp.FreeNum + Perm.FreeNum), (unsigned long long)(Temp.AllocNum + Perm.AllocNum));
+				}
+			}
+		}
+		printf("RecastAlloc: speedup %.2fx, temp arena %.1f MB\n", Times[0] / Times[1], recastAllocator::GetTempArenaCapacity() / 1048576.0);
+		Record("RecastAlloc", "malloc_ms_per_tile", Times[0] * 1e3 / Repeat);
+		Record("RecastAlloc", "pooled_ms_per_tile", Times[1] * 1e3 / Repeat);
+	}
+
+	/*
+	* 合成场景的参数，相同的参数与种子生成完全相同的场景
+	*/
+	struct SyntheticSceneDesc
+	{
+		int ObjectNum = 3000;
+		int MeshNum = 32;
+		float Radius = 2000.0f;
+		unsigned Seed = 1;
+	};
+
+	/*
+	* 每个面分成Subdiv * Subdiv个格子的单位立方体，面上加一点起伏
+	*/
+	void MakeSyntheticMesh(int Subdiv, std::mt19937& Random, nlohmann::json& MeshJson)
+	{
+		std::uniform_real_distribution<float> Noise(-0.05f, 0.05f);
+		nlohmann::json Vertices = nlohmann::json::array();
+		nlohmann::json Indices = nlohmann::json::array();
+		for (int Face = 0; Face < 6; Face++)
+		{
+			int Axis = Face / 2;
+			float Sign = Face % 2 ? 1.0f : -1.0f;
+			int Base = int(Vertices.size());
+			for (int j = 0; j <= Subdiv; j++)
+			{
+				for (int i = 0; i <= Subdiv; i++)
+				{
+					float p[3];
+					p[Axis] = Sign * (1.0f + Noise(Random));
+					p[(Axis + 1) % 3] = -1.0f + 2.0f * i / Subdiv;
+					p[(Axis + 2) % 3] = -1.0f + 2.0f * j / Subdiv;
+					Vertices.push_back({ p[0], p[1], p[2] });
+				}
+			}
+			for (int j = 0; j < Subdiv; j++)
+			{
+				for (int i = 0; i < Subdiv; i++)
+				{
+					int v = Base + j * (Subdiv + 1) + i;
+					Indices.insert(Indices.end(), { v, v + 1, v + Subdiv + 1, v + 1, v + Subdiv + 2, v + Subdiv + 1 });
+				}
+			}
+		}
+		MeshJson["vertices"] = Vertices;
+		MeshJson["indices"] = Indices;
+	}
+
+	/*
+	* 生成场景目录：scene_596.json与m/mesh_<i>.json，模型摆放在球面附近，y轴朝向球面法线
+	* 返回所有文件的总字节数
+	*/
+	size_t WriteSyntheticScene(const std::filesystem::path& Directory, const SyntheticSceneDesc& Desc)
+	{
+		std::filesystem::create_directories(Directory / "m");
+		std::mt19937 Random(Desc.Seed);
+		size_t Bytes = 0;
+		for (int i = 0; i < Desc.MeshNum; i++)
+		{
+			nlohmann::json MeshJson;
+			MakeSyntheticMesh(8 + i % 16, Random, MeshJson);
+			std::string Text = MeshJson.dump();
+			std::ofstream(Directory / "m" / ("mesh_" + std::to_string(i) + ".json"), std::ios::binary) << Text;
+			Bytes += Text.size();
+		}
+
+		std::uniform_real_distribution<float> Dist(-1.0f, 1.0f);
+		nlohmann::json Objects = nlohmann::json::array();
+		for (int i = 0; i < Desc.ObjectNum; i++)
+		{
+			glm::vec3 Dir;
+			do
+			{
+				Dir = glm::vec3(Dist(Random), Dist(Random), Dist(Random));
+			} while (glm::length(Dir) < 0.1f);
+			Dir = glm::normalize(Dir);
+			glm::vec3 Pos = Dir * (Desc.Radius + 20.0f * Dist(Random));
+			//把y轴转到Dir的四元数
+			glm::vec3 Axis = glm::cross(glm::vec3(0, 1, 0), Dir);
+			glm::quat q = glm::normalize(glm::quat(1.0f + Dir.y, Axis.x, Axis.y, Axis.z));
+			//模型大致铺满球面，相互重叠形成高低不同的多层地面
+			float Scale = 80.0f + 40.0f * Dist(Random);
+			Objects.push_back({
+				{ "meshPath", "m/mesh_" + std::to_string(int(Random() % Desc.MeshNum)) + ".json" },
+				{ "worldPos", { Pos.x, Pos.y, Pos.z } },
+				{ "worldQuat", { q.x, q.y, q.z, q.w } },
+				{ "scale", { Scale, Scale * 0.1f, Scale } } });
+		}
+		nlohmann::json SceneJson;
+		SceneJson["mesh"] = Objects;
+		std::string Text = SceneJson.dump();
+		std::ofstream(Directory / "scene_596.json", std::ios::binary) << Text;
+		return Bytes + Text.size();
+	}
+
+	std::filesystem::path GetSyntheticSceneDirectory()
+	{
+		return std::filesystem::temp_directory_path() / "voxelbench_scene";
+	}
+
+	/*
+	* 写出默认的合成场景（只写一次）并加载
+	*/
+	std::unique_ptr<SceneMgr> LoadSyntheticScene()
+	{
+		static bool Written = false;
+		std::filesystem::path Directory = GetSyntheticSceneDirectory();
+		if (!Written)
+		{
+			std::filesystem::remove_all(Directory);
+			WriteSyntheticScene(Directory, SyntheticSceneDesc());
+			Written = true;
+		}
+		auto Scene = std::make_unique<SceneMgr>();
+		Scene->UseMeshCache = false;
+		Scene->LoadJsonData(Directory.string());
+		return Scene;
+	}
+
+	/*
+	* LoadJsonData的解析速度：不使用模型缓存（解析JSON）与使用已经生成的模型缓存
+	*/
+	void BenchLoadJsonData()
+	{
+		std::filesystem::path Directory = GetSyntheticSceneDirectory();
+		std::filesystem::remove_all(Directory);
+		size_t Bytes = WriteSyntheticScene(Directory, SyntheticSceneDesc());
+		std::filesystem::create_directories(Directory / "cache");
+
+		const char* Names[3] = { "json", "cache_cold", "cache_warm" };
+		for (int Mode = 0; Mode < 3; Mode++)
+		{
+			SceneMgr Scene;
+			Scene.UseMeshCache = Mode > 0;
+			Scene.MeshCacheDirectory = (Directory / "cache").string();
+			auto Begin = std::chrono::steady_clock::now();
+			Scene.LoadJsonData(Directory.string());
+			double Time = SecondsSince(Begin);
+			printf("LoadJsonData %s: %.1f ms, %.1f MB/s of json, %.2f M triangles/s (objects %zu, meshes %zu, triangles %d)\n",
+				Names[Mode], Time * 1e3, Bytes / 1048576.0 / Time, Scene.TriangleNum / 1e6 / Time, Scene.MeshObjects.size(), Scene.Meshes.size(), Scene.TriangleNum);
+			Record("LoadJsonData", std::string(Names[Mode]) + "_ms", Time * 1e3);
+			Record("LoadJsonData", std::string(Names[Mode]) + "_mb_per_s", Bytes / 1048576.0 / Time);
+		}
+		std::filesystem::remove_all(Directory / "cache");
+	}
+
+	/*
+	* 不同半径与格子大小下SphereMgr::Build的耗时，并检查邻居关系是对称的
+	*/
+	void BenchSphereBuild()
+	{
+		const float Radii[] = { 1000.0f, 2000.0f, 4000.0f };
+		const float Strides[] = { 16.0f, 32.0f };
+		for (float Radius : Radii)
+		{
+			for (float Stride : Strides)
+			{
+				SpanData::getInstance().Clear();
+				SphereMgr Sphere;
+				glm::vec3 Center(0, 0, 0);
+				auto Begin = std::chrono::steady_clock::now();
+				Sphere.Build(Center, Radius, 2, Stride, 0);
+				double Time = SecondsSince(Begin);
+				NeighborSymmetryReport Report = Sphere.CheckNeighborSymmetry();
+				printf("SphereBuild: radius %.0f, stride %.0f, tiles %d, span lists %zu, %.1f ms, %.2f us/span list, asymmetric edges %d/%d, invalid %d\n",
+					Radius, Stride, Sphere.total_tiles_num, SpanData::getInstance().Data.size(), Time * 1e3, Time * 1e6 / SpanData::getInstance().Data.size(),
+					Report.AsymmetricNum, Report.EdgeNum, Report.InvalidNum);
+				char Metric[64];
+				snprintf(Metric, sizeof(Metric), "r%.0f_s%.0f_ms", Radius, Stride);
+				Record("SphereBuild", Metric, Time * 1e3);
+				snprintf(Metric, sizeof(Metric), "r%.0f_s%.0f_asymmetric_edges", Radius, Stride);
+				Record("SphereBuild", Metric, Report.AsymmetricNum);
+				snprintf(Metric, sizeof(Metric), "r%.0f_s%.0f neighbors symmetric", Radius, Stride);
+				Check("SphereBuild", Metric, Report.AsymmetricNum == 0 && Report.InvalidNum == 0 && Report.SelfNum == 0);
+			}
+		}
+		SpanData::getInstance().Clear();
+	}
+
+	/*
+	* 单线程与多线程SphereMgr::Build的耗时，并检查两者生成的SpanList完全相同
+	*/
+	void BenchParallelSphereBuild()
+	{
+		auto HashLists = []()
+		{
+			uint64_t Hash = HashBytes(nullptr, 0);
+			for (auto&& List : SpanData::getInstance().Data)
+			{
+				Hash = HashBytes(List.neighborsIndex.data(), List.neighborsIndex.size() * sizeof(int), Hash);
+				Hash = HashBytes(&List.CenteralWorldPos, sizeof(List.CenteralWorldPos), Hash);
+				Hash = HashBytes(&List.TileIndex, sizeof(int), Hash);
+			}
+			return Hash;
+		};
+		const float Radii[] = { 2000.0f, 20000.0f };
+		const int ThreadNums[] = { 1, 0 };
+		for (float Radius : Radii)
+		{
+			uint64_t Hashes[2] = {};
+			double Times[2] = {};
+			for (int t = 0; t < 2; t++)
+			{
+				SpanData::getInstance().Clear();
+				SphereMgr Sphere;
+				glm::vec3 Center(0, 0, 0);
+				auto Begin = std::chrono::steady_clock::now();
+				Sphere.Build(Center, Radius, 2, 16.0f, 0, ThreadNums[t]);
+				Times[t] = SecondsSince(Begin);
+				Hashes[t] = HashLists();
+			}
+			printf("ParallelSphereBuild: radius %.0f, span lists %zu, 1 thread %.1f ms, %d threads %.1f ms, speedup %.2fx, %s\n",
+				Radius, SpanData::getInstance().Data.size(), Times[0] * 1e3, WorkStealingScheduler::ResolveThreadNum(0), Times[1] * 1e3, Times[0] / Times[1],
+				Check("ParallelSphereBuild", "same span lists", Hashes[0] == Hashes[1]) ? "identical" : "MISMATCH");
+			char Metric[64];
+			snprintf(Metric, sizeof(Metric), "r%.0f_single_ms", Radius);
+			Record("ParallelSphereBuild", Metric, Times[0] * 1e3);
+			snprintf(Metric, sizeof(Metric), "r%.0f_parallel_ms", Radius);
+			Record("ParallelSphereBuild", Metric, Times[1] * 1e3);
+		}
+		SpanData::getInstance().Clear();
+	}
+
+	/*
+	* 单线程对合成场景的Tile调用ReCastSingleTileReCast，每TileStep个Tile取一个
+	*/
+	void BenchTileRecast()
+	{
+		auto Scene = LoadSyntheticScene();
+		SpanData::getInstance().Clear();
+		SphereMgr Sphere;
+		glm::vec3 Center(0, 0, 0);
+		Sphere.Build(Center, 2000.0f, 2, 16.0f, 0);
+		const int TileStep = 10;
+		int TileNum = 0;
+		auto Begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < Sphere.FlatTiles.size(); i += TileStep)
+		{
+			voxelFuncs::ReCastSingleTileReCast(Sphere.FlatTiles[i], Scene, Sphere, Sphere.TileSize, Sphere.Stride, 16.0f, 0.0f, 1000.0f);
+			TileNum++;
+		}
+		double Time = SecondsSince(Begin);
+		size_t SpanNum = 0;
+		for (auto&& List : SpanData::getInstance().Data)
+		{
+			SpanNum += List.Spans.size();
+		}
+		printf("TileRecast: tiles %d, %.1f ms, %.2f us/tile, spans %zu\n", TileNum, Time * 1e3, Time * 1e6 / TileNum, SpanNum);
+		Record("TileRecast", "us_per_tile", Time * 1e6 / TileNum);
+		Record("TileRecast", "spans", double(SpanNum));
+		SpanData::getInstance().Clear();
+	}
+
+	/*
+	* rcRasterizeTriangles的吞吐量：随机的小三角形光栅化到64x64的高度场
+	*/
+	void BenchRasterize()
+	{
+		const int TriangleNum = 200000;
+		const int Repeat = 5;
+		std::mt19937 Random(1);
+		std::uniform_real_distribution<float> Pos(0.0f, 64.0f);
+		std::uniform_real_distribution<float> Offset(-2.0f, 2.0f);
+		std::vector<float> Vertices;
+		std::vector<int> Indices;
+		for (int i = 0; i < TriangleNum; i++)
+		{
+			float x = Pos(Random), y = Pos(Random) * 0.25f, z = Pos(Random);
+			for (int v = 0; v < 3; v++)
+			{
+				Vertices.insert(Vertices.end(), { x + Offset(Random), y + Offset(Random), z + Offset(Random) });
+				Indices.emplace_back(i * 3 + v);
+			}
+		}
+		std::vector<unsigned char> Areas(TriangleNum, RC_WALKABLE_AREA);
+
+		rcContext Context(false);
+		rcHeightfield HeightField;
+		float Min[3] = { 0, 0, 0 };
+		float Max[3] = { 64, 32, 64 };
+		double Best = 1e30;
+		for (int r = 0; r < Repeat; r++)
+		{
+			rcResetHeightfield(&Context, HeightField, 64, 64, Min, Max, 1.0f, 0.25f);
+			auto Begin = std::chrono::steady_clock::now();
+			rcRasterizeTriangles(&Context, Vertices.data(), int(Vertices.size() / 3), Indices.data(), Areas.data(), TriangleNum, HeightField, 1);
+			Best = std::min(Best, SecondsSince(Begin));
+		}
+		printf("Rasterize: triangles %d, %.2f M triangles/s\n", TriangleNum, TriangleNum / 1e6 / Best);
+		Record("Rasterize", "mtris_per_s", TriangleNum / 1e6 / Best);
+	}
+
+	/*
+	* 从Start沿着可以走的邻居随机走Steps步，返回终点（用于生成一定有路径的查询）
+	*/
+	const Span* RandomWalk(const Span* Start, int Steps, float Climb, std::mt19937& Random)
+	{
+		auto&& Data = SpanData::getInstance().Data;
+		const Span* Current = Start;
+		std::vector<const Span*> Candidates;
+		for (int i = 0; i < Steps; i++)
+		{
+			Candidates.clear();
+			for (int NeighborList : Data[Current->ListIndex].neighborsIndex)
+			{
+				for (auto&& sp : Data[NeighborList].Spans)
+				{
+					if (std::abs(sp.top - Current->top) <= Climb)
+					{
+						Candidates.emplace_back(&sp);
+					}
+				}
+			}
+			if (Candidates.empty())
+			{
+				break;
+			}
+			Current = Candidates[Random() % Candidates.size()];
+		}
+		return Current;
+	}
+
+	/*
+	* 体素化合成场景，压缩并建立Span连接，SpanData中保留Data与Compact两份数据
+	*/
+	void BakeSyntheticSphere(SphereMgr& Sphere)
+	{
+		auto Scene = LoadSyntheticScene();
+		SpanData::getInstance().Clear();
+		glm::vec3 Center(0, 0, 0);
+		Sphere.Build(Center, 2000.0f, 2, 16.0f, 0);
+		int DroppedTileNum = voxelFuncs::ReCastSphereVoxelization(Scene, Sphere, Sphere.TileSize, Sphere.Stride, 16.0f, 0.0f, 1000.0f, 0);
+		Check("Voxelization", "no dropped tiles", DroppedTileNum == 0);
+		SpanData::getInstance().Compaction();
+		SpanData::getInstance().BuildLinks(2 * Sphere.Stride);
+	}
+
+	/*
+	* 随机起点，随机走WalkSteps步得到终点，保证大部分查询都有路径
+	*/
+	std::vector<std::pair<const Span*, const Span*>> MakeRandomWalkQueries(const SphereMgr& Sphere, int QueryNum, int WalkSteps, unsigned Seed)
+	{
+		std::mt19937 Random(Seed);
+		std::vector<std::pair<const Span*, const Span*>> Queries;
+		std::vector<const Span*> AllSpans;
+		for (auto&& List : SpanData::getInstance().Data)
+		{
+			for (auto&& sp : List.Spans)
+			{
+				AllSpans.emplace_back(&sp);
+			}
+		}
+		while (!AllSpans.empty() && Queries.size() < QueryNum)
+		{
+			const Span* From = AllSpans[Random() % AllSpans.size()];
+			Queries.emplace_back(From, RandomWalk(From, WalkSteps, 2 * Sphere.Stride, Random));
+		}
+		return Queries;
+	}
+
+	/*
+	* Data中的Span转换为Compact中的Span编号：Span在所属SpanList中的位置不变
+	*/
+	int ToSpanIndex(const Span* sp)
+	{
+		auto&& instance = SpanData::getInstance();
+		return instance.Compact.GetListSpanBegin(sp->ListIndex) + int(sp - instance.Data[sp->ListIndex].Spans.data());
+	}
+
+	/*
+	* SpanData与球中写入烘焙文件的数据，每一段按字节保存，用于比较保存前与加载后的数据
+	*/
+	std::vector<std::vector<uint8_t>> SnapshotBakeData(const std::vector<SphereMgr>& Spheres)
+	{
+		auto&& instance = SpanData::getInstance();
+		auto&& Compact = instance.Compact;
+		std::vector<std::vector<uint8_t>> Sections;
+		auto Add = [&Sections](const void* Data, size_t Size)
+		{
+			const uint8_t* Bytes = static_cast<const uint8_t*>(Data);
+			Sections.emplace_back(Bytes, Bytes + Size);
+		};
+		size_t ListNum = Compact.GetListNum();
+		size_t SpanNum = Compact.GetSpanNum();
+		Add(instance.Dictionary.data(), instance.Dictionary.size() * sizeof(std::pair<int, int>));
+		Add(Compact.GetSpanOffsets(), (ListNum + 1) * sizeof(int));
+		Add(Compact.GetLists(), ListNum * sizeof(CompactSpanList));
+		Add(Compact.GetExtraNeighborOffsets(), (ListNum + 1) * sizeof(int));
+		Add(Compact.GetExtraNeighbors(), Compact.GetExtraNeighborNum() * sizeof(int));
+		Add(Compact.GetSpans(), SpanNum * sizeof(Span));
+		Add(Compact.GetLinkOffsets(), (SpanNum + 1) * sizeof(int));
+		Add(Compact.GetLinkSpans(), Compact.GetLinkNum() * sizeof(int));
+		Add(Compact.GetSpanComponents(), SpanNum * sizeof(int));
+		Add(Compact.GetComponentSizes(), Compact.GetComponentNum() * sizeof(int));
+		for (auto&& Sphere : Spheres)
+		{
+			float Params[5] = { Sphere.CenterPos.x, Sphere.CenterPos.y, Sphere.CenterPos.z, Sphere.Radius, Sphere.Stride };
+			int Sizes[3] = { Sphere.TileSize, Sphere.SphereId, Sphere.total_tiles_num };
+			Add(Params, sizeof(Params));
+			Add(Sizes, sizeof(Sizes));
+			Add(Sphere.RowBeginIndex.data(), Sphere.RowBeginIndex.size() * sizeof(int));
+			for (auto&& t : Sphere.FlatTiles)
+			{
+				glm::vec3 Vectors[3] = { t.CenterPos, t.axis_u, t.axis_v };
+				int Indices[3] = { t.TileIndex, t.RowIndex, t.ColIndex };
+				Add(Vectors, sizeof(Vectors));
+				Add(Indices, sizeof(Indices));
+			}
+		}
+		return Sections;
+	}
+
+	/*
+	* 合成场景烘焙文件的保存与加载耗时，并检查加载后的Span、连接、连通分量与Tile与保存前完全相同
+	* 参数不同、场景哈希不同与数据段损坏的文件都不能加载，加载失败时SpanData保持不变
+	*/
+	void BenchNavBake()
+	{
+		auto Scene = LoadSyntheticScene();
+		uint64_t SceneHash = navBake::HashScene(*Scene);
+		NavBakeParams Params;
+		Params.Radius = 2000.0f;
+		Params.TileSize = 2;
+		Params.Stride = 16.0f;
+		Params.CellHeight = 16.0f;
+		Params.MinHeight = 0.0f;
+		Params.MaxHeight = 1000.0f;
+		Params.ClimbHeight = 2 * Params.Stride;
+		std::vector<SphereMgr> Spheres(1);
+		SpanData::getInstance().Clear();
+		glm::vec3 Center = Params.Center;
+		Spheres[0].Build(Center, Params.Radius, Params.TileSize, Params.Stride, 0);
+		voxelFuncs::ReCastSphereVoxelization(Scene, Spheres[0], Params.TileSize, Params.Stride, Params.CellHeight, Params.MinHeight, Params.MaxHeight, 0);
+		SpanData::getInstance().Compaction(true);
+		SpanData::getInstance().BuildLinks(Params.ClimbHeight);
+
+		std::filesystem::path Directory = std::filesystem::temp_directory_path();
+		std::string FilePath = (Directory / "voxelbench.navbake").string();
+		std::string CorruptPath = (Directory / "voxelbench_corrupt.navbake").string();
+		auto Begin = std::chrono::steady_clock::now();
+		bool Saved = navBake::SaveNavBake(FilePath, Spheres, { Params }, SceneHash);
+		double SaveTime = SecondsSince(Begin);
+		auto Expected = SnapshotBakeData(Spheres);
+
+		//数据段中间改一个字节，文件头与长度都不变，只有校验和能发现
+		std::vector<char> Bytes;
+		{
+			std::ifstream File(FilePath, std::ios::binary);
+			Bytes.assign(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+		}
+		if (!Bytes.empty())
+		{
+			Bytes[Bytes.size() / 2] ^= 0x5a;
+		}
+		std::ofstream(CorruptPath, std::ios::binary).write(Bytes.data(), Bytes.size());
+
+		SpanData::getInstance().Clear();
+		std::vector<SphereMgr> Loaded;
+		NavBakeParams OtherParams = Params;
+		OtherParams.Stride *= 2;
+		bool OtherParamsRejected = !navBake::LoadNavBake(FilePath, Loaded, { OtherParams }, SceneHash);
+		bool OtherSceneRejected = !navBake::LoadNavBake(FilePath, Loaded, { Params }, SceneHash + 1);
+		bool CorruptRejected = !navBake::LoadNavBake(CorruptPath, Loaded, { Params }, SceneHash);
+		bool Unchanged = Loaded.empty() && SpanData::getInstance().Compact.GetSpanNum() == 0 && !SpanData::getInstance().ReadOnly;
+
+		Begin = std::chrono::steady_clock::now();
+		bool LoadedOk = navBake::LoadNavBake(FilePath, Loaded, { Params }, SceneHash);
+		double LoadTime = SecondsSince(Begin);
+		bool Same = LoadedOk && SnapshotBakeData(Loaded) == Expected;
+		uint64_t FileSize = Saved ? std::filesystem::file_size(FilePath) : 0;
+		std::filesystem::remove(FilePath);
+		std::filesystem::remove(CorruptPath);
+
+		printf("NavBake: %.1f MB, save %.1f ms, load %.2f ms, round trip %s, wrong params rejected %s, wrong scene rejected %s, corrupt payload rejected %s\n",
+			FileSize / 1048576.0, SaveTime * 1e3, LoadTime * 1e3, Same ? "identical" : "MISMATCH",
+			OtherParamsRejected ? "yes" : "no", OtherSceneRejected ? "yes" : "no", CorruptRejected ? "yes" : "no");
+		Record("NavBake", "file_mb", FileSize / 1048576.0);
+		Record("NavBake", "save_ms", SaveTime * 1e3);
+		Record("NavBake", "load_ms", LoadTime * 1e3);
+		Check("NavBake", "save", Saved);
+		Check("NavBake", "round trip", Same);
+		Check("NavBake", "wrong params rejected", OtherParamsRejected);
+		Check("NavBake", "wrong scene hash rejected", OtherSceneRejected);
+		Check("NavBake", "corrupt payload rejected", CorruptRejected);
+		Check("NavBake", "failed loads keep SpanData", Unchanged);
+		SpanData::getInstance().Clear();
+	}
+
+	/*
+	* 合成场景上随机起终点（随机走若干步得到）的寻路，旧的findWays与SpanPathFinder（使用与不使用预先建立的连接）使用相同的查询
+	* 并检查使用连接与逐个比较高度的搜索结果相同（包括整个球上随机起终点、可能不连通的查询）
+	*/
+	void BenchFindWays()
+	{
+		SphereMgr Sphere;
+		BakeSyntheticSphere(Sphere);
+		const int QueryNum = 200;
+		auto Queries = MakeRandomWalkQueries(Sphere, QueryNum, 40, 7);
+		if (Queries.empty())
+		{
+			printf("FindWays: no spans\n");
+			return;
+		}
+
+		int Found = 0;
+		auto Begin = std::chrono::steady_clock::now();
+		for (auto&& q : Queries)
+		{
+			Found += !voxelFuncs::findWays(*q.first, *q.second, Sphere).empty();
+		}
+		double LegacyTime = SecondsSince(Begin);
+
+		SpanPathFinder PathFinder(Sphere);
+		std::vector<int> Path;
+		double NewTime[2];
+		int NewFound[2] = { 0,0 };
+		std::vector<int> PathLengths[2];
+		for (int UseLinks = 0; UseLinks < 2; UseLinks++)
+		{
+			PathFinder.UseLinks = UseLinks != 0;
+			Begin = std::chrono::steady_clock::now();
+			for (auto&& q : Queries)
+			{
+				bool QueryFound = PathFinder.FindPath(ToSpanIndex(q.first), ToSpanIndex(q.second), Path);
+				NewFound[UseLinks] += QueryFound;
+				PathLengths[UseLinks].emplace_back(QueryFound ? int(Path.size()) : -1);
+			}
+			NewTime[UseLinks] = SecondsSince(Begin);
+		}
+
+		//整个球上的随机起终点，不限制展开数，不连通时使用连接的搜索由连通分量直接排除
+		const int UniformQueryNum = 50;
+		srand(23);
+		PathFinder.MaxSearchNodes = PathFinder.GetSpanNum();
+		for (int i = 0; i < UniformQueryNum; i++)
+		{
+			int From = voxelFuncs::getRandomSpanIndex(Sphere);
+			int To = voxelFuncs::getRandomSpanIndex(Sphere);
+			for (int UseLinks = 0; UseLinks < 2; UseLinks++)
+			{
+				PathFinder.UseLinks = UseLinks != 0;
+				PathLengths[UseLinks].emplace_back(PathFinder.FindPath(From, To, Path) ? int(Path.size()) : -1);
+			}
+		}
+		int LinkMismatch = 0;
+		for (int i = 0; i < PathLengths[0].size(); i++)
+		{
+			LinkMismatch += PathLengths[0][i] != PathLengths[1][i];
+		}
+
+		printf("FindWays: queries %d, findWays %.1f queries/s (found %d), SpanPathFinder %.0f queries/s (found %d), with links %.0f queries/s (found %d)\n",
+			QueryNum, QueryNum / LegacyTime, Found, QueryNum / NewTime[0], NewFound[0], QueryNum / NewTime[1], NewFound[1]);
+		Record("FindWays", "findways_queries_per_s", QueryNum / LegacyTime);
+		Record("FindWays", "pathfinder_queries_per_s", QueryNum / NewTime[0]);
+		Record("FindWays", "pathfinder_links_queries_per_s", QueryNum / NewTime[1]);
+		printf("FindWays: links vs scan, %d/%zu queries differ (including %d uniform queries), %s\n", LinkMismatch, PathLengths[0].size(), UniformQueryNum,
+			Check("FindWays", "links agree with scan", LinkMismatch == 0) ? "passed" : "FAILED");
+		Record("FindWays", "links_mismatch", LinkMismatch);
+		SpanData::getInstance().Clear();
+	}
+
+	/*
+	* 起终点在不同连通分量中（一定没有路径）时SpanPathFinder的速度：不使用与使用连通分量提前排除
+	* 以及在整个球上与只在最大的连通分量中随机取起终点时找到路径的比例
+	*/
+	void BenchComponents()
+	{
+		SphereMgr Sphere;
+		BakeSyntheticSphere(Sphere);
+		auto&& Compact = SpanData::getInstance().Compact;
+		auto Begin = std::chrono::steady_clock::now();
+		Compact.BuildComponents();
+		double BuildTime = SecondsSince(Begin);
+		int Largest = voxelFuncs::getLargestComponent(Sphere);
+		printf("Components: build %.1f ms, %d components, largest %d of %d spans\n", BuildTime * 1e3, Compact.GetComponentNum(),
+			Compact.GetComponentSize(Largest), Compact.GetSpanNum());
+		Record("Components", "build_ms", BuildTime * 1e3);
+		Record("Components", "component_num", Compact.GetComponentNum());
+		Record("Components", "largest_fraction", double(Compact.GetComponentSize(Largest)) / Compact.GetSpanNum());
+
+		const int QueryNum = 200;
+		srand(17);
+		std::vector<std::pair<int, int>> Queries;
+		while (Compact.GetComponentNum() > 1 && Queries.size() < QueryNum)
+		{
+			int From = voxelFuncs::getRandomSpanIndex(Sphere);
+			int To = voxelFuncs::getRandomSpanIndex(Sphere);
+			if (Compact.GetSpanComponent(From) != Compact.GetSpanComponent(To))
+			{
+				Queries.emplace_back(From, To);
+			}
+		}
+		SpanPathFinder PathFinder(Sphere);
+		std::vector<int> Path;
+		const char* Names[2] = { "no_components", "components" };
+		for (int UseComponents = 0; UseComponents < 2; UseComponents++)
+		{
+			if (UseComponents)
+			{
+				Compact.BuildComponents();
+			}
+			else
+			{
+				Compact.AttachComponents(nullptr, nullptr, 0);
+			}
+			int Found = 0;
+			int64_t ExpandedNum = 0;
+			Begin = std::chrono::steady_clock::now();
+			for (auto&& q : Queries)
+			{
+				Found += PathFinder.FindPath(q.first, q.second, Path);
+				ExpandedNum += PathFinder.GetLastExpandedNum();
+			}
+			double Time = SecondsSince(Begin);
+			printf("Components: unreachable queries, %s: %.2f us/query, %.0f expanded/query (found %d/%zu)\n", Names[UseComponents],
+				Time * 1e6 / Queries.size(), double(ExpandedNum) / Queries.size(), Found, Queries.size());
+			Record("Components", std::string(Names[UseComponents]) + "_us_per_query", Time * 1e6 / Queries.size());
+		}
+
+		int UniformFound = 0;
+		int LargestFound = 0;
+		for (int i = 0; i < QueryNum; i++)
+		{
+			UniformFound += PathFinder.FindPath(voxelFuncs::getRandomSpanIndex(Sphere), voxelFuncs::getRandomSpanIndex(Sphere), Path);
+			LargestFound += PathFinder.FindPath(voxelFuncs::getRandomSpanIndex(Sphere, Largest), voxelFuncs::getRandomSpanIndex(Sphere, Largest), Path);
+		}
+		printf("Components: random queries found %d/%d, in the largest component %d/%d (MaxSearchNodes %d)\n", UniformFound, QueryNum, LargestFound, QueryNum, PathFinder.MaxSearchNodes);
+		Record("Components", "uniform_found", UniformFound);
+		Record("Components", "largest_found", LargestFound);
+		SpanData::getInstance().Clear();
+	}
+
+	/*
+	* 不同路标数时SpanPathFinder展开的节点数与耗时，路标数为0时是原来的直线距离启发值
+	* 起终点都在最大的连通分量中随机选取，不限制展开数
+	*/
+	void BenchLandmarks()
+	{
+		SphereMgr Sphere;
+		BakeSyntheticSphere(Sphere);
+		int Largest = voxelFuncs::getLargestComponent(Sphere);
+		const int QueryNum = 100;
+		srand(19);
+		std::vector<std::pair<int, int>> Queries;
+		for (int i = 0; i < QueryNum; i++)
+		{
+			Queries.emplace_back(voxelFuncs::getRandomSpanIndex(Sphere, Largest), voxelFuncs::getRandomSpanIndex(Sphere, Largest));
+		}
+
+		SpanPathFinder PathFinder(Sphere);
+		PathFinder.MaxSearchNodes = PathFinder.GetSpanNum();
+		std::vector<int> Path;
+		std::vector<size_t> BaseLengths(QueryNum, 0);
+		double BaseExpanded = 0.0;
+		int BaseFound = 0;
+		for (int LandmarkNum : { 0, 1, 4, 8, 16 })
+		{
+			auto Begin = std::chrono::steady_clock::now();
+			SpanLandmarks Landmarks(Sphere, LandmarkNum, 0);
+			double BuildTime = SecondsSince(Begin);
+			PathFinder.SetLandmarks(LandmarkNum > 0 ? &Landmarks : nullptr);
+
+			int Found = 0;
+			int Longer = 0;
+			int64_t ExpandedNum = 0;
+			Begin = std::chrono::steady_clock::now();
+			for (int i = 0; i < QueryNum; i++)
+			{
+				if (PathFinder.FindPath(Queries[i].first, Queries[i].second, Path))
+				{
+					Found++;
+					if (LandmarkNum == 0)
+					{
+						BaseLengths[i] = Path.size();
+					}
+					Longer += Path.size() > BaseLengths[i];
+				}
+				ExpandedNum += PathFinder.GetLastExpandedNum();
+			}
+			double Time = SecondsSince(Begin);
+			double Expanded = double(ExpandedNum) / QueryNum;
+			BaseExpanded = LandmarkNum == 0 ? Expanded : BaseExpanded;
+			BaseFound = LandmarkNum == 0 ? Found : BaseFound;
+			printf("Landmarks: %2d landmarks, build %.1f ms, %.1f MB, %.3f ms/query, %.0f expanded/query (%.2fx), found %d, longer than baseline %d\n",
+				LandmarkNum, BuildTime * 1e3, Landmarks.GetMemorySize() / 1048576.0, Time * 1e3 / QueryNum, Expanded, BaseExpanded / Expanded, Found, Longer);
+			std::string Prefix = "landmarks" + std::to_string(LandmarkNum) + "_";
+			Record("Landmarks", Prefix + "build_ms", BuildTime * 1e3);
+			Record("Landmarks", Prefix + "memory_mb", Landmarks.GetMemorySize() / 1048576.0);
+			Record("Landmarks", Prefix + "ms_per_query", Time * 1e3 / QueryNum);
+			Record("Landmarks", Prefix + "expanded_per_query", Expanded);
+			//ALT的启发函数是可采纳的，找到的路径与不用地标时一样多，并且一样短
+			Check("Landmarks", std::to_string(LandmarkNum) + " landmarks keep paths optimal", Longer == 0 && Found == BaseFound);
+		}
+		PathFinder.SetLandmarks(nullptr);
+		SpanData::getInstance().Clear();
+	}
+
+	/*
+	* PathQueryService从1个线程到硬件线程数的吞吐量（future），以及每帧预算下回调的分发
+	*/
+	void BenchPathQueryService()
+	{
+		SphereMgr Sphere;
+		BakeSyntheticSphere(Sphere);
+		const int QueryNum = 2000;
+		std::vector<std::pair<int, int>> Queries;
+		for (auto&& q : MakeRandomWalkQueries(Sphere, QueryNum, 60, 11))
+		{
+			Queries.emplace_back(ToSpanIndex(q.first), ToSpanIndex(q.second));
+		}
+		if (Queries.empty())
+		{
+			printf("PathQueryService: no spans\n");
+			return;
+		}
+
+		std::vector<int> ThreadNums;
+		int HardwareNum = WorkStealingScheduler::ResolveThreadNum(0);
+		for (int n = 1; n < HardwareNum; n *= 2)
+		{
+			ThreadNums.emplace_back(n);
+		}
+		ThreadNums.emplace_back(HardwareNum);
+
+		double SingleRate = 0.0;
+		for (int ThreadNum : ThreadNums)
+		{
+			PathQueryService Service(Sphere, ThreadNum);
+			std::vector<std::future<PathQueryResult>> Futures;
+			Futures.reserve(Queries.size());
+			int Found = 0;
+			auto Begin = std::chrono::steady_clock::now();
+			for (auto&& q : Queries)
+			{
+				Futures.emplace_back(Service.Submit(q.first, q.second));
+			}
+			for (auto&& f : Futures)
+			{
+				Found += f.get().Found;
+			}
+			double Rate = Queries.size() / SecondsSince(Begin);
+			SingleRate = ThreadNum == 1 ? Rate : SingleRate;
+			printf("PathQueryService: threads %d, %.0f queries/s, scaling %.2fx (found %d/%zu)\n", ThreadNum, Rate, Rate / SingleRate, Found, Queries.size());
+			char Metric[64];
+			snprintf(Metric, sizeof(Metric), "threads%d_queries_per_s", ThreadNum);
+			Record("PathQueryService", Metric, Rate);
+		}
+
+		//模拟主循环：一次提交全部请求，每帧只用BudgetMs执行回调
+		const double BudgetMs = 0.5;
+		PathQueryService Service(Sphere, 0);
+		int Delivered = 0;
+		for (auto&& q : Queries)
+		{
+			Service.Submit(q.first, q.second, [&Delivered](const PathQueryResult&) { Delivered++; });
+		}
+		int FrameNum = 0;
+		double MaxDispatchMs = 0.0;
+		while (Delivered < int(Queries.size()))
+		{
+			auto Begin = std::chrono::steady_clock::now();
+			Service.DispatchCompleted(BudgetMs);
+			MaxDispatchMs = std::max(MaxDispatchMs, SecondsSince(Begin) * 1e3);
+			FrameNum++;
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+		}
+		printf("PathQueryService: callbacks over %d frames, longest dispatch %.3f ms (budget %.1f ms)\n", FrameNum, MaxDispatchMs, BudgetMs);
+		Record("PathQueryService", "max_dispatch_ms", MaxDispatchMs);
+		SpanData::getInstance().Clear();
+	}
+
+	/*
+	* 球面上接近对跖的起终点：分层寻路（不同簇大小）与不限制展开数的SpanPathFinder的耗时与路径长度
+	* 同时统计SpanPathFinder在默认的MaxSearchNodes（与findWays的MaxDepth相同）下能找到的路径数
+	*/
+	void BenchHierarchicalPath()
+	{
+		SphereMgr Sphere;
+		BakeSyntheticSphere(Sphere);
+		SpanPathFinder PathFinder(Sphere);
+		int SpanBegin = PathFinder.GetSpanBeginIndex();
+		int SpanNum = PathFinder.GetSpanNum();
+		if (SpanNum == 0)
+		{
+			printf("HierarchicalPath: no spans\n");
+			return;
+		}
+
+		//起点随机，终点在起点的对跖点附近随机
+		const int QueryNum = 40;
+		std::mt19937 Random(13);
+		std::vector<std::pair<int, int>> Queries;
+		while (Queries.size() < QueryNum)
+		{
+			int From = SpanBegin + int(Random() % SpanNum);
+			glm::vec3 FromDir = glm::normalize(PathFinder.GetSpanTopPos(From) - Sphere.CenterPos);
+			for (int Try = 0; Try < 1000; Try++)
+			{
+				int To = SpanBegin + int(Random() % SpanNum);
+				if (glm::dot(glm::normalize(PathFinder.GetSpanTopPos(To) - Sphere.CenterPos), FromDir) < -0.95f)
+				{
+					Queries.emplace_back(From, To);
+					break;
+				}
+			}
+		}
+
+		std::vector<int> Path;
+		std::vector<float> Lengths(Queries.size(), -1.0f);
+		PathFinder.MaxSearchNodes = SpanNum;
+		auto Begin = std::chrono::steady_clock::now();
+		int Found = 0;
+		for (int i = 0; i < Queries.size(); i++)
+		{
+			if (PathFinder.FindPath(Queries[i].first, Queries[i].second, Path))
+			{
+				Lengths[i] = float(Path.size());
+				Found++;
+			}
+		}
+		double FlatTime = SecondsSince(Begin);
+		PathFinder.MaxSearchNodes = SpanPathFinder(Sphere).MaxSearchNodes;
+		int LimitedFound = 0;
+		for (auto&& q : Queries)
+		{
+			LimitedFound += PathFinder.FindPath(q.first, q.second, Path);
+		}
+		printf("HierarchicalPath: %d antipodal queries, spans %d, A* %.2f ms/query (found %d, %d within MaxSearchNodes %d)\n",
+			QueryNum, SpanNum, FlatTime * 1e3 / QueryNum, Found, LimitedFound, PathFinder.MaxSearchNodes);
+		Record("HierarchicalPath", "astar_ms_per_query", FlatTime * 1e3 / QueryNum);
+		Record("HierarchicalPath", "astar_found", Found);
+		Record("HierarchicalPath", "astar_limited_found", LimitedFound);
+
+		const double MaxLengthRatio = 1.2;
+		for (int ClusterTileNum : { 4, 8, 16 })
+		{
+			Begin = std::chrono::steady_clock::now();
+			TilePortalGraph Graph(Sphere, ClusterTileNum, 0);
+			double BuildTime = SecondsSince(Begin);
+			HierarchicalPathFinder Finder(Graph);
+			int HierarchicalFound = 0;
+			int BothFound = 0;
+			double LengthRatio = 0.0;
+			int64_t ExpandedNum = 0;
+			Begin = std::chrono::steady_clock::now();
+			for (int i = 0; i < Queries.size(); i++)
+			{
+				if (Finder.FindPath(Queries[i].first, Queries[i].second, Path))
+				{
+					HierarchicalFound++;
+					if (Lengths[i] > 0)
+					{
+						LengthRatio += Path.size() / Lengths[i];
+						BothFound++;
+					}
+				}
+				ExpandedNum += Finder.GetLastAbstractExpandedNum() + Finder.GetLastRefineExpandedNum();
+			}
+			double Time = SecondsSince(Begin);
+			printf("HierarchicalPath: cluster %dx%d tiles, build %.1f ms, %d portals, %d edges, %.1f MB, %.3f ms/query (found %d, %.0f expanded/query), path length %.3fx A*\n",
+				ClusterTileNum, ClusterTileNum, BuildTime * 1e3, Graph.GetPortalNum(), Graph.GetEdgeNum(), Graph.GetMemorySize() / 1048576.0,
+				Time * 1e3 / QueryNum, HierarchicalFound, double(ExpandedNum) / QueryNum, BothFound ? LengthRatio / BothFound : 0.0);
+			std::string Prefix = "cluster" + std::to_string(ClusterTileNum) + "_";
+			Record("HierarchicalPath", Prefix + "build_ms", BuildTime * 1e3);
+			Record("HierarchicalPath", Prefix + "ms_per_query", Time * 1e3 / QueryNum);
+			Record("HierarchicalPath", Prefix + "found", HierarchicalFound);
+			Record("HierarchicalPath", Prefix + "length_ratio", BothFound ? LengthRatio / BothFound : 0.0);
+			//不限制展开数的A*能找到的路径分层寻路也必须找到，路径不一定最短，但平均不能比A*长太多
+			Check("HierarchicalPath", Prefix + "found", HierarchicalFound >= Found);
+			Check("HierarchicalPath", Prefix + "length ratio", BothFound == 0 || LengthRatio / BothFound <= MaxLengthRatio);
+		}
+		SpanData::getInstance().Clear();
+	}
+
+	/*
+	* 抽象图上的收缩层次：预处理耗时、捷径数与内存，长距离查询（起终点在最大的连通分量中随机选取）的路径长度与耗时
+	* 与抽象图上的A*（得到的长度应当相同）以及不限制展开数的SpanPathFinder比较，并检查保存加载与失效时的回退
+	*/
+	void BenchPortalHierarchy()
+	{
+		SphereMgr Sphere;
+		BakeSyntheticSphere(Sphere);
+		int Largest = voxelFuncs::getLargestComponent(Sphere);
+		if (Largest < 0)
+		{
+			printf("PortalHierarchy: no spans\n");
+			return;
+		}
+		const int QueryNum = 200;
+		const int SpanQueryNum = 20;
+		srand(19);
+		std::vector<std::pair<int, int>> Queries;
+		for (int i = 0; i < QueryNum; i++)
+		{
+			Queries.emplace_back(voxelFuncs::getRandomSpanIndex(Sphere, Largest), voxelFuncs::getRandomSpanIndex(Sphere, Largest));
+		}
+
+		SpanPathFinder PathFinder(Sphere);
+		PathFinder.MaxSearchNodes = PathFinder.GetSpanNum();
+		std::vector<int> Path;
+		auto Begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < SpanQueryNum; i++)
+		{
+			PathFinder.FindPath(Queries[i].first, Queries[i].second, Path);
+		}
+		double SpanTime = SecondsSince(Begin) / SpanQueryNum;
+		printf("PortalHierarchy: SpanPathFinder %.1f us/query\n", SpanTime * 1e6);
+		Record("PortalHierarchy", "span_astar_us_per_query", SpanTime * 1e6);
+
+		for (int ClusterTileNum : { 4, 8 })
+		{
+			TilePortalGraph Graph(Sphere, ClusterTileNum, 0);
+			PortalHierarchy Hierarchy;
+			Begin = std::chrono::steady_clock::now();
+			Hierarchy.Build(Graph);
+			double BuildTime = SecondsSince(Begin);
+			printf("PortalHierarchy: cluster %dx%d tiles, %d portals, %d edges, build %.1f ms, %d shortcuts, %.1f MB\n", ClusterTileNum, ClusterTileNum,
+				Graph.GetPortalNum(), Graph.GetEdgeNum(), BuildTime * 1e3, Hierarchy.GetShortcutNum(), Hierarchy.GetMemorySize() / 1048576.0);
+			std::string Prefix = "cluster" + std::to_string(ClusterTileNum) + "_";
+			Record("PortalHierarchy", Prefix + "build_ms", BuildTime * 1e3);
+			Record("PortalHierarchy", Prefix + "shortcuts", Hierarchy.GetShortcutNum());
+			Record("PortalHierarchy", Prefix + "memory_mb", Hierarchy.GetMemorySize() / 1048576.0);
+
+			//同一组查询分别用A*与收缩层次，两者在抽象图上的距离应当相同
+			HierarchicalPathFinder Finder(Graph);
+			std::vector<float> Distances[2];
+			const char* Names[2] = { "astar", "hierarchy" };
+			for (int UseHierarchy = 0; UseHierarchy < 2; UseHierarchy++)
+			{
+				Finder.SetHierarchy(UseHierarchy ? &Hierarchy : nullptr);
+				int64_t ExpandedNum = 0;
+				Begin = std::chrono::steady_clock::now();
+				for (auto&& q : Queries)
+				{
+					Distances[UseHierarchy].emplace_back(Finder.FindDistance(q.first, q.second));
+					ExpandedNum += Finder.GetLastAbstractExpandedNum();
+				}
+				double Time = SecondsSince(Begin) / QueryNum;
+				printf("PortalHierarchy: cluster %dx%d tiles, %s %.1f us/query (%.0f abstract nodes/query, %.0fx faster than SpanPathFinder)\n", ClusterTileNum, ClusterTileNum,
+					Names[UseHierarchy], Time * 1e6, double(ExpandedNum) / QueryNum, SpanTime / Time);
+				Record("PortalHierarchy", Prefix + Names[UseHierarchy] + "_us_per_query", Time * 1e6);
+			}
+			int Mismatch = 0;
+			for (int i = 0; i < QueryNum; i++)
+			{
+				Mismatch += std::abs(Distances[0][i] - Distances[1][i]) > 1e-3f * std::max(1.0f, Distances[0][i]);
+			}
+			int Refined = 0;
+			for (int i = 0; i < QueryNum; i++)
+			{
+				Refined += Finder.FindPath(Queries[i].first, Queries[i].second, Path) && Distances[1][i] >= 0;
+			}
+			printf("PortalHierarchy: cluster %dx%d tiles, %d distance mismatches, %d/%d hierarchy paths refined\n", ClusterTileNum, ClusterTileNum, Mismatch, Refined, QueryNum);
+			Record("PortalHierarchy", Prefix + "mismatch", Mismatch);
+			Check("PortalHierarchy", Prefix + "distances", Mismatch == 0);
+
+			//保存后用相同的校验和加载可以直接使用，校验和不同或者抽象图不同时退回A*
+			std::string FilePath = (std::filesystem::temp_directory_path() / "voxelbench.ch").string();
+			PortalHierarchy Loaded;
+			PortalHierarchy Stale;
+			TilePortalGraph OtherGraph(Sphere, ClusterTileNum * 2, 0);
+			bool Saved = Hierarchy.Save(FilePath, 1);
+			bool LoadedOk = Loaded.Load(FilePath, Graph, 1) && Finder.SetHierarchy(&Loaded);
+			bool StaleRejected = !Stale.Load(FilePath, Graph, 2) && !Loaded.Load(FilePath, OtherGraph, 1) && !Finder.SetHierarchy(&Stale);
+			bool OtherRejected = !HierarchicalPathFinder(OtherGraph).SetHierarchy(&Hierarchy);
+			std::filesystem::remove(FilePath);
+			printf("PortalHierarchy: cluster %dx%d tiles, save %s, load %s, stale file rejected %s, other graph rejected %s\n", ClusterTileNum, ClusterTileNum,
+				Saved ? "ok" : "failed", LoadedOk ? "ok" : "failed", StaleRejected ? "yes" : "no", OtherRejected ? "yes" : "no");
+			Check("PortalHierarchy", Prefix + "save and load", Saved && LoadedOk && StaleRejected && OtherRejected);
+		}
+		SpanData::getInstance().Clear();
+	}
+
+	/*
+	* getSpanListIndexFromWorldPos与批量查询getSpanListIndicesFromWorldPos对球面附近随机点的查询速度
+	* 同时检查两者的结果：不同的结果只能出现在边界附近，两个SpanList的中心点必须相邻
+	*/
+	void BenchWorldPosLookup()
+	{
+		SpanData::getInstance().Clear();
+		SphereMgr Sphere;
+		glm::vec3 Center(0, 0, 0);
+		Sphere.Build(Center, 2000.0f, 2, 16.0f, 0);
+		auto&& Data = SpanData::getInstance().Data;
+
+		const int LookupNum = 200000;
+		std::mt19937 Random(3);
+		std::uniform_real_distribution<float> Dist(-1.0f, 1.0f);
+		std::vector<glm::vec3> Points(LookupNum);
+		for (auto&& p : Points)
+		{
+			glm::vec3 Dir;
+			do
+			{
+				Dir = glm::vec3(Dist(Random), Dist(Random), Dist(Random));
+			} while (glm::length(Dir) < 0.1f);
+			p = glm::normalize(Dir) * (2000.0f + 50.0f * Dist(Random));
+		}
+		long long Sum = 0;
+		auto Begin = std::chrono::steady_clock::now();
+		for (auto&& p : Points)
+		{
+			Sum += Sphere.getSpanListIndexFromWorldPos(p.x, p.y, p.z);
+		}
+		double Time = SecondsSince(Begin);
+		printf("WorldPosLookup: %d lookups, %.2f M lookups/s (check %lld)\n", LookupNum, LookupNum / 1e6 / Time, Sum);
+		Record("WorldPosLookup", "mlookups_per_s", LookupNum / 1e6 / Time);
+
+		std::vector<int> Scalar(LookupNum);
+		for (int i = 0; i < LookupNum; i++)
+		{
+			Scalar[i] = Sphere.getSpanListIndexFromWorldPos(Points[i].x, Points[i].y, Points[i].z);
+		}
+		const int Repeat = 10;
+		std::vector<int> Batch(LookupNum);
+		Begin = std::chrono::steady_clock::now();
+		for (int r = 0; r < Repeat; r++)
+		{
+			Sphere.getSpanListIndicesFromWorldPos(Points.data(), LookupNum, Batch.data());
+		}
+		double BatchTime = SecondsSince(Begin) / Repeat;
+
+		int MismatchNum = 0;
+		float MaxDistance = 0.0f;
+		for (int i = 0; i < LookupNum; i++)
+		{
+			if (Batch[i] != Scalar[i])
+			{
+				MismatchNum++;
+				MaxDistance = std::max(MaxDistance, glm::length(Data[Batch[i]].CenteralWorldPos - Data[Scalar[i]].CenteralWorldPos));
+			}
+		}
+		bool Passed = Check("WorldPosLookup", "batch lookups", MismatchNum * 1000 <= LookupNum && MaxDistance <= 2.0f * Sphere.Stride);
+		printf("WorldPosLookup: batch %.2f M lookups/s, speedup %.1fx, mismatches %d (max distance %.1f), %s\n",
+			LookupNum / 1e6 / BatchTime, Time / BatchTime, MismatchNum, MaxDistance, Passed ? "passed" : "FAILED");
+		Record("WorldPosLookup", "batch_mlookups_per_s", LookupNum / 1e6 / BatchTime);
+		Record("WorldPosLookup", "batch_mismatches", MismatchNum);
+		SpanData::getInstance().Clear();
+	}
+
+	struct BenchEntry
+	{
+		const char* Name;
+		void (*Func)();
+	};
+
+	const BenchEntry Benches[] =
+	{
+		{ "TileLookup", BenchTileLookup },
+		{ "BVHQuery", BenchBVHQuery },
+		{ "VertexTransform", BenchVertexTransform },
+		{ "RecastAlloc", BenchRecastAlloc },
+		{ "LoadJsonData", BenchLoadJsonData },
+		{ "SphereBuild", BenchSphereBuild },
+		{ "ParallelSphereBuild", BenchParallelSphereBuild },
+		{ "TileRecast", BenchTileRecast },
+		{ "Rasterize", BenchRasterize },
+		{ "NavBake", BenchNavBake },
+		{ "FindWays", BenchFindWays },
+		{ "Components", BenchComponents },
+		{ "Landmarks", BenchLandmarks },
+		{ "PathQueryService", BenchPathQueryService },
+		{ "HierarchicalPath", BenchHierarchicalPath },
+		{ "PortalHierarchy", BenchPortalHierarchy },
+		{ "WorldPosLookup", BenchWorldPosLookup },
+	};
+}
+
+int main(int argc, char** argv)
+{
+	std::string JsonPath;
+	std::vector<std::string> Selected;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+		{
+			JsonPath = argv[++i];
+		}
+		else
+		{
+			Selected.emplace_back(argv[i]);
+		}
+	}
+	for (auto&& Bench : Benches)
+	{
+		if (Selected.empty() || std::find(Selected.begin(), Selected.end(), Bench.Name) != Selected.end())
+		{
+			Bench.Func();
+		}
+	}
+	if (!JsonPath.empty())
+	{
+		nlohmann::json Output;
+		Output["version"] = 1;
+		Output["benchmarks"] = Results;
+		Output["failures"] = Failures;
+		std::ofstream(JsonPath) << Output.dump(2);
+	}
+	for (auto&& Failure : Failures)
+	{
+		fprintf(stderr, "FAILED %s\n", Failure.c_str());
+	}
+	return Failures.empty() ? 0 : 1;
+}